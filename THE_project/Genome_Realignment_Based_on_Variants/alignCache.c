@@ -0,0 +1,332 @@
+#include "alignCache.h"
+
+/*********************************************************************
+ *                         Structures and Accessors
+ ********************************************************************/
+
+typedef struct AlignCacheCell AlignCacheCell;
+
+struct AlignCacheCell {
+  AlignCacheKey key;
+  AlignResult ar;        // owns its cigar arrays
+  AlignCacheCell *next;  // pointer to the next cell in the same bucket
+};
+
+typedef struct _define_AlignCacheShard {
+  pthread_mutex_t lock;
+  int32_t capacity;          // maximal number of cells in this shard
+  int32_t cnt_cell;          // number of cells in this shard
+  int32_t idx_oldest;        // index of the oldest cell in fifo
+  int32_t cnt_bucket;        // size of the hash table
+  AlignCacheCell **buckets;  // hash table
+  AlignCacheCell **fifo;     // cells in order of insertion (ring buffer)
+  uint64_t cnt_hit;
+  uint64_t cnt_miss;
+  uint64_t cnt_evict;
+} AlignCacheShard;
+
+struct AlignCache {
+  int32_t capacity;
+  AlignCacheShard shards[ALIGNCACHE_CNT_SHARD];
+};
+
+/*********************************************************************
+ *                  Auxiliary Structures and Methods
+ ********************************************************************/
+
+/**
+ * @brief  64-bit MurmurHash (MurmurHash64A) of a byte array.
+ */
+static uint64_t hash_bytes(const uint8_t *data, size_t length, uint64_t seed) {
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+  uint64_t h = seed ^ (length * m);
+  size_t cnt_word = length / 8;
+  for (size_t i = 0; i < cnt_word; i++) {
+    uint64_t k = 0;
+    memcpy(&k, data + i * 8, 8);
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  const uint8_t *tail = data + cnt_word * 8;
+  switch (length & 7) {  // fall through on purpose
+    case 7:
+      h ^= (uint64_t)tail[6] << 48;
+      /* fall through */
+    case 6:
+      h ^= (uint64_t)tail[5] << 40;
+      /* fall through */
+    case 5:
+      h ^= (uint64_t)tail[4] << 32;
+      /* fall through */
+    case 4:
+      h ^= (uint64_t)tail[3] << 24;
+      /* fall through */
+    case 3:
+      h ^= (uint64_t)tail[2] << 16;
+      /* fall through */
+    case 2:
+      h ^= (uint64_t)tail[1] << 8;
+      /* fall through */
+    case 1:
+      h ^= (uint64_t)tail[0];
+      h *= m;
+  }
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+static inline bool alignCacheKey_equal(const AlignCacheKey *k1,
+                                       const AlignCacheKey *k2) {
+  return k1->h1 == k2->h1 && k1->h2 == k2->h2;
+}
+
+static inline AlignCacheShard *alignCache_shard(AlignCache *cache,
+                                                const AlignCacheKey *key) {
+  return &(cache->shards[key->h1 % ALIGNCACHE_CNT_SHARD]);
+}
+
+static inline int32_t alignCacheShard_bucketIdx(AlignCacheShard *shard,
+                                                const AlignCacheKey *key) {
+  return (key->h1 / ALIGNCACHE_CNT_SHARD) % shard->cnt_bucket;
+}
+
+/**
+ * @brief  Copy src into an empty dst. Cigar arrays are duplicated.
+ */
+static void copy_AlignResult(AlignResult *dst, const AlignResult *src) {
+  *dst = *src;
+  dst->cigarLen = NULL;
+  dst->cigarOp = NULL;
+  if (src->cnt_cigar > 0) {
+    dst->cigarLen = (uint32_t *)malloc(src->cnt_cigar * sizeof(uint32_t));
+    dst->cigarOp = (char *)malloc(src->cnt_cigar * sizeof(char));
+    memcpy(dst->cigarLen, src->cigarLen, src->cnt_cigar * sizeof(uint32_t));
+    memcpy(dst->cigarOp, src->cigarOp, src->cnt_cigar * sizeof(char));
+  }
+}
+
+/**
+ * @brief  Remove the oldest cell from the shard and return it for reuse.
+ */
+static AlignCacheCell *alignCacheShard_evict(AlignCacheShard *shard) {
+  AlignCacheCell *cell = shard->fifo[shard->idx_oldest];
+  AlignCacheCell **link =
+      &(shard->buckets[alignCacheShard_bucketIdx(shard, &(cell->key))]);
+  while (*link != cell) link = &((*link)->next);
+  *link = cell->next;
+  free(cell->ar.cigarLen);
+  free(cell->ar.cigarOp);
+  shard->idx_oldest = (shard->idx_oldest + 1) % shard->capacity;
+  shard->cnt_cell--;
+  shard->cnt_evict++;
+  return cell;
+}
+
+/*********************************************************************
+ *                            Basic Functions
+ ********************************************************************/
+
+AlignCache *init_AlignCache(int32_t capacity) {
+  if (capacity <= 0) return NULL;
+  AlignCache *cache = (AlignCache *)calloc(1, sizeof(AlignCache));
+  cache->capacity = capacity;
+  int32_t capacity_shard =
+      (capacity + ALIGNCACHE_CNT_SHARD - 1) / ALIGNCACHE_CNT_SHARD;
+  for (int i = 0; i < ALIGNCACHE_CNT_SHARD; i++) {
+    AlignCacheShard *shard = &(cache->shards[i]);
+    pthread_mutex_init(&(shard->lock), NULL);
+    shard->capacity = capacity_shard;
+    shard->cnt_bucket = capacity_shard;
+    shard->buckets =
+        (AlignCacheCell **)calloc(shard->cnt_bucket, sizeof(AlignCacheCell *));
+    shard->fifo =
+        (AlignCacheCell **)calloc(shard->capacity, sizeof(AlignCacheCell *));
+    if (shard->buckets == NULL || shard->fifo == NULL) {
+      fprintf(stderr, "Error: System memory not enough. \n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return cache;
+}
+
+void destroy_AlignCache(AlignCache *cache) {
+  if (cache == NULL) return;
+  for (int i = 0; i < ALIGNCACHE_CNT_SHARD; i++) {
+    AlignCacheShard *shard = &(cache->shards[i]);
+    for (int32_t j = 0; j < shard->cnt_cell; j++) {
+      AlignCacheCell *cell =
+          shard->fifo[(shard->idx_oldest + j) % shard->capacity];
+      free(cell->ar.cigarLen);
+      free(cell->ar.cigarOp);
+      free(cell);
+    }
+    free(shard->buckets);
+    free(shard->fifo);
+    pthread_mutex_destroy(&(shard->lock));
+  }
+  free(cache);
+}
+
+AlignCacheKey alignCache_key(const uint8_t *tseq, int tlen, const uint8_t *qseq,
+                             int qlen, const int32_t *params, int cnt_params) {
+  // Seeds are arbitrary; they only need to be different
+  static const uint64_t seed1 = 0x9e3779b97f4a7c15ULL;
+  static const uint64_t seed2 = 0xd1b54a32d192ed03ULL;
+  AlignCacheKey key;
+  key.h1 = hash_bytes(tseq, tlen, seed1);
+  key.h1 = hash_bytes(qseq, qlen, key.h1);
+  key.h1 = hash_bytes((const uint8_t *)params, cnt_params * sizeof(int32_t),
+                      key.h1);
+  key.h2 = hash_bytes(tseq, tlen, seed2);
+  key.h2 = hash_bytes(qseq, qlen, key.h2);
+  key.h2 = hash_bytes((const uint8_t *)params, cnt_params * sizeof(int32_t),
+                      key.h2);
+  return key;
+}
+
+bool alignCache_get(AlignCache *cache, const AlignCacheKey *key,
+                    AlignResult *ar) {
+  AlignCacheShard *shard = alignCache_shard(cache, key);
+  bool ifHit = false;
+  pthread_mutex_lock(&(shard->lock));
+  AlignCacheCell *cell = shard->buckets[alignCacheShard_bucketIdx(shard, key)];
+  while (cell != NULL) {
+    if (alignCacheKey_equal(&(cell->key), key)) {
+      copy_AlignResult(ar, &(cell->ar));
+      ifHit = true;
+      break;
+    }
+    cell = cell->next;
+  }
+  if (ifHit) {
+    shard->cnt_hit++;
+  } else {
+    shard->cnt_miss++;
+  }
+  pthread_mutex_unlock(&(shard->lock));
+  return ifHit;
+}
+
+void alignCache_put(AlignCache *cache, const AlignCacheKey *key,
+                    const AlignResult *ar) {
+  AlignCacheShard *shard = alignCache_shard(cache, key);
+  pthread_mutex_lock(&(shard->lock));
+  int32_t idx_bucket = alignCacheShard_bucketIdx(shard, key);
+  // Another thread may have added the same alignment in the meantime
+  AlignCacheCell *cell = shard->buckets[idx_bucket];
+  while (cell != NULL) {
+    if (alignCacheKey_equal(&(cell->key), key)) {
+      pthread_mutex_unlock(&(shard->lock));
+      return;
+    }
+    cell = cell->next;
+  }
+  if (shard->cnt_cell == shard->capacity) {
+    cell = alignCacheShard_evict(shard);
+  } else {
+    cell = (AlignCacheCell *)malloc(sizeof(AlignCacheCell));
+  }
+  cell->key = *key;
+  copy_AlignResult(&(cell->ar), ar);
+  cell->next = shard->buckets[idx_bucket];
+  shard->buckets[idx_bucket] = cell;
+  shard->fifo[(shard->idx_oldest + shard->cnt_cell) % shard->capacity] = cell;
+  shard->cnt_cell++;
+  pthread_mutex_unlock(&(shard->lock));
+}
+
+void alignCache_statistics(AlignCache *cache, uint64_t *ret_cnt_hit,
+                           uint64_t *ret_cnt_miss) {
+  uint64_t cnt_hit = 0, cnt_miss = 0;
+  for (int i = 0; i < ALIGNCACHE_CNT_SHARD; i++) {
+    AlignCacheShard *shard = &(cache->shards[i]);
+    pthread_mutex_lock(&(shard->lock));
+    cnt_hit += shard->cnt_hit;
+    cnt_miss += shard->cnt_miss;
+    pthread_mutex_unlock(&(shard->lock));
+  }
+  *ret_cnt_hit = cnt_hit;
+  *ret_cnt_miss = cnt_miss;
+}
+
+void alignCache_printStatistics(AlignCache *cache, FILE *fp) {
+  if (cache == NULL) return;
+  uint64_t cnt_hit = 0, cnt_miss = 0, cnt_evict = 0, cnt_cell = 0;
+  for (int i = 0; i < ALIGNCACHE_CNT_SHARD; i++) {
+    AlignCacheShard *shard = &(cache->shards[i]);
+    pthread_mutex_lock(&(shard->lock));
+    cnt_hit += shard->cnt_hit;
+    cnt_miss += shard->cnt_miss;
+    cnt_evict += shard->cnt_evict;
+    cnt_cell += shard->cnt_cell;
+    pthread_mutex_unlock(&(shard->lock));
+  }
+  uint64_t cnt_lookup = cnt_hit + cnt_miss;
+  fprintf(fp,
+          "alignment cache: %" PRIu64 " lookups, %" PRIu64
+          " hits (%.2f%%), %" PRIu64 " evictions, %" PRIu64 "/%" PRId32
+          " results cached\n",
+          cnt_lookup, cnt_hit,
+          cnt_lookup == 0 ? 0.0 : 100.0 * cnt_hit / cnt_lookup, cnt_evict,
+          cnt_cell, cache->capacity);
+}
+
+/*********************************************************************
+ *                            Debug Methods
+ ********************************************************************/
+
+static int _test_CacheHitAndEviction() {
+  AlignCache *cache = init_AlignCache(ALIGNCACHE_CNT_SHARD);
+  int32_t params[2] = {1, 2};
+  uint8_t tseq[4] = {0, 1, 2, 3};
+  uint8_t qseq[3] = {0, 1, 2};
+  AlignResult *ar = init_AlignResult();
+  ar->cnt_cigar = 2;
+  ar->cigarLen = (uint32_t *)calloc(2, sizeof(uint32_t));
+  ar->cigarOp = (char *)calloc(2, sizeof(char));
+  ar->cigarLen[0] = 3, ar->cigarOp[0] = 'M';
+  ar->cigarLen[1] = 1, ar->cigarOp[1] = 'D';
+
+  AlignCacheKey key = alignCache_key(tseq, 4, qseq, 3, params, 2);
+  AlignResult *ar_got = init_AlignResult();
+  assert(!alignCache_get(cache, &key, ar_got));
+  alignCache_put(cache, &key, ar);
+  assert(alignCache_get(cache, &key, ar_got));
+  assert(ar_got->cnt_cigar == 2 && ar_got->cigarLen[1] == 1 &&
+         ar_got->cigarOp[1] == 'D');
+  destroy_AlignResult(ar_got);
+  uint64_t cnt_hit = 0, cnt_miss = 0;
+  alignCache_statistics(cache, &cnt_hit, &cnt_miss);
+  assert(cnt_hit == 1 && cnt_miss == 1);
+
+  // Different parameters result in a different key
+  params[1] = 3;
+  AlignCacheKey key_other = alignCache_key(tseq, 4, qseq, 3, params, 2);
+  assert(!alignCacheKey_equal(&key, &key_other));
+
+  // Fill the cache with much more results than its capacity
+  for (int32_t i = 0; i < ALIGNCACHE_CNT_SHARD * 16; i++) {
+    params[0] = i + 16;
+    key_other = alignCache_key(tseq, 4, qseq, 3, params, 2);
+    alignCache_put(cache, &key_other, ar);
+  }
+  int32_t cnt_cell = 0;
+  for (int i = 0; i < ALIGNCACHE_CNT_SHARD; i++) {
+    assert(cache->shards[i].cnt_cell <= cache->shards[i].capacity);
+    cnt_cell += cache->shards[i].cnt_cell;
+  }
+  assert(cnt_cell <= ALIGNCACHE_CNT_SHARD);
+  alignCache_printStatistics(cache, stdout);
+
+  destroy_AlignResult(ar);
+  destroy_AlignCache(cache);
+  return 1;
+}
+
+void _testSet_alignCache() { assert(_test_CacheHitAndEviction()); }
@@ -0,0 +1,91 @@
+#ifndef ALIGNCACHE_H_INCLUDED
+#define ALIGNCACHE_H_INCLUDED
+
+#pragma once
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alignment.h"
+
+/*
+ * Number of independently locked parts of the cache. Threads looking up
+ * different keys rarely wait for each other.
+ */
+#define ALIGNCACHE_CNT_SHARD 64
+
+/*********************************************************************
+ *                         Structures and Accessors
+ ********************************************************************/
+
+/*
+ * 128-bit hash of (encoded target, encoded query, alignment parameters). Two
+ * different alignments sharing the same key is practically impossible.
+ */
+typedef struct _define_AlignCacheKey {
+  uint64_t h1;
+  uint64_t h2;
+} AlignCacheKey;
+
+typedef struct AlignCache AlignCache;
+
+/*********************************************************************
+ *                            Basic Functions
+ ********************************************************************/
+
+/**
+ * @brief  Create a cache of alignment results shared by all threads.
+ * @param  capacity: maximal number of alignment results kept in the cache. The
+ * oldest results are evicted when the cache is full.
+ * @retval NULL if capacity <= 0
+ */
+AlignCache *init_AlignCache(int32_t capacity);
+
+void destroy_AlignCache(AlignCache *cache);
+
+/**
+ * @brief  Generate the key for an alignment.
+ * @param  *tseq: encoded target sequence
+ * @param  tlen: length of target sequence
+ * @param  *qseq: encoded query sequence
+ * @param  qlen: length of query sequence
+ * @param  *params: all parameters that can affect the alignment result
+ * (scores, band width, flags, aligner ...)
+ * @param  cnt_params: number of parameters
+ */
+AlignCacheKey alignCache_key(const uint8_t *tseq, int tlen, const uint8_t *qseq,
+                             int qlen, const int32_t *params, int cnt_params);
+
+/**
+ * @brief  Look up the cache. If found, copy the cached result into *ar.
+ * @note  *ar must be an empty AlignResult (just initialized).
+ * @retval true if hit; false otherwise.
+ */
+bool alignCache_get(AlignCache *cache, const AlignCacheKey *key,
+                    AlignResult *ar);
+
+/**
+ * @brief  Add a copy of the alignment result into the cache. Nothing will
+ * happen if the key already exists.
+ */
+void alignCache_put(AlignCache *cache, const AlignCacheKey *key,
+                    const AlignResult *ar);
+
+/**
+ * @brief  Get numbers of hits and misses of all lookups so far.
+ */
+void alignCache_statistics(AlignCache *cache, uint64_t *ret_cnt_hit,
+                           uint64_t *ret_cnt_miss);
+
+/**
+ * @brief  Print hits, misses, hit rate and evictions of the cache.
+ */
+void alignCache_printStatistics(AlignCache *cache, FILE *fp);
+
+void _testSet_alignCache();
+
+#endif
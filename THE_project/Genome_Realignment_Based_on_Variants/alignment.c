@@ -1,31 +1,44 @@
 #include "alignment.h"
 
+#include "alignCache.h"
+#include "auxiliaryMethods.h"
+
 /*
- * This table is used to transform nucleotide letters into numbers.
- * Only used for "align_ssw()"
+ * Aligners recorded in the key of alignment cache.
  */
-static int8_t nt_table[256];
+#define ALIGNER_KSW2 1
+#define ALIGNER_KSW2_DUALAFFINE 2
+#define ALIGNER_SSW 3
 
-// Scoring matrix
-static int8_t scoreMat[25];
+AlignContext *init_AlignContext() {
+  AlignContext *ac = (AlignContext *)calloc(1, sizeof(AlignContext));
+  alignInitialize(SCORE_DEFAULT_MATCH, SCORE_DEFAULT_MISMATCH,
+                  SCORE_DEFAULT_GAPOPEN, SCORE_DEFAULT_GAPEXTENSION, ac);
+  alignInitialize_ksw2(KSW2_DEFAULT_BANDWIDTH, KSW2_DEFAULT_ZDROP,
+                       KSW2_DEFAULT_FLAG, ac);
+  alignInitialize_dualAffine(SCORE_DEFAULT_GAPOPEN2,
+                             SCORE_DEFAULT_GAPEXTENSION2, ac);
+  ac->cache = NULL;
+  return ac;
+}
 
-static int ksw2_bandWidth = KSW2_DEFAULT_BANDWIDTH;
-static int ksw2_zdrop = KSW2_DEFAULT_ZDROP;
-static int ksw2_flag = KSW2_DEFAULT_FLAG;
+AlignContext *copy_AlignContext(const AlignContext *ac) {
+  AlignContext *ac_copy = (AlignContext *)malloc(sizeof(AlignContext));
+  *ac_copy = *ac;
+  return ac_copy;
+}
 
-static int score_match = SCORE_DEFAULT_MATCH;
-static int score_mismatch = SCORE_DEFAULT_MISMATCH;
-static int score_gapOpen = SCORE_DEFAULT_GAPOPEN;
-static int score_gapExtension = SCORE_DEFAULT_GAPEXTENSION;
+void destroy_AlignContext(AlignContext *ac) { free(ac); }
 
-void alignInitialize(int match, int mismatch, int gapOpen, int gapExtension) {
+void alignInitialize(int match, int mismatch, int gapOpen, int gapExtension,
+                     AlignContext *ac) {
   // Inappropriate scores will result in odd cigars (especially when you get
   // confused on whether gapOpen and gapExtension should be positive or
   // negative). match, gapOpen, gapExtension > 0, mismatch < 0
-  score_match = match > 0 ? match : -match;
-  score_mismatch = mismatch < 0 ? mismatch : -mismatch;
-  score_gapOpen = gapOpen > 0 ? gapOpen : -gapOpen;
-  score_gapExtension = gapExtension > 0 ? gapExtension : -gapExtension;
+  ac->score_match = match > 0 ? match : -match;
+  ac->score_mismatch = mismatch < 0 ? mismatch : -mismatch;
+  ac->score_gapOpen = gapOpen > 0 ? gapOpen : -gapOpen;
+  ac->score_gapExtension = gapExtension > 0 ? gapExtension : -gapExtension;
   // initialize scoring matrix for genome sequences. For example,
   // when match = 2, and mismatch = -2, the matrix is:
   //  A  C  G  T	N (or other ambiguous code)
@@ -37,32 +50,59 @@ void alignInitialize(int match, int mismatch, int gapOpen, int gapExtension) {
   for (int i = 0; i < 4; i++) {
     for (int j = 0; j < 4; j++) {
       if (i == j) {
-        scoreMat[i * 5 + j] = score_match;
+        ac->scoreMat[i * 5 + j] = ac->score_match;
       } else {
-        scoreMat[i * 5 + j] = score_mismatch;
+        ac->scoreMat[i * 5 + j] = ac->score_mismatch;
       }
     }
   }
   for (int i = 0; i < 5; i++) {
-    scoreMat[i * 5 - 1] = 0;  // the last column
-    scoreMat[20 + i] = 0;     // the last row
+    ac->scoreMat[i * 5 + 4] = 0;  // the last column
+    ac->scoreMat[20 + i] = 0;     // the last row
   }
   // Initialize the encoding matrix for bases
-  memset(nt_table, 4, 256);
-  nt_table['A'] = nt_table['a'] = 0;
-  nt_table['C'] = nt_table['c'] = 1;
-  nt_table['G'] = nt_table['g'] = 2;
-  nt_table['T'] = nt_table['t'] = 3;
+  memset(ac->nt_table, 4, 256);
+  ac->nt_table['A'] = ac->nt_table['a'] = 0;
+  ac->nt_table['C'] = ac->nt_table['c'] = 1;
+  ac->nt_table['G'] = ac->nt_table['g'] = 2;
+  ac->nt_table['T'] = ac->nt_table['t'] = 3;
 }
 
-void alignInitialize_ksw2(int bandWidth, int zdrop, int flag) {
-  ksw2_bandWidth = bandWidth;
-  ksw2_zdrop = zdrop;
-  ksw2_flag = flag;
+void alignInitialize_ksw2(int bandWidth, int zdrop, int flag,
+                          AlignContext *ac) {
+  ac->ksw2_bandWidth = bandWidth;
+  ac->ksw2_zdrop = zdrop;
+  ac->ksw2_flag = flag;
 }
 
-void align_ksw2(const char *tseq, const int tlen, const char *qseq,
-                const int qlen, AlignResult *ar) {
+void alignInitialize_dualAffine(int gapOpen2, int gapExtension2,
+                                AlignContext *ac) {
+  ac->score_gapOpen2 = gapOpen2 > 0 ? gapOpen2 : -gapOpen2;
+  ac->score_gapExtension2 = gapExtension2 > 0 ? gapExtension2 : -gapExtension2;
+}
+
+void alignInitialize_cache(int capacity, AlignContext *ac) {
+  destroy_AlignCache(ac->cache);
+  ac->cache = init_AlignCache(capacity);
+}
+
+void alignDestroy_cache(AlignContext *ac) {
+  alignCache_printStatistics(ac->cache, stdout);
+  destroy_AlignCache(ac->cache);
+  ac->cache = NULL;
+}
+
+/**
+ * @brief  Do global alignment with ksw2, using single or dual affine gap
+ * penalties.
+ * @param  ifReversed: read both sequences from the end to the beginning while
+ * encoding them, so that reversed sequences need not be copied.
+ */
+static void align_ksw2_process(const char *tseq, const int tlen,
+                               const char *qseq, const int qlen,
+                               const int bandWidth, const int ifDualAffine,
+                               const int ifReversed, AlignResult *ar,
+                               const AlignContext *ac) {
   // printf("target seq(%d): %s\n", tlen, tseq);
   // printf("query seq(%d): %s\n", qlen, qseq);
   if (ar == NULL) {
@@ -74,8 +114,38 @@ void align_ksw2(const char *tseq, const int tlen, const char *qseq,
   uint8_t *numTseq = (uint8_t *)calloc(tlen, sizeof(uint8_t));
   uint8_t *numQseq = (uint8_t *)calloc(qlen, sizeof(uint8_t));
 
-  for (int i = 0; i < tlen; i++) numTseq[i] = nt_table[(uint8_t)tseq[i]];
-  for (int i = 0; i < qlen; i++) numQseq[i] = nt_table[(uint8_t)qseq[i]];
+  if (ifReversed) {
+    const uint8_t *tseq_end = (const uint8_t *)tseq + tlen - 1;
+    const uint8_t *qseq_end = (const uint8_t *)qseq + qlen - 1;
+    for (int i = 0; i < tlen; i++) numTseq[i] = ac->nt_table[*(tseq_end - i)];
+    for (int i = 0; i < qlen; i++) numQseq[i] = ac->nt_table[*(qseq_end - i)];
+  } else {
+    for (int i = 0; i < tlen; i++) numTseq[i] = ac->nt_table[(uint8_t)tseq[i]];
+    for (int i = 0; i < qlen; i++) numQseq[i] = ac->nt_table[(uint8_t)qseq[i]];
+  }
+
+  // Look up results of identical alignments
+  AlignCacheKey key;
+  if (ac->cache != NULL) {
+    const int32_t params[] = {
+        ifDualAffine ? ALIGNER_KSW2_DUALAFFINE : ALIGNER_KSW2,
+        ac->score_match,
+        ac->score_mismatch,
+        ac->score_gapOpen,
+        ac->score_gapExtension,
+        ifDualAffine ? ac->score_gapOpen2 : 0,
+        ifDualAffine ? ac->score_gapExtension2 : 0,
+        bandWidth,
+        ac->ksw2_zdrop,
+        ac->ksw2_flag};
+    key = alignCache_key(numTseq, tlen, numQseq, qlen, params,
+                         sizeof(params) / sizeof(int32_t));
+    if (alignCache_get(ac->cache, &key, ar)) {
+      free(numTseq);
+      free(numQseq);
+      return;
+    }
+  }
 
   // Initialize alignment structures
   ksw_extz_t ez;
@@ -83,18 +153,27 @@ void align_ksw2(const char *tseq, const int tlen, const char *qseq,
   void *km = 0;
 
   // Align
-  // ksw_extz(km, qlen, numQseq, tlen, numTseq, 5, scoreMat, score_gapOpen,
-  //          score_gapExtension, ksw2_bandWidth, ksw2_zdrop, ksw2_flag, &ez);
-  ksw_extz2_sse(km, qlen, numQseq, tlen, numTseq, 5, scoreMat, score_gapOpen,
-                score_gapExtension, ksw2_bandWidth, ksw2_zdrop, 0, ksw2_flag,
-                &ez);
+  // ksw_extz(km, qlen, numQseq, tlen, numTseq, 5, ac->scoreMat,
+  //          ac->score_gapOpen, ac->score_gapExtension, ac->ksw2_bandWidth,
+  //          ac->ksw2_zdrop, ac->ksw2_flag, &ez);
+  if (ifDualAffine) {
+    ksw_extd2_sse(km, qlen, numQseq, tlen, numTseq, 5, ac->scoreMat,
+                  ac->score_gapOpen, ac->score_gapExtension,
+                  ac->score_gapOpen2, ac->score_gapExtension2, bandWidth,
+                  ac->ksw2_zdrop, 0, ac->ksw2_flag, &ez);
+  } else {
+    ksw_extz2_sse(km, qlen, numQseq, tlen, numTseq, 5, ac->scoreMat,
+                  ac->score_gapOpen, ac->score_gapExtension, bandWidth,
+                  ac->ksw2_zdrop, 0, ac->ksw2_flag, &ez);
+  }
   // This one gets different result with other methods. Don't use this
   // ez.score = ksw_gg2_sse(km, qlen, (uint8_t *)qseq, tlen, (uint8_t *)tseq, 5,
-  //                        scoreMat, score_gapOpen, score_gapExtension,
-  //                        ksw2_bandWidth,
+  //                        ac->scoreMat, ac->score_gapOpen,
+  //                        ac->score_gapExtension, ac->ksw2_bandWidth,
   //                        &(ez.m_cigar), &(ez.n_cigar), &(ez.cigar));
-  // ez.score = ksw_gg2_sse(km, qlen, numQseq, tlen, numTseq, 5, scoreMat,
-  //                        score_gapOpen, score_gapExtension, ksw2_bandWidth,
+  // ez.score = ksw_gg2_sse(km, qlen, numQseq, tlen, numTseq, 5, ac->scoreMat,
+  //                        ac->score_gapOpen, ac->score_gapExtension,
+  //                        ac->ksw2_bandWidth,
   //                        &(ez.m_cigar), &(ez.n_cigar), &(ez.cigar));
 
   // Create CIGAR in alignment result
@@ -115,13 +194,41 @@ void align_ksw2(const char *tseq, const int tlen, const char *qseq,
   ar->read_begin = 0;
   ar->read_end = qlen - 1;
 
+  if (ac->cache != NULL) alignCache_put(ac->cache, &key, ar);
+
   kfree(km, ez.cigar);
   free(numTseq);
   free(numQseq);
 }
 
+void align_ksw2(const char *tseq, const int tlen, const char *qseq,
+                const int qlen, AlignResult *ar, const AlignContext *ac) {
+  align_ksw2_process(tseq, tlen, qseq, qlen, ac->ksw2_bandWidth, 0, 0, ar,
+                     ac);
+}
+
+void align_ksw2_banded(const char *tseq, const int tlen, const char *qseq,
+                       const int qlen, const int bandWidth, AlignResult *ar,
+                       const AlignContext *ac) {
+  align_ksw2_process(tseq, tlen, qseq, qlen, bandWidth, 0, 0, ar, ac);
+}
+
+void align_ksw2_dualAffine(const char *tseq, const int tlen, const char *qseq,
+                           const int qlen, const int bandWidth,
+                           AlignResult *ar, const AlignContext *ac) {
+  align_ksw2_process(tseq, tlen, qseq, qlen, bandWidth, 1, 0, ar, ac);
+}
+
+void align_ksw2_reversed(const char *tseq, const int tlen, const char *qseq,
+                         const int qlen, const int bandWidth,
+                         const int ifDualAffine, AlignResult *ar,
+                         const AlignContext *ac) {
+  align_ksw2_process(tseq, tlen, qseq, qlen, bandWidth, ifDualAffine, 1, ar,
+                     ac);
+}
+
 void align_ssw(const char *tseq, const int tlen, const char *qseq,
-               const int qlen, AlignResult *ar) {
+               const int qlen, AlignResult *ar, const AlignContext *ac) {
   // printf("target seq(%d): %s\n", tlen, tseq);
   // printf("query seq(%d): %s\n", qlen, qseq);
   if (ar == NULL) {
@@ -132,18 +239,32 @@ void align_ssw(const char *tseq, const int tlen, const char *qseq,
   int8_t *numRead = (int8_t *)malloc(qlen + 1);
   int8_t *numRef = (int8_t *)malloc(tlen + 1);
 
-  for (int i = 0; i < qlen; i++) numRead[i] = nt_table[(int)qseq[i]];
-  for (int i = 0; i < tlen; i++) numRef[i] = nt_table[(int)tseq[i]];
+  for (int i = 0; i < qlen; i++) numRead[i] = ac->nt_table[(int)qseq[i]];
+  for (int i = 0; i < tlen; i++) numRef[i] = ac->nt_table[(int)tseq[i]];
+
+  // Look up results of identical alignments
+  AlignCacheKey key;
+  if (ac->cache != NULL) {
+    const int32_t params[] = {ALIGNER_SSW, ac->score_match, ac->score_mismatch,
+                              ac->score_gapOpen, ac->score_gapExtension};
+    key = alignCache_key((uint8_t *)numRef, tlen, (uint8_t *)numRead, qlen,
+                         params, sizeof(params) / sizeof(int32_t));
+    if (alignCache_get(ac->cache, &key, ar)) {
+      free(numRef);
+      free(numRead);
+      return;
+    }
+  }
 
   // Initialize alignment structures
   s_profile *profile;
-  profile = ssw_init(numRead, qlen, scoreMat, 5, 2);
+  profile = ssw_init(numRead, qlen, ac->scoreMat, 5, 2);
 
   // Align
   // See instructions for ssw_align about the value of "maskLen"
   int maskLen = qlen / 2 >= 15 ? qlen / 2 : 15;
-  s_align *result = ssw_align(profile, numRef, tlen, score_gapOpen,
-                              score_gapExtension, 1, 0, 0, maskLen);
+  s_align *result = ssw_align(profile, numRef, tlen, ac->score_gapOpen,
+                              ac->score_gapExtension, 1, 0, 0, maskLen);
 
   // Create CIGAR in alignment result
   if (result->read_begin1 != 0) {  // There exists insetions at the beginning
@@ -181,6 +302,8 @@ void align_ssw(const char *tseq, const int tlen, const char *qseq,
   ar->read_begin = result->read_begin1;
   ar->read_end = result->read_end1;
 
+  if (ac->cache != NULL) alignCache_put(ac->cache, &key, ar);
+
   init_destroy(profile);
   align_destroy(result);
   free(numRef);
@@ -199,43 +322,192 @@ void align_ssw(const char *tseq, const int tlen, const char *qseq,
 /****************************************************************/
 /****************************************************************/
 
-static int _test_ksw2Alignment(const char *tseq, const char *qseq) {
+static int _test_ksw2Alignment(const char *tseq, const char *qseq,
+                               AlignContext *ac) {
   printf(" - ksw2 align\n");
   printf("tseq: %s\nqseq: %s\n", tseq, qseq);
   AlignResult *ar = init_AlignResult();
   const int tlen = strlen(tseq);
   const int qlen = strlen(qseq);
-  align_ksw2(tseq, tlen, qseq, qlen, ar);
+  align_ksw2(tseq, tlen, qseq, qlen, ar, ac);
   print_AlignResult(ar);
   destroy_AlignResult(ar);
   return 1;
 }
 
-static int _test_sswAlignment(const char *tseq, const char *qseq) {
+static int _test_ksw2AdaptiveBand(const char *tseq, const char *qseq,
+                                  int length_indel, AlignContext *ac) {
+  printf(" - ksw2 align with adaptive band\n");
+  const int tlen = strlen(tseq);
+  const int qlen = strlen(qseq);
+  int bandWidth = ksw2_adaptiveBandWidth(tlen, qlen, length_indel);
+  AlignResult *ar_full = init_AlignResult();
+  AlignResult *ar_banded = init_AlignResult();
+  align_ksw2_banded(tseq, tlen, qseq, qlen, -1, ar_full, ac);
+  align_ksw2_banded(tseq, tlen, qseq, qlen, bandWidth, ar_banded, ac);
+  // The banded alignment must stay global and get the same cigar
+  int ifSame = ar_full->cnt_cigar == ar_banded->cnt_cigar &&
+               ar_full->mapq == ar_banded->mapq;
+  for (int i = 0; ifSame && i < ar_full->cnt_cigar; i++) {
+    ifSame = ar_full->cigarLen[i] == ar_banded->cigarLen[i] &&
+             ar_full->cigarOp[i] == ar_banded->cigarOp[i];
+  }
+  print_AlignResult(ar_banded);
+  destroy_AlignResult(ar_full);
+  destroy_AlignResult(ar_banded);
+  return ifSame;
+}
+
+static int _test_ksw2DualAffine(const char *tseq, const char *qseq,
+                                int length_del, AlignContext *ac) {
+  printf(" - ksw2 align with dual-affine gap penalties\n");
+  const int tlen = strlen(tseq);
+  const int qlen = strlen(qseq);
+  AlignResult *ar_single = init_AlignResult();
+  AlignResult *ar_dual = init_AlignResult();
+  align_ksw2_banded(tseq, tlen, qseq, qlen, -1, ar_single, ac);
+  align_ksw2_dualAffine(tseq, tlen, qseq, qlen, -1, ar_dual, ac);
+  print_AlignResult(ar_single);
+  print_AlignResult(ar_dual);
+  // The long deletion should be kept as a single 'D'
+  int cnt_del = 0;
+  for (int i = 0; i < ar_dual->cnt_cigar; i++) {
+    if (ar_dual->cigarOp[i] == 'D') cnt_del++;
+  }
+  // Every base of the read is matched, and the deletion is charged by the
+  // second gap penalties, which are cheaper than the first ones for it
+  int score_dual = ac->score_match * qlen -
+                   (ac->score_gapOpen2 + length_del * ac->score_gapExtension2);
+  int score_single = ac->score_match * qlen -
+                     (ac->score_gapOpen + length_del * ac->score_gapExtension);
+  int ifDual = cnt_del == 1 && score_single < score_dual &&
+               ar_dual->mapq == score_dual &&
+               ar_single->mapq == score_single;
+  destroy_AlignResult(ar_single);
+  destroy_AlignResult(ar_dual);
+  return ifDual;
+}
+
+static int _test_ksw2Reversed(const char *tseq, const char *qseq,
+                              AlignContext *ac) {
+  printf(" - ksw2 align with reversed sequences\n");
+  const int tlen = strlen(tseq);
+  const int qlen = strlen(qseq);
+  char *tseq_rev = revStr(tseq, tlen);
+  char *qseq_rev = revStr(qseq, qlen);
+  AlignResult *ar_copied = init_AlignResult();
+  AlignResult *ar_reversed = init_AlignResult();
+  align_ksw2_banded(tseq_rev, tlen, qseq_rev, qlen, -1, ar_copied, ac);
+  align_ksw2_reversed(tseq, tlen, qseq, qlen, -1, 0, ar_reversed, ac);
+  // Aligning reversed copies and reading the originals backwards are the same
+  int ifSame = ar_copied->cnt_cigar == ar_reversed->cnt_cigar &&
+               ar_copied->mapq == ar_reversed->mapq;
+  for (int i = 0; ifSame && i < ar_copied->cnt_cigar; i++) {
+    ifSame = ar_copied->cigarLen[i] == ar_reversed->cigarLen[i] &&
+             ar_copied->cigarOp[i] == ar_reversed->cigarOp[i];
+  }
+  print_AlignResult(ar_reversed);
+  destroy_AlignResult(ar_copied);
+  destroy_AlignResult(ar_reversed);
+  free(tseq_rev);
+  free(qseq_rev);
+  return ifSame;
+}
+
+static int _test_sswAlignment(const char *tseq, const char *qseq,
+                              AlignContext *ac) {
   // printf(" - ssw align\n");
   // printf("tseq: %s\nqseq: %s\n", tseq, qseq);
   AlignResult *ar = init_AlignResult();
   const int tlen = strlen(tseq);
   const int qlen = strlen(qseq);
-  align_ssw(tseq, tlen, qseq, qlen, ar);
+  align_ssw(tseq, tlen, qseq, qlen, ar, ac);
   // print_AlignResult(ar);
   destroy_AlignResult(ar);
   return 1;
 }
 
+static int _test_independentContexts(const char *tseq, const char *qseq,
+                                     AlignContext *ac) {
+  printf(" - ksw2 align with 2 contexts\n");
+  const int tlen = strlen(tseq);
+  const int qlen = strlen(qseq);
+  // Gaps are too expensive for the copied context
+  AlignContext *ac_copy = copy_AlignContext(ac);
+  alignInitialize(2, -2, -40, -10, ac_copy);
+  AlignResult *ar = init_AlignResult();
+  AlignResult *ar_copy = init_AlignResult();
+  align_ksw2(tseq, tlen, qseq, qlen, ar, ac);
+  align_ksw2(tseq, tlen, qseq, qlen, ar_copy, ac_copy);
+  // The original context should not be affected
+  int ifIndependent = ac->score_gapOpen != ac_copy->score_gapOpen &&
+                      ar->cnt_cigar != ar_copy->cnt_cigar;
+  printf("cigar (original context): ");
+  for (int i = 0; i < ar->cnt_cigar; i++) {
+    printf("%" PRIu32 "%c", ar->cigarLen[i], ar->cigarOp[i]);
+  }
+  printf("\ncigar (copied context): ");
+  for (int i = 0; i < ar_copy->cnt_cigar; i++) {
+    printf("%" PRIu32 "%c", ar_copy->cigarLen[i], ar_copy->cigarOp[i]);
+  }
+  printf("\n");
+  destroy_AlignResult(ar);
+  destroy_AlignResult(ar_copy);
+  destroy_AlignContext(ac_copy);
+  return ifIndependent;
+}
+
 void _testSet_alignment() {
   // default parameters for genome sequence alignment
   static int32_t match = 2, mismatch = -2;
   static int32_t gapOpen = -6, gapExtension = -1;
-  alignInitialize(match, mismatch, gapOpen, gapExtension);
+  AlignContext *ac = init_AlignContext();
+  alignInitialize(match, mismatch, gapOpen, gapExtension, ac);
   alignInitialize_ksw2(KSW2_DEFAULT_BANDWIDTH, KSW2_DEFAULT_ZDROP,
-                       KSW2_FLAG_RIGHTONLY);
+                       KSW2_FLAG_RIGHTONLY, ac);
 
   // test cases
   printf("testing alignment ...\n");
   static const char *tseq = "ACGCTAGAAGAAATCCTCAGATAAGCCAAAGCTGGTGATGACCTG";
   static const char *qseq = "ACGAAGAAATCC";
 
-  assert(_test_ksw2Alignment(tseq, qseq));
-  assert(_test_sswAlignment(tseq, qseq));
+  assert(_test_ksw2Alignment(tseq, qseq, ac));
+  assert(_test_sswAlignment(tseq, qseq, ac));
+
+  // 9bp INS integrated into tseq_indel; the read still carries it
+  static const char *tseq_indel =
+      "ACGCTAGAAGAAATCCTCAGATAAGCCAAAGCTGGTGATGACCTGGCTTAGCAATGC";
+  static const char *qseq_indel =
+      "ACGCTAGAAGAAATCCTCAAAGCTGGTGATGACCTGGCTTAGCAATGC";
+  assert(_test_ksw2AdaptiveBand(tseq_indel, qseq_indel, 9, ac));
+  assert(_test_ksw2Reversed(tseq_indel, qseq_indel, ac));
+
+  // A shifted block: 1bp DEL + 1bp INS, or mismatches if gaps are expensive
+  static const char *tseq_shift = "AAAAACGTACGTTTTTGCA";
+  static const char *qseq_shift = "AAAACGTACGTTTTTTGCA";
+  assert(_test_independentContexts(tseq_shift, qseq_shift, ac));
+
+  // The second alignment should be taken from the cache. Each test aligns
+  // with the full band and the adaptive band.
+  uint64_t cnt_hit = 0, cnt_miss = 0;
+  alignInitialize_cache(64, ac);
+  assert(_test_ksw2AdaptiveBand(tseq_indel, qseq_indel, 9, ac));
+  alignCache_statistics(ac->cache, &cnt_hit, &cnt_miss);
+  assert(cnt_hit == 0 && cnt_miss == 2);
+  assert(_test_ksw2AdaptiveBand(tseq_indel, qseq_indel, 9, ac));
+  alignCache_statistics(ac->cache, &cnt_hit, &cnt_miss);
+  assert(cnt_hit == 2 && cnt_miss == 2);
+  alignDestroy_cache(ac);
+
+  // 61bp DEL in the middle of the read
+  alignInitialize_dualAffine(SCORE_DEFAULT_GAPOPEN2,
+                             SCORE_DEFAULT_GAPEXTENSION2, ac);
+  static const char *tseq_sv =
+      "ACGCTAGAAGAAATCCTCAGATAAGCCAAAGCTGGTGATGACCTGGCTTAGCAATGCTTGACAGTCCAT"
+      "GGATCCGATTACGGCATCAAGTCGTTAGCCAATGGCATTCGA";
+  static const char *qseq_sv =
+      "ACGCTAGAAGAAATCCTCAGATAAGCCAAAGGTTAGCCAATGGCATTCGA";
+  assert(_test_ksw2DualAffine(tseq_sv, qseq_sv, 61, ac));
+
+  destroy_AlignContext(ac);
 }
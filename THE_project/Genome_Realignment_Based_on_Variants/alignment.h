@@ -21,6 +21,14 @@
 #define SCORE_DEFAULT_GAPOPEN -6
 #define SCORE_DEFAULT_GAPEXTENSION 1
 
+/*
+ * The second (long) gap penalty pair used in dual-affine mode. A gap of length
+ * l costs min(gapOpen + l * gapExtension, gapOpen2 + l * gapExtension2), so
+ * long SV indels are not broken into pieces by the linear extension penalty.
+ */
+#define SCORE_DEFAULT_GAPOPEN2 -24
+#define SCORE_DEFAULT_GAPEXTENSION2 0
+
 /*
  * Default parameters for ksw2 alignment.
  */
@@ -30,6 +38,38 @@
 #define KSW2_FLAG_RIGHTONLY KSW_EZ_RIGHT  // right-align gaps
 #define KSW2_FLAG_EXTENSION KSW_EZ_EXTZ_ONLY  // only perform extension
 
+/*
+ * Extra diagonals added to the adaptive band width on top of the indel
+ * lengths of a combination. It tolerates small indels on the read that are not
+ * recorded in the vcf file.
+ */
+#define KSW2_BANDWIDTH_MARGIN 16
+
+/*
+ * Scoring and parameters for alignment. Each thread should use its own copy of
+ * the context (see copy_AlignContext), so that different configurations can
+ * be used in one process.
+ */
+typedef struct _define_AlignContext {
+  // This table is used to transform nucleotide letters into numbers.
+  int8_t nt_table[256];
+  // Scoring matrix
+  int8_t scoreMat[25];
+
+  int ksw2_bandWidth;
+  int ksw2_zdrop;
+  int ksw2_flag;
+
+  int score_match;
+  int score_mismatch;
+  int score_gapOpen;
+  int score_gapExtension;
+  int score_gapOpen2;
+  int score_gapExtension2;
+
+  struct AlignCache *cache;  // shared by copies of the context; may be NULL
+} AlignContext;
+
 typedef struct _define_AlignResult {
   int64_t pos;
   int cnt_cigar;
@@ -80,16 +120,58 @@ static inline void fixPos_AlignResult(AlignResult *ar, int fixPos) {
   ar->pos += fixPos;
 }
 
+/**
+ * @brief  Create an AlignContext with default parameters. Please note that
+ * this object must be freed later using destroy_AlignContext(...).
+ */
+AlignContext *init_AlignContext();
+
+/**
+ * @brief  Create a copy of the context for another thread. The cache of
+ * alignment results is shared with the original context.
+ */
+AlignContext *copy_AlignContext(const AlignContext *ac);
+
+/**
+ * @brief  Free the context. The cache of alignment results is not freed. Use
+ * alignDestroy_cache(...) for it.
+ */
+void destroy_AlignContext(AlignContext *ac);
+
 /**
  * @brief  Initialize the scoring matrix for alignment. Use this method before
  * executing any alignments.
  */
-void alignInitialize(int match, int mismatch, int gapOpen, int gapExtension);
+void alignInitialize(int match, int mismatch, int gapOpen, int gapExtension,
+                     AlignContext *ac);
 
 /**
  * @brief  Initialize parameters for ksw2 alignment.
  */
-void alignInitialize_ksw2(int bandWidth, int zdrop, int flag);
+void alignInitialize_ksw2(int bandWidth, int zdrop, int flag,
+                          AlignContext *ac);
+
+/**
+ * @brief  Initialize the second gap penalty pair for dual-affine alignment.
+ * @note  gapOpen2 + gapExtension2 should be no less than gapOpen + gapExtension
+ * and gapExtension2 should be smaller than gapExtension. Otherwise the second
+ * pair is meaningless.
+ */
+void alignInitialize_dualAffine(int gapOpen2, int gapExtension2,
+                                AlignContext *ac);
+
+/**
+ * @brief  Initialize the cache of alignment results, which is shared by all
+ * copies of the context. Identical alignments (same sequences and parameters)
+ * will be done only once.
+ * @param  capacity: maximal number of cached results (<= 0 to disable)
+ */
+void alignInitialize_cache(int capacity, AlignContext *ac);
+
+/**
+ * @brief  Print hit rate of the cache of alignment results and free it.
+ */
+void alignDestroy_cache(AlignContext *ac);
 
 /**
  * @brief  Initialize an AlignResult object. Please note that this object must
@@ -122,7 +204,8 @@ static inline void destroy_AlignResult(AlignResult *ar) {
 
 /**
  * @brief  Do alignment using ksw2.
- * @note  The following paramters needs using "alignIntialize_ksw2" to set:
+ * @note  The following paramters in *ac needs using "alignIntialize_ksw2" to
+ * set:
  *  bandWidth: band with (< 0 to disable)
  *  zdrop: off-diagonal drop-off to stop extension (positive; <0 to disable)
  *  flag: flag (see KSW_EZ_* macros)
@@ -131,10 +214,62 @@ static inline void destroy_AlignResult(AlignResult *ar) {
  * @param  *qseq: query sequence
  * @param  qlen: length of query seqeunce
  * @param  *ar: pointer to the result of alignment
+ * @param  *ac: context of alignment
  * @retval None
  */
 void align_ksw2(const char *tseq, const int tlen, const char *qseq,
-                const int qlen, AlignResult *ar);
+                const int qlen, AlignResult *ar, const AlignContext *ac);
+
+/**
+ * @brief  Do alignment using ksw2 with a designated band width. Other
+ * parameters are the same as "align_ksw2".
+ * @param  bandWidth: band width for this alignment only (< 0 to disable)
+ */
+void align_ksw2_banded(const char *tseq, const int tlen, const char *qseq,
+                       const int qlen, const int bandWidth, AlignResult *ar,
+                       const AlignContext *ac);
+
+/**
+ * @brief  Do alignment using ksw2 with dual-affine gap penalties (see
+ * "alignInitialize_dualAffine"). Other parameters are the same as
+ * "align_ksw2_banded".
+ */
+void align_ksw2_dualAffine(const char *tseq, const int tlen, const char *qseq,
+                           const int qlen, const int bandWidth,
+                           AlignResult *ar, const AlignContext *ac);
+
+/**
+ * @brief  Align the reversed target sequence with the reversed query sequence
+ * using ksw2. The sequences are read backwards while being encoded, so there
+ * is no need to reverse them in advance.
+ * @param  *tseq: target sequence (not reversed)
+ * @param  *qseq: query sequence (not reversed)
+ * @param  bandWidth: band width for this alignment only (< 0 to disable)
+ * @param  ifDualAffine: use dual-affine gap penalties if not 0
+ */
+void align_ksw2_reversed(const char *tseq, const int tlen, const char *qseq,
+                         const int qlen, const int bandWidth,
+                         const int ifDualAffine, AlignResult *ar,
+                         const AlignContext *ac);
+
+/**
+ * @brief  Calculate the band width for aligning a read against a sequence
+ * integrated with a combination of variants.
+ * @note  The band must cover the length difference of the 2 sequences, or ksw2
+ * cannot reach the end of the global alignment. Besides, if the read doesn't
+ * carry the integrated variants, the path will leave the diagonal by at most
+ * the total length of integrated indels.
+ * @param  tlen: length of target sequence
+ * @param  qlen: length of query seqeunce
+ * @param  length_indel: sum of |len(ALT) - len(REF)| of integrated alleles
+ * @retval band width for ksw2
+ */
+static inline int ksw2_adaptiveBandWidth(const int tlen, const int qlen,
+                                         const int length_indel) {
+  int diff_length = tlen > qlen ? tlen - qlen : qlen - tlen;
+  int bandWidth = diff_length > length_indel ? diff_length : length_indel;
+  return bandWidth + KSW2_BANDWIDTH_MARGIN;
+}
 
 /**
  * @brief  Do alignment using ssw.
@@ -144,10 +279,11 @@ void align_ksw2(const char *tseq, const int tlen, const char *qseq,
  * @param  *qseq: query sequence
  * @param  qlen: length of query seqeunce
  * @param  *ar: pointer to the result of alignment
+ * @param  *ac: context of alignment
  * @retval None
  */
 void align_ssw(const char *tseq, const int tlen, const char *qseq,
-               const int qlen, AlignResult *ar);
+               const int qlen, AlignResult *ar, const AlignContext *ac);
 
 void _testSet_alignment();
 
@@ -133,9 +133,9 @@ static void recurse_combinations_alleles(Element_RecVcf *rvArray[],
       // coverse the temporarily under-checking allele
       Element_RecVcf *lastSelectedErv = rvArray[rvCombi[idx_combi_new - 1]];
       Element_RecVcf *tmpSelectedErv = rvArray[rvCombi[idx_combi_new]];
+      const AlleleInfoVcf *infos = rv_alleleInfos(lastSelectedErv->rv);
       if (rv_pos(lastSelectedErv->rv) +
-              rv_alleleCoverLength(lastSelectedErv->rv,
-                                   combi_new[idx_combi_new - 1]) >
+              infos[combi_new[idx_combi_new - 1]].length_cover >
           rv_pos(tmpSelectedErv->rv)) {
         // If the last selected allele covers this allele, ignore it
         continue;
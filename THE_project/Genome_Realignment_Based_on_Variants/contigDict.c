@@ -0,0 +1,209 @@
+#include "contigDict.h"
+
+/*********************************************************************
+ *                         Structures and Accessors
+ ********************************************************************/
+
+struct ContigDict {
+  int32_t cnt;         // number of contigs
+  int32_t capacity;    // size of names
+  char **names;        // names[id]
+  uint64_t *hashes;    // hashes[id]: hash value of names[id]
+  int32_t size_table;  // size of the hash table (power of 2)
+  int32_t *table;      // open addressing hash table of ids; -1 for empty slots
+};
+
+/*********************************************************************
+ *                  Auxiliary Structures and Methods
+ ********************************************************************/
+
+/**
+ * @brief  64-bit FNV-1a hash of a string.
+ */
+static inline uint64_t hash_name(const char *name) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++) {
+    h ^= *c;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+/**
+ * @brief  Find the slot of a name in the hash table.
+ * @retval index of the slot keeping the name, or the empty slot where the name
+ * should be kept.
+ */
+static inline int32_t contigDict_slot(const ContigDict *cd, const char *name,
+                                      uint64_t hash) {
+  const int32_t mask = cd->size_table - 1;
+  int32_t idx_slot = (int32_t)(hash & mask);
+  while (cd->table[idx_slot] >= 0) {
+    int32_t id = cd->table[idx_slot];
+    if (cd->hashes[id] == hash && strcmp(cd->names[id], name) == 0) break;
+    idx_slot = (idx_slot + 1) & mask;  // linear probing
+  }
+  return idx_slot;
+}
+
+/**
+ * @brief  Double the size of the hash table and re-hash all names.
+ */
+static void contigDict_rehash(ContigDict *cd) {
+  free(cd->table);
+  cd->size_table *= 2;
+  cd->table = (int32_t *)malloc(cd->size_table * sizeof(int32_t));
+  if (cd->table == NULL) {
+    fprintf(stderr, "Error: memory not enough for the contig dictionary.\n");
+    exit(EXIT_FAILURE);
+  }
+  memset(cd->table, -1, cd->size_table * sizeof(int32_t));
+  for (int32_t id = 0; id < cd->cnt; id++) {
+    cd->table[contigDict_slot(cd, cd->names[id], cd->hashes[id])] = id;
+  }
+}
+
+/*********************************************************************
+ *                            Basic Functions
+ ********************************************************************/
+
+ContigDict *init_ContigDict() {
+  ContigDict *cd = (ContigDict *)calloc(1, sizeof(ContigDict));
+  if (cd == NULL) {
+    fprintf(stderr, "Error: memory not enough for the contig dictionary.\n");
+    exit(EXIT_FAILURE);
+  }
+  cd->size_table = 8;
+  cd->table = (int32_t *)malloc(cd->size_table * sizeof(int32_t));
+  memset(cd->table, -1, cd->size_table * sizeof(int32_t));
+  return cd;
+}
+
+void destroy_ContigDict(ContigDict *cd) {
+  if (cd == NULL) return;
+  for (int32_t id = 0; id < cd->cnt; id++) free(cd->names[id]);
+  free(cd->names);
+  free(cd->hashes);
+  free(cd->table);
+  free(cd);
+}
+
+int32_t contigDict_add(ContigDict *cd, const char *name) {
+  uint64_t hash = hash_name(name);
+  int32_t idx_slot = contigDict_slot(cd, name, hash);
+  if (cd->table[idx_slot] >= 0) return cd->table[idx_slot];
+  if (cd->cnt == cd->capacity) {
+    cd->capacity = cd->capacity == 0 ? 16 : cd->capacity * 2;
+    cd->names = (char **)realloc(cd->names, cd->capacity * sizeof(char *));
+    cd->hashes =
+        (uint64_t *)realloc(cd->hashes, cd->capacity * sizeof(uint64_t));
+    if (cd->names == NULL || cd->hashes == NULL) {
+      fprintf(stderr, "Error: memory not enough for the contig dictionary.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  int32_t id = cd->cnt++;
+  cd->names[id] = strdup(name);
+  cd->hashes[id] = hash;
+  cd->table[idx_slot] = id;
+  // Keep the load factor of the hash table no more than 1/2
+  if (cd->cnt * 2 > cd->size_table) contigDict_rehash(cd);
+  return id;
+}
+
+int32_t contigDict_id(const ContigDict *cd, const char *name) {
+  if (cd == NULL || name == NULL) return -1;
+  return cd->table[contigDict_slot(cd, name, hash_name(name))];
+}
+
+const char *contigDict_name(const ContigDict *cd, int32_t id) {
+  if (id < 0 || id >= cd->cnt) return NULL;
+  return cd->names[id];
+}
+
+int32_t contigDict_cnt(const ContigDict *cd) { return cd->cnt; }
+
+ContigTable *init_ContigTable(const ContigDict *base, const ContigDict **dicts,
+                              int cnt_dict) {
+  ContigTable *ct = (ContigTable *)malloc(sizeof(ContigTable));
+  ct->cnt_contig = base->cnt;
+  ct->cnt_dict = cnt_dict;
+  ct->ids = (int32_t **)malloc(cnt_dict * sizeof(int32_t *));
+  for (int i = 0; i < cnt_dict; i++) {
+    ct->ids[i] = (int32_t *)malloc((base->cnt + 1) * sizeof(int32_t));
+    for (int32_t id = 0; id < base->cnt; id++) {
+      ct->ids[i][id] = contigDict_id(dicts[i], base->names[id]);
+    }
+  }
+  return ct;
+}
+
+void destroy_ContigTable(ContigTable *ct) {
+  if (ct == NULL) return;
+  for (int i = 0; i < ct->cnt_dict; i++) free(ct->ids[i]);
+  free(ct->ids);
+  free(ct);
+}
+
+/*********************************************************************
+ *                            Debug Functions
+ ********************************************************************/
+
+static void _test_AddAndLookup() {
+  ContigDict *cd = init_ContigDict();
+  const int cnt_contig = 5000;  // forces several re-hashes
+  char name[32];
+  for (int i = 0; i < cnt_contig; i++) {
+    sprintf(name, "chrUn_%d_decoy", i);
+    assert(contigDict_add(cd, name) == i);
+  }
+  assert(contigDict_cnt(cd) == cnt_contig);
+  // Adding an existing name returns its id
+  assert(contigDict_add(cd, "chrUn_42_decoy") == 42);
+  assert(contigDict_cnt(cd) == cnt_contig);
+  for (int i = 0; i < cnt_contig; i++) {
+    sprintf(name, "chrUn_%d_decoy", i);
+    assert(contigDict_id(cd, name) == i);
+    assert(strcmp(contigDict_name(cd, i), name) == 0);
+  }
+  assert(contigDict_id(cd, "chrUn_decoy") == -1);
+  assert(contigDict_id(cd, "") == -1);
+  assert(contigDict_name(cd, -1) == NULL);
+  assert(contigDict_name(cd, cnt_contig) == NULL);
+  destroy_ContigDict(cd);
+}
+
+static void _test_Table() {
+  // sam header, reference genome and vcf file with contigs in different orders
+  const char *names_sam[] = {"chr1", "chr2", "chrM", "chrUn"};
+  const char *names_fa[] = {"header", "chrM", "chr2", "chr1"};
+  const char *names_vcf[] = {"chr2", "chr1"};
+  ContigDict *cd_sam = init_ContigDict();
+  ContigDict *cd_fa = init_ContigDict();
+  ContigDict *cd_vcf = init_ContigDict();
+  for (int i = 0; i < 4; i++) contigDict_add(cd_sam, names_sam[i]);
+  for (int i = 0; i < 4; i++) contigDict_add(cd_fa, names_fa[i]);
+  for (int i = 0; i < 2; i++) contigDict_add(cd_vcf, names_vcf[i]);
+
+  const ContigDict *dicts[2] = {cd_fa, cd_vcf};
+  ContigTable *ct = init_ContigTable(cd_sam, dicts, 2);
+  const int32_t ids_fa[] = {3, 2, 1, -1};
+  const int32_t ids_vcf[] = {1, 0, -1, -1};
+  for (int32_t tid = 0; tid < 4; tid++) {
+    assert(contigTable_id(ct, 0, tid) == ids_fa[tid]);
+    assert(contigTable_id(ct, 1, tid) == ids_vcf[tid]);
+  }
+  // Unmapped reads (tid = -1)
+  assert(contigTable_id(ct, 0, -1) == -1);
+  assert(contigTable_id(ct, 1, 4) == -1);
+
+  destroy_ContigTable(ct);
+  destroy_ContigDict(cd_sam);
+  destroy_ContigDict(cd_fa);
+  destroy_ContigDict(cd_vcf);
+}
+
+void _testSet_contigDict() {
+  _test_AddAndLookup();
+  _test_Table();
+}
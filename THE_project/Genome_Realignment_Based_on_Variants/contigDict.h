@@ -0,0 +1,96 @@
+#ifndef CONTIGDICT_H_INCLUDED
+#define CONTIGDICT_H_INCLUDED
+
+#pragma once
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+
+/*********************************************************************
+ *                         Structures and Accessors
+ ********************************************************************/
+
+/**
+ * @brief  Dictionary of contig names. Each name is given a 0-based id in order
+ * of adding, so the ids can be used as indexes of arrays (ChromFa objects of a
+ * GenomeFa, tids of a sam header, rids of a vcf header ...), while names are
+ * looked up in a hash table.
+ * @note   Once loaded, the dictionary is only read and thus can be shared by
+ * threads.
+ */
+typedef struct ContigDict ContigDict;
+
+/**
+ * @brief  Ids of the same contigs in several dictionaries, e.g. the sam header,
+ * the reference genome and the vcf file. Built once after loading, so that
+ * each lookup of a contig during processing is an array index.
+ */
+typedef struct _define_ContigTable {
+  int32_t cnt_contig;  // number of contigs in the base dictionary
+  int cnt_dict;        // number of the other dictionaries
+  int32_t **ids;       // ids[i][id_base]: id in the i-th dictionary; -1 if none
+} ContigTable;
+
+/**
+ * @brief  Get the id of a contig in the idx_dict-th dictionary of the table.
+ * @param  id_base: id of the contig in the base dictionary
+ * @retval -1 if the contig is not in that dictionary or id_base is invalid
+ */
+static inline int32_t contigTable_id(const ContigTable *ct, int idx_dict,
+                                     int32_t id_base) {
+  if (id_base < 0 || id_base >= ct->cnt_contig) return -1;
+  return ct->ids[idx_dict][id_base];
+}
+
+/*********************************************************************
+ *                            Basic Functions
+ ********************************************************************/
+
+ContigDict *init_ContigDict();
+
+void destroy_ContigDict(ContigDict *cd);
+
+/**
+ * @brief  Add a contig name into the dictionary.
+ * @param  *name: name of the contig. This method will create a copy of it.
+ * @retval id of the contig. If the name already exists, its existing id is
+ * returned.
+ */
+int32_t contigDict_add(ContigDict *cd, const char *name);
+
+/**
+ * @brief  Get the id of a contig by its name.
+ * @retval id of the contig; -1 if not found
+ */
+int32_t contigDict_id(const ContigDict *cd, const char *name);
+
+/**
+ * @brief  Get the name of a contig by its id.
+ * @retval name of the contig (do not free it); NULL if the id is invalid
+ */
+const char *contigDict_name(const ContigDict *cd, int32_t id);
+
+/**
+ * @brief  Get number of contigs in the dictionary.
+ */
+int32_t contigDict_cnt(const ContigDict *cd);
+
+/**
+ * @brief  Create a table that translates ids of contigs in the base dictionary
+ * into ids of the same contigs (with the same names) in other dictionaries.
+ * @param  **dicts: the other dictionaries
+ * @retval Must be freed later using destroy_ContigTable.
+ */
+ContigTable *init_ContigTable(const ContigDict *base, const ContigDict **dicts,
+                              int cnt_dict);
+
+void destroy_ContigTable(ContigTable *ct);
+
+void _testSet_contigDict();
+
+#endif
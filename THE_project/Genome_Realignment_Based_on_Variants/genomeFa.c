@@ -1,30 +1,39 @@
 #include "genomeFa.h"
 
+#include <fcntl.h>
+#include <htslib/bgzf.h>
+#include <htslib/hts.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /*********************************************************************
  *                Auxiliary Structures and Functions
  ********************************************************************/
 
 /**
  * @brief  A linked list without empty header. Designed for initializing
- * memories before loading reference genome.
+ * chromosomes whose lengths are known before their bases are coded (loaded
+ * from index files for example).
  */
 typedef struct ProfileFa ProfileFa;
 
 struct ProfileFa {
   char *info;                // info field of the chromosome
-  uint32_t length;           // length of the chromosome / cnt of bases
-  uint32_t absolute_offset;  // offset for absolute position of this chromosome
+  int64_t length;            // length of the chromosome / cnt of bases
+  int64_t absolute_offset;   // offset for absolute position of this chromosome
   ProfileFa *next;           // next chromosome's profile, if exists
 };
 
 // *************************** Declarations **************************
 
-/**
- * @brief  Initialize profiles from an input reference genome file and return
- * pointer to a linked list of ProfileFas without empty header.
- */
-ProfileFa *init_ProfileFa(const char *filePath);
-
 void print_ProfileFa(ProfileFa *profile);
 
 /**
@@ -35,75 +44,10 @@ ProfileFa *destroy_Profile(ProfileFa *profile);
 
 // ************************ Implementations **************************
 
-ProfileFa *init_ProfileFa(const char *filePath) {
-  FILE *fp = fopen(filePath, "r");
-  if (fp == NULL) {
-    fprintf(stderr, "Error: empty file pointer. \n");
-    exit(EXIT_FAILURE);
-  }
-
-  ProfileFa *profile = (ProfileFa *)calloc(1, sizeof(ProfileFa));
-  ProfileFa *tmp_profile = profile;  // the last created profile
-  ProfileFa *new_profile = NULL;
-
-  uint32_t pos_bp = 1;  // 1-based position within chromosome
-
-  char buf_info[MAX_INFO_LENGTH];  // buffer for info line of the file
-  int idx_buf_info = 0;            // index for buf_info
-
-  bool isBpLine = false;
-
-  char tmpCh;
-  while ((tmpCh = fgetc(fp)) != EOF) {
-    if (tmpCh == '>') {
-      if (pos_bp != 1) {
-        new_profile->length = pos_bp - 1;
-        new_profile->absolute_offset =
-            tmp_profile->absolute_offset + tmp_profile->length;
-        tmp_profile->next = new_profile;
-        tmp_profile = new_profile;
-      }
-      isBpLine = false;
-      idx_buf_info = 0;
-      pos_bp = 1;
-      buf_info[idx_buf_info++] = tmpCh;
-      continue;
-    }
-    // Extract the profile
-    if (isBpLine == false) {  // Extract info line
-      if (tmpCh == '\n') {    // Reach the end of info line
-        buf_info[idx_buf_info] = '\0';
-        new_profile = (ProfileFa *)calloc(1, sizeof(ProfileFa));
-        new_profile->info = strdup(buf_info);
-        isBpLine = true;
-      } else {  // Buffer character received from info line
-        buf_info[idx_buf_info++] = tmpCh;
-      }
-    } else {  // Extract bases
-      if (tmpCh == '\n') {
-        continue;
-      } else {
-        pos_bp++;
-      }
-    }
-  }
-  if (pos_bp != 1) {
-    new_profile->length = pos_bp - 1;
-    new_profile->absolute_offset =
-        tmp_profile->absolute_offset + tmp_profile->length;
-    tmp_profile->next = new_profile;
-    tmp_profile = new_profile;
-  }
-
-  fclose(fp);
-
-  return destroy_Profile(profile);
-}
-
 void print_ProfileFa(ProfileFa *profile) {
   ProfileFa *tmp_profile = profile;
   while (tmp_profile != NULL) {
-    printf("info: %s, length: %" PRIu32 "\n", tmp_profile->info,
+    printf("info: %s, length: %" PRId64 "\n", tmp_profile->info,
            tmp_profile->length);
     tmp_profile = tmp_profile->next;
   }
@@ -119,8 +63,8 @@ ProfileFa *destroy_Profile(ProfileFa *profile) {
 /**
  * @brief  (helper function) Code the bpBuf array (a string with A,C,G,T) into a
  * uint64_t integer. Should not be called by the user. The calculation's
- * purpose: "ACGT" -> (0b) 001 010 011 100 000 000 ...... 000 0. Note that bases
- * start from the left and there may be some "0"s left out not filled. The bpBuf
+ * purpose: "ACGT" -> (0b) 00 01 10 11 00 00 ...... 00. Note that bases start
+ * from the left and there may be some "0"s left out not filled. The bpBuf
  * string must contain no more than BP_PER_UINT64 chars (bases).
  */
 static uint64_t codeBpBuf(char *bpBuf) {
@@ -129,12 +73,12 @@ static uint64_t codeBpBuf(char *bpBuf) {
   while (i != BP_PER_UINT64 && *bpBuf != '\0') {
     /*
      * The following calculation's purpose:
-     * "ACGT" -> (0b) 001 010 011 100 000 000 ...... 000 0
+     * "ACGT" -> (0b) 00 01 10 11 00 00 ...... 00
      * The bpBuf string must contain no more than BP_PER_UINT64 chars (bases).
      */
-    codedBp =
-        codedBp | (((uint64_t)baseOfChar(*bpBuf))
-                   << (sizeof(uint64_t) * 8) - BASE_CODE_LENGTH * (i + 1));
+    uint64_t code = (baseOfChar(*bpBuf) - BASE_A) & BASE_MASK_RIGHT;
+    codedBp = codedBp |
+              (code << (sizeof(uint64_t) * 8) - BASE_CODE_LENGTH * (i + 1));
     bpBuf++;
     i++;
   }
@@ -145,21 +89,70 @@ static uint64_t codeBpBuf(char *bpBuf) {
  *                     Structure Declarations
  ********************************************************************/
 
+/*
+ * A run of bases other than A, C, G and T (N, IUPAC codes ...). These bases
+ * are packed as A in codedBases. N bases of a reference genome usually come in
+ * long runs, so the list is short.
+ */
+typedef struct _define_RunFa {
+  uint64_t start;   // 0-based position of the first base of the run
+  uint32_t length;  // number of bases in the run (longer runs are split)
+  Base base;        // BASE_N or BASE_INVALID
+} RunFa;
+
 // This is actually a linked-list with an empty header
 struct ChromFa {
-  uint64_t *codedBases;      // binary coded bases using uint64_t array
-  uint32_t length;           // length of chrom / number of bases (uncoded)
-  uint32_t absolute_offset;  // offset for absolute position of this chromosome
+  uint64_t *codedBases;      // 2-bit coded bases using uint64_t array
+  RunFa *runs;               // runs of other bases, sorted by start
+  uint32_t cnt_run;          // number of runs
+  int64_t length;            // length of chrom / number of bases (uncoded)
+  int64_t absolute_offset;   // offset for absolute position of this chromosome
   char *info;                // info of chrom
   char *name;
+  bool ifMapped;  // codedBases and runs point into the mapped index file
+  // Only used by genomes loaded on demand (see genomeFa_loadFileLazy), where
+  // codedBases is NULL until the chrom is decoded
+  uint64_t offset_seq;  // offset of the first base in the *.fa file
+  uint32_t lineBases;   // number of bases in each line
+  uint32_t lineWidth;   // number of bytes in each line, including '\n'
+  int cnt_user;         // number of users. Chroms in use are never evicted
+  uint64_t tick_used;   // last time the chrom is acquired
   struct ChromFa *next;
 };
 
+/*
+ * State of a genome whose chroms are decoded on demand.
+ */
+typedef struct _define_LazyFa {
+  char *filePath;
+  int fd;                  // the *.fa file, or -1 if it is bgzip compressed
+  BGZF *fp_bgzf;           // the bgzip compressed *.fa file, or NULL
+  uint64_t size_cache;     // memory cap of decoded chroms (bytes); 0 for no cap
+  uint64_t size_decoded;   // memory used by decoded chroms (bytes)
+  uint64_t cnt_bpDecoded;  // number of bases decoded, including evicted ones
+  uint64_t tick;           // clock for LRU eviction
+  pthread_mutex_t mutex;
+} LazyFa;
+
 struct GenomeFa {
-  uint16_t chromCnt;
+  uint32_t chromCnt;
   ChromFa *chroms;
+  // Arrays for looking up chroms in O(1) time. Both have capacity_chroms slots
+  ChromFa **chromArray;     // chromArray[idx]: idx-th chrom (0 for the header)
+  ContigDict *contigs;      // names of the chroms
+  ChromFa **chroms_contig;  // chroms_contig[id]: chrom with id in contigs
+  uint32_t capacity_chroms;
+  void *mappedIndex;  // the mapped index file, or NULL if loaded from *.fa
+  size_t size_mappedIndex;
+  LazyFa *lazy;  // NULL if all chroms are decoded when loading
 };
 
+/**
+ * @brief  Decode the chrom if it is not decoded yet and mark it as in use.
+ * Nothing is done if the genome is not loaded on demand.
+ */
+static ChromFa *acquireChromFa(ChromFa *cf, GenomeFa *gf);
+
 /**
  * @brief Initialize a ChromFa object and return the pointer to it. The
  * successfully returned object must be destroyed later using destroy_ChromFa()
@@ -173,18 +166,18 @@ static ChromFa *init_ChromFa() {
   return cf;
 }
 
-static ChromFa *init_ChromFa_info_length(const char *info,
-                                         const uint32_t length) {
+/**
+ * @brief  Initialize a ChromFa object with its info line (">name other"),
+ * without any bases.
+ */
+static ChromFa *init_ChromFa_info(const char *info) {
   ChromFa *cf = (ChromFa *)calloc(1, sizeof(ChromFa));
   if (cf == NULL) {
     fprintf(stderr, "Error: no enough memory for a new chrom.\n");
     exit(EXIT_FAILURE);
   }
-  uint32_t length_info = strlen(info);
+  const int length_info = strlen(info);
   cf->info = strdup(info);
-  cf->length = length;
-  cf->codedBases =
-      (uint64_t *)calloc((length - 1) / BP_PER_UINT64 + 1, sizeof(uint64_t));
 
   // Find "name" of the chromosome (">name other")
   if (info[0] != '>') {
@@ -193,7 +186,7 @@ static ChromFa *init_ChromFa_info_length(const char *info,
   }
   char buf_name[MAX_INFO_LENGTH];
   memset(buf_name, 0, MAX_INFO_LENGTH);
-  for (int i = 0; i < length_info; i++) {
+  for (int i = 0; i < length_info && i < MAX_INFO_LENGTH - 1; i++) {
     char tmp_char = info[i + 1];
     if (tmp_char == ' ' || tmp_char == '\t') {
       break;
@@ -205,39 +198,14 @@ static ChromFa *init_ChromFa_info_length(const char *info,
   return cf;
 }
 
+/**
+ * @brief  Initialize a ChromFa object according to its profile. codedBases is
+ * left NULL for the caller.
+ */
 static ChromFa *init_ChromFa_profile(ProfileFa *profile) {
-  ChromFa *cf = (ChromFa *)calloc(1, sizeof(ChromFa));
-  if (cf == NULL) {
-    fprintf(stderr, "Error: no enough memory for a new chrom.\n");
-    exit(EXIT_FAILURE);
-  }
-  const char *info = profile->info;
-  const int length_info = strlen(info);
-  const uint32_t length = profile->length;
-  const uint32_t absolute_offset = profile->absolute_offset;
-
-  cf->info = strdup(info);
-  cf->length = length;
-  cf->absolute_offset = absolute_offset;
-  cf->codedBases =
-      (uint64_t *)calloc((length - 1) / BP_PER_UINT64 + 1, sizeof(uint64_t));
-
-  // Find "name" of the chromosome (">name other")
-  if (info[0] != '>') {
-    fprintf(stderr, "Error: info line of chromosome invalid - %s\n", info);
-    exit(EXIT_FAILURE);
-  }
-  char buf_name[MAX_INFO_LENGTH];
-  memset(buf_name, 0, MAX_INFO_LENGTH);
-  for (int i = 0; i < length_info; i++) {
-    char tmp_char = info[i + 1];
-    if (tmp_char == ' ' || tmp_char == '\t') {
-      break;
-    } else {
-      buf_name[i] = tmp_char;
-    }
-  }
-  cf->name = strdup(buf_name);
+  ChromFa *cf = init_ChromFa_info(profile->info);
+  cf->length = profile->length;
+  cf->absolute_offset = profile->absolute_offset;
   return cf;
 }
 
@@ -250,12 +218,38 @@ static void destroy_ChromFa(ChromFa *cf) {
             "Error: null pointer occurred when destroying a ChromFa object\n");
     exit(EXIT_FAILURE);
   }
-  free(cf->codedBases);
+  if (cf->ifMapped == false) {
+    free(cf->codedBases);
+    free(cf->runs);
+  }
   free(cf->info);
   free(cf->name);
   free(cf);
 }
 
+/**
+ * @brief Add a ChromFa object into the lookup arrays of the GenomeFa object.
+ * Chroms without names or with duplicated names can only be found by index.
+ */
+static void indexChromInGenome(ChromFa *cf, uint32_t idx, GenomeFa *gf) {
+  if (idx >= gf->capacity_chroms) {
+    gf->capacity_chroms *= 2;
+    gf->chromArray = (ChromFa **)realloc(
+        gf->chromArray, gf->capacity_chroms * sizeof(ChromFa *));
+    gf->chroms_contig = (ChromFa **)realloc(
+        gf->chroms_contig, gf->capacity_chroms * sizeof(ChromFa *));
+    if (gf->chromArray == NULL || gf->chroms_contig == NULL) {
+      fprintf(stderr, "Error: no enough memory for indexing chromosomes.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  gf->chromArray[idx] = cf;
+  if (cf->name == NULL) return;
+  int32_t cnt_contig = contigDict_cnt(gf->contigs);
+  int32_t id_contig = contigDict_add(gf->contigs, cf->name);
+  if (id_contig == cnt_contig) gf->chroms_contig[id_contig] = cf;
+}
+
 /**
  * @brief Add a ChromFa object into the GenomeFa object (linked to the end of
  * the linked-list with an empty header).
@@ -265,15 +259,9 @@ static void addChromToGenome(ChromFa *cf, GenomeFa *gf) {
     fprintf(stderr, "Error: null pointer occurred for ChromFa or GenomeFa\n");
     exit(EXIT_FAILURE);
   }
-  ChromFa *tmpCf = gf->chroms;
-  while (tmpCf != NULL) {
-    if (tmpCf->next == NULL) {
-      tmpCf->next = cf;
-      gf->chromCnt++;
-      return;
-    }
-    tmpCf = tmpCf->next;
-  }
+  gf->chromArray[gf->chromCnt]->next = cf;
+  gf->chromCnt++;
+  indexChromInGenome(cf, gf->chromCnt, gf);
 }
 
 GenomeFa *init_GenomeFa() {
@@ -283,12 +271,21 @@ GenomeFa *init_GenomeFa() {
     exit(EXIT_FAILURE);
   }
   gf->chromCnt = 0;
+  gf->mappedIndex = NULL;
+  gf->size_mappedIndex = 0;
+  gf->lazy = NULL;
   gf->chroms = init_ChromFa();
   gf->chroms->codedBases = (uint64_t *)calloc(1, sizeof(uint64_t));
   gf->chroms->info = (char *)calloc(strlen(">header chrom") + 1, sizeof(char));
   gf->chroms->name = (char *)calloc(strlen("header") + 1, sizeof(char));
   strcpy(gf->chroms->info, ">header chrom");
   strcpy(gf->chroms->name, "header");
+  gf->capacity_chroms = 16;
+  gf->chromArray = (ChromFa **)malloc(gf->capacity_chroms * sizeof(ChromFa *));
+  gf->chroms_contig =
+      (ChromFa **)malloc(gf->capacity_chroms * sizeof(ChromFa *));
+  gf->contigs = init_ContigDict();
+  indexChromInGenome(gf->chroms, 0, gf);
   return gf;
 }
 
@@ -304,6 +301,17 @@ void destroy_GenomeFa(GenomeFa *gf) {
     destroy_ChromFa(tmpCf);
     tmpCf = nxtCf;
   }
+  if (gf->mappedIndex != NULL) munmap(gf->mappedIndex, gf->size_mappedIndex);
+  if (gf->lazy != NULL) {
+    if (gf->lazy->fd >= 0) close(gf->lazy->fd);
+    if (gf->lazy->fp_bgzf != NULL) bgzf_close(gf->lazy->fp_bgzf);
+    pthread_mutex_destroy(&gf->lazy->mutex);
+    free(gf->lazy->filePath);
+    free(gf->lazy);
+  }
+  free(gf->chromArray);
+  free(gf->chroms_contig);
+  destroy_ContigDict(gf->contigs);
   free(gf);
 }
 
@@ -311,7 +319,7 @@ void destroy_GenomeFa(GenomeFa *gf) {
  *                           Data Accessor
  ********************************************************************/
 
-inline uint32_t chromFa_length(ChromFa *cf) { return cf->length; }
+inline int64_t chromFa_length(ChromFa *cf) { return cf->length; }
 
 inline const char *chromFa_name(ChromFa *cf) { return cf->name; }
 
@@ -325,7 +333,7 @@ ChromFa *getChromFromGenomeFabyInfo(const char *info, GenomeFa *gf) {
     char *tmpInfo = tmpCf->info;
     if (tmpInfo != NULL) {
       if (strcmp(tmpInfo, info) == 0) {
-        return tmpCf;
+        return acquireChromFa(tmpCf, gf);
       }
     }
     tmpCf = tmpCf->next;
@@ -339,17 +347,12 @@ ChromFa *getChromFromGenomeFabyName(const char *name, GenomeFa *gf) {
     fprintf(stderr, "Error: null pointer occurred for GenomeFa\n");
     assert(false);
   }
-  ChromFa *tmpCf = gf->chroms;
-  while (tmpCf != NULL) {
-    char *tmpName = tmpCf->name;
-    if (tmpName != NULL) {
-      if (strcmp(tmpName, name) == 0) {
-        return tmpCf;
-      }
-    }
-    tmpCf = tmpCf->next;
-  }
-  return NULL;
+  return getChromFromGenomeFabyContig(contigDict_id(gf->contigs, name), gf);
+}
+
+ChromFa *getChromFromGenomeFabyContig(int32_t id_contig, GenomeFa *gf) {
+  if (id_contig < 0 || id_contig >= contigDict_cnt(gf->contigs)) return NULL;
+  return acquireChromFa(gf->chroms_contig[id_contig], gf);
 }
 
 ChromFa *getChromFromGenomeFabyIndex(uint32_t idx, GenomeFa *gf) {
@@ -357,38 +360,60 @@ ChromFa *getChromFromGenomeFabyIndex(uint32_t idx, GenomeFa *gf) {
     fprintf(stderr, "Error: null pointer occurred for GenomeFa\n");
     assert(false);
   }
-  ChromFa *tmpCf = gf->chroms;
-  for (uint32_t i = 0; i < idx; i++) {
-    tmpCf = tmpCf->next;
-  }
+  if (idx > gf->chromCnt) return NULL;
+  return acquireChromFa(gf->chromArray[idx], gf);
+}
 
-  return tmpCf;
+const ContigDict *genomeFa_contigs(GenomeFa *gf) { return gf->contigs; }
+
+void genomeFa_releaseChrom(ChromFa *cf, GenomeFa *gf) {
+  if (cf == NULL || gf->lazy == NULL) return;
+  pthread_mutex_lock(&gf->lazy->mutex);
+  assert(cf->cnt_user > 0);
+  cf->cnt_user--;
+  pthread_mutex_unlock(&gf->lazy->mutex);
 }
 
-Base getBase(ChromFa *cf, uint32_t pos) {
-  // Spent some time for this. Bug occurred. Bug located. Bug fixed ...
-  uint32_t arrayLength = (cf->length - 1) / BP_PER_UINT64 + 1;
-  uint32_t arrayIdx = (pos - 1) / BP_PER_UINT64;
+uint64_t genomeFa_decodedBases(GenomeFa *gf) {
+  if (gf->lazy != NULL) return gf->lazy->cnt_bpDecoded;
+  ChromFa *cf_last = gf->chromArray[gf->chromCnt];
+  return (uint64_t)cf_last->absolute_offset + cf_last->length;
+}
 
-  if (arrayIdx >= arrayLength || pos <= 0) {
-    return BASE_INVALID;
-  } else {
-    // The following commented lines were used for debugging.
-    uint64_t arrayElement = cf->codedBases[arrayIdx];
-    // 1 % 21 = 1, 21 % 21 = 0. This is not good. So (21 - 1) % 21 + 1 = 21.
-    // (pos, baseIdx) examples: (1,1), (21,21), (22,1), (43,1)
-    uint8_t baseIdx = (pos - 1) % BP_PER_UINT64 + 1;
-    // (baseIdx, offset) examples, (21,1), (20,4), (1, 61)
-    uint8_t offset = 1 + BASE_CODE_LENGTH * (BP_PER_UINT64 - baseIdx);
+/**
+ * @brief  Find the first run that ends after the 0-based position.
+ * @retval index of the run; cf->cnt_run if there is no such run
+ */
+static inline uint32_t findRunFa(const ChromFa *cf, uint64_t pos) {
+  uint32_t lo = 0;
+  uint32_t hi = cf->cnt_run;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    const RunFa *run = &cf->runs[mid];
+    if (run->start + run->length <= pos) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
 
-    Base retVal = (Base)((arrayElement >> offset) & BASE_MASK_RIGHT);
-    return retVal;
-    // return (Base)(
-    //     (cf->codedBases[arrayIdx] >>
-    //          (1 + BASE_CODE_LENGTH *
-    //                   (BP_PER_UINT64 - ((pos - 1) % BP_PER_UINT64 + 1))) &
-    //      BASE_MASK_RIGHT));
+Base getBase(ChromFa *cf, int64_t pos) {
+  if (pos <= 0 || pos > cf->length) {
+    return BASE_INVALID;
+  }
+  if (cf->cnt_run != 0) {
+    uint32_t idx_run = findRunFa(cf, pos - 1);
+    if (idx_run < cf->cnt_run && cf->runs[idx_run].start <= pos - 1) {
+      return cf->runs[idx_run].base;
+    }
   }
+  uint64_t arrayElement = cf->codedBases[(pos - 1) / BP_PER_UINT64];
+  // (pos, offset) examples: (1,62), (32,0), (33,62)
+  uint8_t offset =
+      BASE_CODE_LENGTH * (BP_PER_UINT64 - 1 - (pos - 1) % BP_PER_UINT64);
+  return (Base)(BASE_A + ((arrayElement >> offset) & BASE_MASK_RIGHT));
 }
 
 char *getSeqFromChromFa(int64_t start, int64_t end, ChromFa *cf) {
@@ -398,104 +423,1334 @@ char *getSeqFromChromFa(int64_t start, int64_t end, ChromFa *cf) {
   }
   uint64_t seqLength = (end - start + 1);
   //  "+1" is in consideration of '\0' at the end of a string.
-  char *seq = (char *)calloc(seqLength + 1, sizeof(char));
+  char *seq = (char *)malloc((seqLength + 1) * sizeof(char));
+  getSeqIntoBuf(cf, start, end, seq, GENOMEFA_ENCODING_CHAR);
+  return seq;
+}
+
+/*
+ * Chars and codes for alignment (see nt_table in alignment.c) of each Base.
+ * BASE_NORECORD and BASE_INVALID are decoded as '*' (see charOfBase). A 2-bit
+ * coded base is decoded as (BASE_A + code).
+ */
+static const uint8_t charOfCode[8] = {'*', 'A', 'C', 'G', 'T', 'N', '*', '*'};
+static const uint8_t nt4OfCode[8] = {4, 0, 1, 2, 3, 4, 4, 4};
 
-  for (int i = 0; i < seqLength; i++) {
-    seq[i] = charOfBase(getBase(cf, start + i));
+int64_t getSeqIntoBuf(ChromFa *cf, int64_t start, int64_t end, void *dst,
+                      int encoding) {
+  if (cf == NULL || end < start) {
+    return 0;
+  }
+  const uint8_t *decode =
+      encoding == GENOMEFA_ENCODING_NT4 ? nt4OfCode : charOfCode;
+  uint8_t *seq = (uint8_t *)dst;
+  int64_t pos = start;
+  // Positions out of the chromosome
+  for (; pos <= end && pos < 1; pos++) seq[pos - start] = decode[BASE_INVALID];
+  const int64_t end_chrom = end < cf->length ? end : cf->length;
+  const int64_t start_chrom = pos;
+  const uint8_t *decode_2bit = decode + BASE_A;
+  // Decode a whole word each time
+  while (pos <= end_chrom) {
+    int64_t idx_word = (pos - 1) / BP_PER_UINT64;
+    int idx_inWord = (pos - 1) % BP_PER_UINT64;
+    int cnt_inWord = BP_PER_UINT64 - idx_inWord;
+    if (cnt_inWord > end_chrom - pos + 1) cnt_inWord = end_chrom - pos + 1;
+    uint64_t codedBp = cf->codedBases[idx_word]
+                       << (BASE_CODE_LENGTH * idx_inWord);
+    uint8_t *seq_word = seq + (pos - start);
+    for (int i = 0; i < cnt_inWord; i++) {
+      seq_word[i] = decode_2bit[codedBp >> (64 - BASE_CODE_LENGTH)];
+      codedBp <<= BASE_CODE_LENGTH;
+    }
+    pos += cnt_inWord;
   }
-  seq[seqLength] = '\0';
+  // Overwrite bases in runs of other bases
+  if (cf->cnt_run != 0 && start_chrom <= end_chrom) {
+    for (uint32_t i = findRunFa(cf, start_chrom - 1); i < cf->cnt_run; i++) {
+      const RunFa *run = &cf->runs[i];
+      int64_t lbound = (int64_t)run->start + 1;  // 1-based, included
+      int64_t rbound = lbound + run->length - 1;
+      if (lbound > end_chrom) break;
+      if (lbound < start_chrom) lbound = start_chrom;
+      if (rbound > end_chrom) rbound = end_chrom;
+      memset(seq + (lbound - start), decode[run->base], rbound - lbound + 1);
+    }
+  }
+  for (; pos <= end; pos++) seq[pos - start] = decode[BASE_INVALID];
+  if (encoding == GENOMEFA_ENCODING_CHAR) seq[end - start + 1] = '\0';
+  return end - start + 1;
+}
 
-  return seq;
+struct WindowFa {
+  ChromFa *cf;             // chromosome of the window; NULL if not set
+  int encoding;            // GENOMEFA_ENCODING_CHAR or GENOMEFA_ENCODING_NT4
+  int64_t size;            // number of bases the window can keep
+  int64_t start;           // 1-based position of bases[0]
+  int64_t end;             // 1-based position of the last decoded base
+  char *bases;             // size + 1 bytes ('\0' written by getSeqIntoBuf)
+  uint64_t cnt_bpDecoded;  // number of bases decoded
+};
+
+WindowFa *init_WindowFa(int64_t size, int encoding) {
+  WindowFa *wf = (WindowFa *)calloc(1, sizeof(WindowFa));
+  if (wf == NULL) {
+    fprintf(stderr, "Error: no enough memory for a window of bases.\n");
+    exit(EXIT_FAILURE);
+  }
+  wf->encoding = encoding;
+  wf->size = size > 0 ? size : 1;
+  wf->bases = (char *)malloc(wf->size + 1);
+  if (wf->bases == NULL) {
+    fprintf(stderr, "Error: no enough memory for a window of bases.\n");
+    exit(EXIT_FAILURE);
+  }
+  wf->end = wf->start - 1;  // empty
+  return wf;
+}
+
+void destroy_WindowFa(WindowFa *wf) {
+  if (wf == NULL) return;
+  free(wf->bases);
+  free(wf);
+}
+
+void windowFa_setChrom(ChromFa *cf, WindowFa *wf) {
+  if (cf == wf->cf) return;
+  wf->cf = cf;
+  wf->end = wf->start - 1;
+}
+
+const char *windowFa_seq(int64_t start, int64_t end, WindowFa *wf) {
+  if (wf->cf == NULL) return NULL;
+  if (end < start) return wf->bases;
+  if (start >= wf->start && end <= wf->end) {
+    return wf->bases + (start - wf->start);
+  }
+  // Keep a quarter of the window before the sequence, which is requested
+  // again by sequences of later reads starting a little earlier
+  int64_t start_new = start - wf->size / 4;
+  if (start_new < 1) start_new = start < 1 ? start : 1;
+  int64_t end_new = start_new + wf->size - 1;
+  if (end_new > wf->cf->length) end_new = wf->cf->length;
+  if (end_new < end) end_new = end;
+  if (end_new - start_new + 1 > wf->size) {
+    wf->size = end_new - start_new + 1;
+    wf->bases = (char *)realloc(wf->bases, wf->size + 1);
+    if (wf->bases == NULL) {
+      fprintf(stderr, "Error: no enough memory for a window of bases.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  // Reuse decoded bases if the window slides forward
+  int64_t cnt_kept = 0;
+  if (start_new >= wf->start && start_new <= wf->end) {
+    cnt_kept = wf->end - start_new + 1;
+    if (cnt_kept > end_new - start_new + 1) cnt_kept = end_new - start_new + 1;
+    memmove(wf->bases, wf->bases + (start_new - wf->start), cnt_kept);
+  }
+  wf->cnt_bpDecoded += getSeqIntoBuf(wf->cf, start_new + cnt_kept, end_new,
+                                     wf->bases + cnt_kept, wf->encoding);
+  wf->start = start_new;
+  wf->end = end_new;
+  return wf->bases + (start - wf->start);
 }
 
-int32_t genomeFa_absolutePos(uint32_t id_chrom, int32_t pos, GenomeFa *gf) {
+uint64_t windowFa_decodedBases(WindowFa *wf) { return wf->cnt_bpDecoded; }
+
+int64_t genomeFa_absolutePos(uint32_t id_chrom, int64_t pos, GenomeFa *gf) {
   if (gf == NULL) {
     fprintf(stderr, "Error: null pointer occurred for GenomeFa\n");
     assert(false);
   }
-  ChromFa *tmpCf = gf->chroms;
-  for (uint32_t i = 0; i < id_chrom; i++) {
-    tmpCf = tmpCf->next;
-  }
-  return pos + tmpCf->absolute_offset;
+  return pos + gf->chromArray[id_chrom]->absolute_offset;
 }
 
 /*********************************************************************
  *                      Data Loading and Writing
  ********************************************************************/
 
-GenomeFa *genomeFa_loadFile(char *filePath) {
+/*
+ * Layout of the index file (native byte order):
+ *  IndexHeaderFa
+ *  IndexChromFa[chromCnt]
+ *  info strings ('\0' terminated)
+ *  codedBases of all chromosomes (each array aligned to 8 bytes)
+ *  runs of all chromosomes (each array aligned to 8 bytes)
+ */
+typedef struct _define_IndexHeaderFa {
+  char magic[8];
+  uint32_t version;
+  uint32_t chromCnt;
+  uint64_t size_file;  // used to detect truncated files
+} IndexHeaderFa;
+
+typedef struct _define_IndexChromFa {
+  uint64_t offset_codedBases;  // offset from the beginning of the file
+  uint64_t offset_runs;
+  uint64_t offset_info;
+  int64_t length;
+  int64_t absolute_offset;
+  uint32_t cnt_run;
+  uint32_t padding;
+} IndexChromFa;
+
+static const char indexMagic[8] = {'G', 'R', 'B', 'V', 'G', 'F', 'I', '\0'};
+
+/**
+ * @brief  Check whether the file begins with the magic of an index file. Only
+ * regular files are checked, so that nothing is consumed from pipes.
+ */
+static bool ifIndexFileFa(const char *filePath) {
+  struct stat stat_file;
+  if (stat(filePath, &stat_file) != 0 || S_ISREG(stat_file.st_mode) == false) {
+    return false;
+  }
+  FILE *fp = fopen(filePath, "rb");
+  if (fp == NULL) return false;
+  char magic[sizeof(indexMagic)];
+  bool ifIndex = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+                 memcmp(magic, indexMagic, sizeof(indexMagic)) == 0;
+  fclose(fp);
+  return ifIndex;
+}
+
+/**
+ * @brief  Check whether "*.fa" + GENOMEFA_INDEX_SUFFIX exists and is not older
+ * than the *.fa file.
+ */
+static bool ifFreshIndexFa(const char *filePath, const char *indexPath) {
+  struct stat stat_fa, stat_index;
+  if (stat(filePath, &stat_fa) != 0 || stat(indexPath, &stat_index) != 0) {
+    return false;
+  }
+  return stat_index.st_mtime >= stat_fa.st_mtime && ifIndexFileFa(indexPath);
+}
+
+static inline uint64_t alignTo8(uint64_t offset) {
+  return (offset + 7) & ~(uint64_t)7;
+}
+
+static inline uint64_t cnt_codedBases(int64_t length) {
+  return length == 0 ? 0 : (length - 1) / BP_PER_UINT64 + 1;
+}
+
+GenomeFa *genomeFa_loadIndexFile(const char *filePath) {
+  int fd = open(filePath, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Error: failed to open file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+  struct stat stat_index;
+  if (fstat(fd, &stat_index) != 0 ||
+      stat_index.st_size < (off_t)sizeof(IndexHeaderFa)) {
+    fprintf(stderr, "Error: invalid index file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+  size_t size_file = stat_index.st_size;
+  void *mapped = mmap(NULL, size_file, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    fprintf(stderr, "Error: failed to map file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+
+  const char *base = (const char *)mapped;
+  const IndexHeaderFa *header = (const IndexHeaderFa *)base;
+  if (memcmp(header->magic, indexMagic, sizeof(indexMagic)) != 0 ||
+      header->version != GENOMEFA_INDEX_VERSION ||
+      header->size_file != size_file) {
+    fprintf(stderr,
+            "Error: index file %s is invalid, truncated or of another version. "
+            "Please rebuild it with buildRefIndex.\n",
+            filePath);
+    exit(EXIT_FAILURE);
+  }
+
   GenomeFa *gf = init_GenomeFa();
-  // Initialie profiles of all chromosomes
+  gf->mappedIndex = mapped;
+  gf->size_mappedIndex = size_file;
+  const IndexChromFa *table =
+      (const IndexChromFa *)(base + sizeof(IndexHeaderFa));
+  for (uint32_t i = 0; i < header->chromCnt; i++) {
+    ProfileFa profile;
+    profile.info = (char *)(base + table[i].offset_info);
+    profile.length = table[i].length;
+    profile.absolute_offset = table[i].absolute_offset;
+    profile.next = NULL;
+    ChromFa *cf = init_ChromFa_profile(&profile);
+    // Use the bases in the page cache instead of a private copy
+    cf->codedBases = (uint64_t *)(base + table[i].offset_codedBases);
+    cf->runs = (RunFa *)(base + table[i].offset_runs);
+    cf->cnt_run = table[i].cnt_run;
+    cf->ifMapped = true;
+    addChromToGenome(cf, gf);
+  }
+  return gf;
+}
 
-  // Add chromosomes according to profiles of them and destroy profiles
-  ProfileFa *tmp_profile = init_ProfileFa(filePath);
-  while (tmp_profile != NULL) {
-    ChromFa *tmp_cf = init_ChromFa_profile(tmp_profile);
-    addChromToGenome(tmp_cf, gf);
-    // printf("absolute offsets: %" PRIu32 "\n", tmp_profile->absolute_offset);
-    tmp_profile = destroy_Profile(tmp_profile);
+void genomeFa_writeIndexFile(GenomeFa *gf, const char *filePath) {
+  // Processes that mapped the old index file keep using it until they exit.
+  // Writing into it directly would break them, so write a new file and then
+  // replace the old one.
+  char tmpPath[strlen(filePath) + 8];
+  sprintf(tmpPath, "%s.tmp", filePath);
+  FILE *fp = fopen(tmpPath, "wb");
+  if (fp == NULL) {
+    fprintf(stderr, "Error: failed to open file - %s\n", tmpPath);
+    exit(EXIT_FAILURE);
+  }
+  IndexHeaderFa header;
+  memset(&header, 0, sizeof(IndexHeaderFa));
+  memcpy(header.magic, indexMagic, sizeof(indexMagic));
+  header.version = GENOMEFA_INDEX_VERSION;
+  header.chromCnt = gf->chromCnt;
+
+  // Runs of chroms are known only after they are decoded
+  ChromFa *tmpCf = NULL;
+  for (tmpCf = gf->chroms->next; tmpCf != NULL; tmpCf = tmpCf->next) {
+    acquireChromFa(tmpCf, gf);
+  }
+
+  // Calculate offsets of info strings and coded bases
+  IndexChromFa *table =
+      (IndexChromFa *)calloc(gf->chromCnt + 1, sizeof(IndexChromFa));
+  uint64_t offset = sizeof(IndexHeaderFa) + gf->chromCnt * sizeof(IndexChromFa);
+  tmpCf = gf->chroms->next;
+  for (uint32_t i = 0; tmpCf != NULL; i++, tmpCf = tmpCf->next) {
+    table[i].offset_info = offset;
+    table[i].length = tmpCf->length;
+    table[i].absolute_offset = tmpCf->absolute_offset;
+    offset += strlen(tmpCf->info) + 1;
+  }
+  tmpCf = gf->chroms->next;
+  for (uint32_t i = 0; tmpCf != NULL; i++, tmpCf = tmpCf->next) {
+    offset = alignTo8(offset);
+    table[i].offset_codedBases = offset;
+    offset += cnt_codedBases(tmpCf->length) * sizeof(uint64_t);
+  }
+  tmpCf = gf->chroms->next;
+  for (uint32_t i = 0; tmpCf != NULL; i++, tmpCf = tmpCf->next) {
+    offset = alignTo8(offset);
+    table[i].offset_runs = offset;
+    table[i].cnt_run = tmpCf->cnt_run;
+    offset += tmpCf->cnt_run * sizeof(RunFa);
+  }
+  header.size_file = offset;
+
+  // Write the file
+  static const char padding[8] = {0};
+  fwrite(&header, sizeof(IndexHeaderFa), 1, fp);
+  fwrite(table, sizeof(IndexChromFa), gf->chromCnt, fp);
+  for (tmpCf = gf->chroms->next; tmpCf != NULL; tmpCf = tmpCf->next) {
+    fwrite(tmpCf->info, 1, strlen(tmpCf->info) + 1, fp);
+  }
+  tmpCf = gf->chroms->next;
+  for (uint32_t i = 0; tmpCf != NULL; i++, tmpCf = tmpCf->next) {
+    fwrite(padding, 1, table[i].offset_codedBases - ftell(fp), fp);
+    fwrite(tmpCf->codedBases, sizeof(uint64_t), cnt_codedBases(tmpCf->length),
+           fp);
+  }
+  tmpCf = gf->chroms->next;
+  for (uint32_t i = 0; tmpCf != NULL; i++, tmpCf = tmpCf->next) {
+    fwrite(padding, 1, table[i].offset_runs - ftell(fp), fp);
+    fwrite(tmpCf->runs, sizeof(RunFa), tmpCf->cnt_run, fp);
+  }
+  if (ftell(fp) != (long)header.size_file) {
+    fprintf(stderr, "Error: failed writing index file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+  free(table);
+  for (tmpCf = gf->chroms->next; tmpCf != NULL; tmpCf = tmpCf->next) {
+    genomeFa_releaseChrom(tmpCf, gf);
+  }
+  if (fclose(fp) != 0 || rename(tmpPath, filePath) != 0) {
+    fprintf(stderr, "Error: failed writing index file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*
+ * Maximal number of threads coding chromosomes when loading a *.fa file.
+ */
+#define LOADER_MAX_THREADS 16
+
+/*
+ * Code of each char (see baseOfChar), used for chars not coded by SSE.
+ */
+static uint8_t codeOfChar[256];
+static pthread_once_t once_codeOfChar = PTHREAD_ONCE_INIT;
+
+static void init_codeOfChar() {
+  for (int i = 0; i < 256; i++) codeOfChar[i] = baseOfChar((char)i);
+}
+
+/**
+ * @brief  Code chars into bases (same as baseOfChar), 16 chars at a time if
+ * SSE2 or SSSE3 is enabled when compiling.
+ */
+static void codeChars(const char *chars, uint64_t cnt, uint8_t *codes) {
+  uint64_t i = 0;
+#if defined(__SSSE3__)
+  // 'A', 'C', 'G', 'T', 'N' have different low 4 bits (1, 3, 7, 4, 14), which
+  // are used to look up the code and the only 2 chars having that code.
+  const __m128i mask_low = _mm_set1_epi8(0x0F);
+  const __m128i code_low = _mm_setr_epi8(
+      BASE_INVALID, BASE_A, BASE_INVALID, BASE_C, BASE_T, BASE_INVALID,
+      BASE_INVALID, BASE_G, BASE_INVALID, BASE_INVALID, BASE_INVALID,
+      BASE_INVALID, BASE_INVALID, BASE_INVALID, BASE_N, BASE_INVALID);
+  const __m128i upper_low =
+      _mm_setr_epi8(0, 'A', 0, 'C', 'T', 0, 0, 'G', 0, 0, 0, 0, 0, 0, 'N', 0);
+  // 'n' is not recognized by baseOfChar
+  const __m128i lower_low =
+      _mm_setr_epi8(0, 'a', 0, 'c', 't', 0, 0, 'g', 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i invalid = _mm_set1_epi8(BASE_INVALID);
+  for (; i + 16 <= cnt; i += 16) {
+    __m128i ch = _mm_loadu_si128((const __m128i *)(chars + i));
+    __m128i low = _mm_and_si128(ch, mask_low);
+    __m128i ifBase =
+        _mm_or_si128(_mm_cmpeq_epi8(ch, _mm_shuffle_epi8(upper_low, low)),
+                     _mm_cmpeq_epi8(ch, _mm_shuffle_epi8(lower_low, low)));
+    __m128i code = _mm_or_si128(
+        _mm_and_si128(ifBase, _mm_shuffle_epi8(code_low, low)),
+        _mm_andnot_si128(ifBase, invalid));
+    _mm_storeu_si128((__m128i *)(codes + i), code);
+  }
+#elif defined(__SSE2__)
+  // Compare with each char of bases and keep the code of the matched one
+  const char chars_base[] = {'A', 'a', 'C', 'c', 'G', 'g', 'T', 't', 'N'};
+  const uint8_t codes_base[] = {BASE_A, BASE_A, BASE_C, BASE_C, BASE_G,
+                                BASE_G, BASE_T, BASE_T, BASE_N};
+  const int cnt_base = sizeof(chars_base) / sizeof(char);
+  __m128i vec_chars[cnt_base], vec_codes[cnt_base];
+  for (int j = 0; j < cnt_base; j++) {
+    vec_chars[j] = _mm_set1_epi8(chars_base[j]);
+    vec_codes[j] = _mm_set1_epi8(codes_base[j]);
+  }
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i invalid = _mm_set1_epi8(BASE_INVALID);
+  for (; i + 16 <= cnt; i += 16) {
+    __m128i ch = _mm_loadu_si128((const __m128i *)(chars + i));
+    __m128i code = zero;
+    for (int j = 0; j < cnt_base; j++) {
+      code = _mm_or_si128(
+          code, _mm_and_si128(_mm_cmpeq_epi8(ch, vec_chars[j]), vec_codes[j]));
+    }
+    __m128i ifInvalid = _mm_cmpeq_epi8(code, zero);
+    code = _mm_or_si128(code, _mm_and_si128(ifInvalid, invalid));
+    _mm_storeu_si128((__m128i *)(codes + i), code);
+  }
+#endif
+  for (; i < cnt; i++) codes[i] = codeOfChar[(uint8_t)chars[i]];
+}
+
+/**
+ * @brief  Add a base other than A, C, G and T at the 0-based position into the
+ * runs of the chromosome, either extending the last run or starting a new one.
+ */
+static inline void addBaseToRunFa(ChromFa *cf, uint32_t *capacity_run,
+                                  uint64_t pos, Base bp) {
+  if (cf->cnt_run != 0) {
+    RunFa *last = &cf->runs[cf->cnt_run - 1];
+    if (last->base == bp && last->start + last->length == pos &&
+        last->length != UINT32_MAX) {
+      last->length++;
+      return;
+    }
+  }
+  if (cf->cnt_run == *capacity_run) {
+    *capacity_run = *capacity_run == 0 ? 16 : *capacity_run * 2;
+    cf->runs = (RunFa *)realloc(cf->runs, *capacity_run * sizeof(RunFa));
+    if (cf->runs == NULL) {
+      fprintf(stderr, "Error: no enough memory for runs of %s\n", cf->name);
+      exit(EXIT_FAILURE);
+    }
   }
+  RunFa *run = &cf->runs[cf->cnt_run++];
+  run->start = pos;
+  run->length = 1;
+  run->base = bp;
+}
 
-  char buf_bases[BP_PER_UINT64 + 1];
-  int idx_buf_bases = 0;
+/*
+ * State of coding bases of a chromosome into its codedBases and runs. The
+ * length of the chromosome need not be known before coding: codedBases grows
+ * geometrically, and is trimmed to the length when the chromosome ends.
+ */
+typedef struct _define_EncoderFa {
+  ChromFa *cf;             // the chromosome being coded
+  uint64_t codedBp;        // coded bases not written into codedBases yet
+  int cnt_codedBp;         // number of bases in codedBp
+  uint64_t cnt_word;       // number of words written into codedBases
+  uint64_t capacity_word;  // number of words allocated for codedBases
+  uint32_t capacity_run;   // number of runs allocated
+} EncoderFa;
 
-  bool isBpLine = false;
-  uint32_t pos_bp = 1;  // 1-based position of bases within chrom
+/**
+ * @brief  Grow codedBases of the chromosome being coded to keep at least
+ * cnt_word words.
+ */
+static void growEncoderFa(uint64_t cnt_word, EncoderFa *enc) {
+  uint64_t capacity_word = enc->capacity_word * 2;
+  if (capacity_word < cnt_word) capacity_word = cnt_word;
+  uint64_t *codedBases = (uint64_t *)realloc(
+      enc->cf->codedBases, capacity_word * sizeof(uint64_t));
+  if (codedBases == NULL) {
+    fprintf(stderr, "Error: no enough memory for bases of %s\n",
+            enc->cf->name);
+    exit(EXIT_FAILURE);
+  }
+  enc->cf->codedBases = codedBases;
+  enc->capacity_word = capacity_word;
+}
 
-  ChromFa *current_cf = gf->chroms;  // Temporary under processing chrom
+/**
+ * @brief  Start coding bases of a chromosome.
+ * @param  capacity_word: number of words allocated for codedBases at first.
+ * Allocating enough words avoids growing codedBases later.
+ */
+static void start_EncoderFa(ChromFa *cf, uint64_t capacity_word,
+                            EncoderFa *enc) {
+  memset(enc, 0, sizeof(EncoderFa));
+  enc->cf = cf;
+  growEncoderFa(capacity_word > 0 ? capacity_word : 1, enc);
+}
 
-  FILE *fp = fopen(filePath, "r");
+/**
+ * @brief  Code bases following those already coded.
+ * @param  *bases: chars of bases, without line breaks
+ */
+static void encodeBasesFa(const char *bases, uint64_t cnt, EncoderFa *enc) {
+  uint8_t codes[4096];
+  ChromFa *cf = enc->cf;
+  uint64_t codedBp = enc->codedBp;
+  int cnt_codedBp = enc->cnt_codedBp;
+  uint64_t pos = enc->cnt_word * BP_PER_UINT64 + cnt_codedBp;
+  while (cnt > 0) {
+    const uint64_t cnt_code = cnt < sizeof(codes) ? cnt : sizeof(codes);
+    codeChars(bases, cnt_code, codes);
+    const uint64_t cnt_word =
+        enc->cnt_word + (cnt_codedBp + cnt_code) / BP_PER_UINT64;
+    if (cnt_word > enc->capacity_word) growEncoderFa(cnt_word, enc);
+    uint64_t *codedBases = cf->codedBases + enc->cnt_word;
+    for (uint64_t i = 0; i < cnt_code; i++, pos++) {
+      uint8_t code = codes[i] - BASE_A;  // 0, 1, 2, 3 for A, C, G, T
+      if (code > BASE_MASK_RIGHT) {
+        addBaseToRunFa(cf, &enc->capacity_run, pos, codes[i]);
+        code = 0;
+      }
+      codedBp = (codedBp << BASE_CODE_LENGTH) | code;
+      if (++cnt_codedBp == BP_PER_UINT64) {
+        // "ACGT..." -> (0b) 00 01 10 11 ...... (see codeBpBuf)
+        *codedBases++ = codedBp;
+        codedBp = 0;
+        cnt_codedBp = 0;
+      }
+    }
+    enc->cnt_word = cnt_word;
+    bases += cnt_code;
+    cnt -= cnt_code;
+  }
+  enc->codedBp = codedBp;
+  enc->cnt_codedBp = cnt_codedBp;
+}
+
+/**
+ * @brief  Finish coding the chromosome and trim its codedBases and runs.
+ * @retval number of bases coded
+ */
+static int64_t finish_EncoderFa(EncoderFa *enc) {
+  ChromFa *cf = enc->cf;
+  const int64_t cnt_bp = enc->cnt_word * BP_PER_UINT64 + enc->cnt_codedBp;
+  if (enc->cnt_codedBp != 0) {
+    if (enc->cnt_word == enc->capacity_word) {
+      growEncoderFa(enc->cnt_word + 1, enc);
+    }
+    cf->codedBases[enc->cnt_word++] =
+        enc->codedBp
+        << (sizeof(uint64_t) * 8 - BASE_CODE_LENGTH * enc->cnt_codedBp);
+  }
+  // Large blocks are shrunk in place (realloc of glibc remaps them)
+  if (enc->cnt_word != 0 && enc->cnt_word != enc->capacity_word) {
+    cf->codedBases = (uint64_t *)realloc(cf->codedBases,
+                                         enc->cnt_word * sizeof(uint64_t));
+  }
+  if (cf->cnt_run != 0 && cf->cnt_run != enc->capacity_run) {
+    cf->runs = (RunFa *)realloc(cf->runs, cf->cnt_run * sizeof(RunFa));
+  }
+  enc->cf = NULL;
+  return cnt_bp;
+}
+
+/*
+ * Number of bytes read from a *.fa file at a time when it is read as a
+ * stream.
+ */
+#define SIZE_BLOCK_STREAMFA (1 << 20)
+
+/*
+ * Default number of words allocated for codedBases of a new chromosome when
+ * the *.fa file is read as a stream.
+ */
+#define CAPACITY_WORD_STREAMFA (1 << 12)
+
+/*
+ * State of coding a *.fa file read block by block in a single pass. Lines can
+ * be split between blocks.
+ */
+typedef struct _define_StreamFa {
+  EncoderFa enc;           // enc.cf is NULL if not within a chromosome
+  bool ifLineStart;        // the next byte begins a line
+  bool ifInfo;             // within an info line
+  char *info;              // the info line read so far
+  uint64_t length_info;
+  uint64_t capacity_info;
+  uint64_t capacity_word;  // see start_EncoderFa
+  ChromFa *first;          // coded chromosomes in the order of the file,
+  ChromFa *last;           // linked by "next"
+} StreamFa;
+
+/**
+ * @brief  Initialize the state of coding a *.fa file as a stream.
+ * @param  capacity_word: number of words allocated for codedBases of each
+ * chromosome at first; 0 for CAPACITY_WORD_STREAMFA
+ */
+static void init_StreamFa(uint64_t capacity_word, StreamFa *sf) {
+  memset(sf, 0, sizeof(StreamFa));
+  sf->ifLineStart = true;
+  sf->capacity_word =
+      capacity_word > 0 ? capacity_word : CAPACITY_WORD_STREAMFA;
+}
+
+static void appendInfoStreamFa(const char *chars, uint64_t cnt, StreamFa *sf) {
+  if (sf->length_info + cnt + 1 > sf->capacity_info) {
+    sf->capacity_info = (sf->length_info + cnt + 1) * 2;
+    sf->info = (char *)realloc(sf->info, sf->capacity_info);
+    if (sf->info == NULL) {
+      fprintf(stderr, "Error: no enough memory for info of a chrom.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  memcpy(sf->info + sf->length_info, chars, cnt);
+  sf->length_info += cnt;
+  sf->info[sf->length_info] = '\0';
+}
+
+/**
+ * @brief  Finish the chromosome being coded, if any. Chromosomes without any
+ * bases are ignored.
+ */
+static void closeChromStreamFa(StreamFa *sf) {
+  ChromFa *cf = sf->enc.cf;
+  if (cf == NULL) return;
+  cf->length = finish_EncoderFa(&sf->enc);
+  if (cf->length == 0) {
+    destroy_ChromFa(cf);
+    return;
+  }
+  if (sf->last == NULL) {
+    sf->first = cf;
+  } else {
+    sf->last->next = cf;
+  }
+  sf->last = cf;
+}
+
+/**
+ * @brief  Code the next block of the *.fa file. Lines before the first info
+ * line are ignored.
+ */
+static void feedStreamFa(const char *block, uint64_t size, StreamFa *sf) {
+  const char *end_block = block + size;
+  while (block < end_block) {
+    if (sf->ifLineStart && *block == '>') {
+      closeChromStreamFa(sf);
+      sf->ifInfo = true;
+      sf->length_info = 0;
+    }
+    const char *end_line =
+        (const char *)memchr(block, '\n', end_block - block);
+    const char *end_part = end_line == NULL ? end_block : end_line;
+    if (sf->ifInfo) {
+      appendInfoStreamFa(block, end_part - block, sf);
+    } else if (sf->enc.cf != NULL) {
+      encodeBasesFa(block, end_part - block, &sf->enc);
+    }
+    if (end_line == NULL) {
+      sf->ifLineStart = false;
+      break;
+    }
+    if (sf->ifInfo) {
+      start_EncoderFa(init_ChromFa_info(sf->info), sf->capacity_word,
+                      &sf->enc);
+      sf->ifInfo = false;
+    }
+    sf->ifLineStart = true;
+    block = end_line + 1;
+  }
+}
+
+/**
+ * @brief  Finish coding the *.fa file. Coded chromosomes are left in the list
+ * from sf->first.
+ */
+static void close_StreamFa(StreamFa *sf) {
+  if (sf->ifInfo) {  // the file ends with an info line
+    start_EncoderFa(init_ChromFa_info(sf->info), 1, &sf->enc);
+    sf->ifInfo = false;
+  }
+  closeChromStreamFa(sf);
+  free(sf->info);
+  sf->info = NULL;
+}
+
+/**
+ * @brief  Move the chromosomes coded from the stream into the GenomeFa object,
+ * following the chromosomes already in it.
+ */
+static void addStreamToGenome(StreamFa *sf, GenomeFa *gf) {
+  ChromFa *cf = sf->first;
+  while (cf != NULL) {
+    ChromFa *next = cf->next;
+    const ChromFa *last = gf->chromArray[gf->chromCnt];
+    cf->absolute_offset = last->absolute_offset + last->length;
+    cf->next = NULL;
+    addChromToGenome(cf, gf);
+    cf = next;
+  }
+  sf->first = sf->last = NULL;
+}
+
+/**
+ * @brief  Find the first info line at or after the offset.
+ * @retval offset of the info line; size_buf if not found
+ */
+static uint64_t findInfoLineFa(const char *buf, uint64_t offset,
+                               uint64_t size_buf) {
+  while (offset < size_buf) {
+    const char *found =
+        (const char *)memchr(buf + offset, '>', size_buf - offset);
+    if (found == NULL) return size_buf;
+    offset = found - buf;
+    if (offset == 0 || found[-1] == '\n') return offset;
+    offset++;
+  }
+  return size_buf;
+}
+
+/*
+ * A chromosome found in the mapped *.fa file, waiting to be coded.
+ */
+typedef struct _define_TaskFa {
+  uint64_t start;  // [start, end) of the file, from the info line to the
+  uint64_t end;    // next info line
+  ChromFa *cf;     // the coded chromosome, or NULL if it has no bases
+  struct _define_TaskFa *next;
+} TaskFa;
+
+/*
+ * Chromosomes found in the mapped *.fa file. The file is scanned for info
+ * lines by one thread, while chromosomes found are coded by other threads
+ * right after, so each page of the file is read from disk only once.
+ */
+typedef struct _define_LoaderFa {
+  const char *buf;  // content of the *.fa file
+  TaskFa *first;    // chromosomes in the order of the file
+  TaskFa *last;
+  TaskFa *task;     // next chromosome to be coded; NULL if not found yet
+  bool ifScanned;   // all chromosomes are found
+  pthread_mutex_t mutex;
+  pthread_cond_t cond_found;
+} LoaderFa;
+
+static void *encodeChromFa_threads(void *args) {
+  LoaderFa *loader = (LoaderFa *)args;
+  while (true) {
+    pthread_mutex_lock(&loader->mutex);
+    while (loader->task == NULL && loader->ifScanned == false) {
+      pthread_cond_wait(&loader->cond_found, &loader->mutex);
+    }
+    TaskFa *task = loader->task;
+    if (task != NULL) loader->task = task->next;
+    pthread_mutex_unlock(&loader->mutex);
+    if (task == NULL) break;
+    // A chromosome never has more bases than the bytes it takes in the file
+    const uint64_t size = task->end - task->start;
+    StreamFa sf;
+    init_StreamFa(cnt_codedBases(size), &sf);
+    feedStreamFa(loader->buf + task->start, size, &sf);
+    close_StreamFa(&sf);
+    task->cf = sf.first;
+  }
+  return NULL;
+}
+
+static void scanChromFa_loader(uint64_t size_buf, LoaderFa *loader) {
+  uint64_t start = findInfoLineFa(loader->buf, 0, size_buf);
+  while (start < size_buf) {
+    TaskFa *task = (TaskFa *)calloc(1, sizeof(TaskFa));
+    if (task == NULL) {
+      fprintf(stderr, "Error: no enough memory for loading chromosomes.\n");
+      exit(EXIT_FAILURE);
+    }
+    task->start = start;
+    task->end = findInfoLineFa(loader->buf, start + 1, size_buf);
+    pthread_mutex_lock(&loader->mutex);
+    if (loader->last == NULL) {
+      loader->first = task;
+    } else {
+      loader->last->next = task;
+    }
+    loader->last = task;
+    if (loader->task == NULL) loader->task = task;
+    pthread_cond_signal(&loader->cond_found);
+    pthread_mutex_unlock(&loader->mutex);
+    start = task->end;
+  }
+  pthread_mutex_lock(&loader->mutex);
+  loader->ifScanned = true;
+  pthread_cond_broadcast(&loader->cond_found);
+  pthread_mutex_unlock(&loader->mutex);
+}
+
+/*
+ * Suffix of the index of a bgzip compressed *.fa file, which gives the
+ * compressed offsets of its blocks.
+ */
+#define GZI_SUFFIX ".gzi"
+
+/**
+ * @brief  Check whether the file begins with the magic of gzip (and thus
+ * bgzip) files.
+ */
+static bool ifCompressedFa(int fd) {
+  unsigned char magic[2];
+  return pread(fd, magic, sizeof(magic), 0) == sizeof(magic) &&
+         magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+/**
+ * @brief  Get number of threads for decompressing bgzip compressed files.
+ */
+static int cnt_threadDecompression() {
+  long cnt_thread = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cnt_thread > LOADER_MAX_THREADS) cnt_thread = LOADER_MAX_THREADS;
+  return cnt_thread < 1 ? 1 : (int)cnt_thread;
+}
+
+/**
+ * @brief  Map the whole file into memory, if it is a regular file and is not
+ * compressed.
+ * @param  *ret_size: size of the file
+ * @retval the mapped file (release it with munmap); NULL if it cannot be
+ * mapped
+ */
+static char *mapFileFa(const char *filePath, uint64_t *ret_size) {
+  int fd = open(filePath, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat stat_file;
+  void *mapped = MAP_FAILED;
+  if (fstat(fd, &stat_file) == 0 && S_ISREG(stat_file.st_mode) &&
+      stat_file.st_size > 0 && ifCompressedFa(fd) == false) {
+    mapped = mmap(NULL, stat_file.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (mapped == MAP_FAILED) return NULL;
+  madvise(mapped, stat_file.st_size, MADV_SEQUENTIAL);
+  *ret_size = stat_file.st_size;
+  return (char *)mapped;
+}
+
+/**
+ * @brief  Open the file through BGZF, where bgzip compressed blocks are
+ * decompressed by multiple threads. "-" is stdin.
+ */
+static BGZF *openFileFa_bgzf(const char *filePath) {
+  BGZF *fp = bgzf_open(filePath, "r");
   if (fp == NULL) {
     fprintf(stderr, "Error: failed to open file - %s\n", filePath);
     exit(EXIT_FAILURE);
   }
+  if (bgzf_compression(fp) == bgzf) {
+    bgzf_mt(fp, cnt_threadDecompression(), 256);
+  }
+  return fp;
+}
+
+/**
+ * @brief  Map the whole file into memory. If the file is compressed (bgzip or
+ * gzip), or cannot be mapped (pipes for example), read it through BGZF
+ * instead.
+ * @param  ifBuildGzi: build the index for random access (filePath +
+ * GZI_SUFFIX) while reading, if the file is bgzip compressed
+ * @param  *ret_size: size of the (decompressed) content
+ * @param  *ret_ifMapped: true if mapped (release it with munmap); false if
+ * read (release it with free)
+ */
+static char *loadFileContent(const char *filePath, bool ifBuildGzi,
+                             uint64_t *ret_size, bool *ret_ifMapped) {
+  char *mapped = mapFileFa(filePath, ret_size);
+  if (mapped != NULL) {
+    *ret_ifMapped = true;
+    return mapped;
+  }
+  BGZF *fp = openFileFa_bgzf(filePath);
+  const bool ifBgzf = bgzf_compression(fp) == bgzf;
+  if (ifBgzf && ifBuildGzi) bgzf_index_build_init(fp);
+  uint64_t size = 0;
+  uint64_t capacity = 1 << 20;
+  char *buf = (char *)malloc(capacity);
+  ssize_t cnt_read = 0;
+  while (buf != NULL &&
+         (cnt_read = bgzf_read(fp, buf + size, capacity - size)) > 0) {
+    size += cnt_read;
+    if (size == capacity) {
+      capacity *= 2;
+      buf = (char *)realloc(buf, capacity);
+    }
+  }
+  if (buf == NULL || cnt_read < 0) {
+    fprintf(stderr, "Error: failed to read file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+  if (ifBgzf && ifBuildGzi &&
+      bgzf_index_dump(fp, filePath, GZI_SUFFIX) != 0) {
+    fprintf(stderr, "Warning: failed to write index file - %s%s\n", filePath,
+            GZI_SUFFIX);
+  }
+  bgzf_close(fp);
+  *ret_size = size;
+  *ret_ifMapped = false;
+  return buf;
+}
+
+/**
+ * @brief  Code the chromosomes of the mapped *.fa file in parallel.
+ */
+static void loadMappedFa(const char *buf, uint64_t size_buf, int cnt_thread,
+                         GenomeFa *gf) {
+  if (cnt_thread <= 1) {
+    // Code the file in a single pass without looking for chromosomes first
+    StreamFa sf;
+    init_StreamFa(0, &sf);
+    feedStreamFa(buf, size_buf, &sf);
+    close_StreamFa(&sf);
+    addStreamToGenome(&sf, gf);
+    return;
+  }
+  LoaderFa loader;
+  memset(&loader, 0, sizeof(LoaderFa));
+  loader.buf = buf;
+  pthread_mutex_init(&loader.mutex, NULL);
+  pthread_cond_init(&loader.cond_found, NULL);
+  pthread_t threads[cnt_thread];
+  for (int i = 1; i < cnt_thread; i++) {
+    if (pthread_create(&threads[i], NULL, encodeChromFa_threads, &loader) !=
+        0) {
+      fprintf(stderr, "Error: failed to create thread to load chromosomes\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  scanChromFa_loader(size_buf, &loader);
+  encodeChromFa_threads(&loader);
+  for (int i = 1; i < cnt_thread; i++) pthread_join(threads[i], NULL);
+  pthread_cond_destroy(&loader.cond_found);
+  pthread_mutex_destroy(&loader.mutex);
+
+  while (loader.first != NULL) {
+    TaskFa *task = loader.first;
+    loader.first = task->next;
+    if (task->cf != NULL) {
+      StreamFa sf = {.first = task->cf};
+      addStreamToGenome(&sf, gf);
+    }
+    free(task);
+  }
+}
+
+/**
+ * @brief  Read the *.fa file through BGZF block by block and code it in a
+ * single pass. Used for files that cannot be mapped: compressed files, pipes
+ * and stdin.
+ */
+static void loadStreamFa(const char *filePath, GenomeFa *gf) {
+  BGZF *fp = openFileFa_bgzf(filePath);
+  char *block = (char *)malloc(SIZE_BLOCK_STREAMFA);
+  if (block == NULL) {
+    fprintf(stderr, "Error: no enough memory for reading %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+  StreamFa sf;
+  init_StreamFa(0, &sf);
+  ssize_t cnt_read = 0;
+  while ((cnt_read = bgzf_read(fp, block, SIZE_BLOCK_STREAMFA)) > 0) {
+    feedStreamFa(block, cnt_read, &sf);
+  }
+  if (cnt_read < 0) {
+    fprintf(stderr, "Error: failed to read file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+  close_StreamFa(&sf);
+  free(block);
+  bgzf_close(fp);
+  addStreamToGenome(&sf, gf);
+}
+
+GenomeFa *genomeFa_loadFile(char *filePath) {
+  // Use the index file instead of parsing the *.fa file if possible
+  if (ifIndexFileFa(filePath)) {
+    return genomeFa_loadIndexFile(filePath);
+  }
+  char indexPath[strlen(filePath) + strlen(GENOMEFA_INDEX_SUFFIX) + 1];
+  sprintf(indexPath, "%s%s", filePath, GENOMEFA_INDEX_SUFFIX);
+  if (ifFreshIndexFa(filePath, indexPath)) {
+    return genomeFa_loadIndexFile(indexPath);
+  }
+  pthread_once(&once_codeOfChar, init_codeOfChar);
 
-  char tmp_char;
-  while ((tmp_char = fgetc(fp)) != EOF) {
-    if (tmp_char == '>') {
-      if (idx_buf_bases != 0) {
-        buf_bases[idx_buf_bases] = '\0';
-        current_cf->codedBases[(pos_bp - 1) / BP_PER_UINT64] =
-            codeBpBuf(buf_bases);
-        idx_buf_bases = 0;
+  GenomeFa *gf = init_GenomeFa();
+  uint64_t size_buf = 0;
+  char *buf = mapFileFa(filePath, &size_buf);
+  if (buf != NULL) {
+    long cnt_thread = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cnt_thread > LOADER_MAX_THREADS) cnt_thread = LOADER_MAX_THREADS;
+    loadMappedFa(buf, size_buf, (int)cnt_thread, gf);
+    munmap(buf, size_buf);
+  } else {
+    loadStreamFa(filePath, gf);
+  }
+
+  // printGenomeFa(gf);
+  return gf;
+}
+
+/*
+ * Suffix of the samtools-compatible index of a *.fa file, which gives the
+ * position of each chromosome in the file.
+ */
+#define FAI_SUFFIX ".fai"
+
+static inline uint64_t sizeDecodedChromFa(const ChromFa *cf) {
+  return cnt_codedBases(cf->length) * sizeof(uint64_t) +
+         cf->cnt_run * sizeof(RunFa);
+}
+
+/**
+ * @brief  Scan a *.fa file and write its *.fai index into fp. Each line of
+ * the index is "name length offset lineBases lineWidth", separated by '\t'.
+ * @retval false if lines of a chromosome are of different lengths (except the
+ * last line), which cannot be described by the index
+ */
+static bool writeFaiFa(const char *buf, uint64_t size_buf, FILE *fp) {
+  const char *end_buf = buf + size_buf;
+  const char *line = buf;
+  bool ifChrom = false;  // whether there is a chromosome being scanned
+  char name[MAX_INFO_LENGTH];
+  uint64_t length = 0, offset = 0;
+  uint32_t lineBases = 0, lineWidth = 0;
+  bool ifEnded = false;  // whether the last (shorter) line has been scanned
+  while (true) {
+    const char *end_line =
+        line < end_buf ? (const char *)memchr(line, '\n', end_buf - line)
+                       : NULL;
+    if (end_line == NULL) end_line = end_buf;
+    if (line >= end_buf || *line == '>') {  // Close the last chromosome
+      if (ifChrom) {
+        fprintf(fp, "%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu32 "\t%" PRIu32 "\n",
+                name, length, offset, lineBases, lineWidth);
       }
-      isBpLine = false;
-      continue;
-    }
-    if (isBpLine == false) {
-      if (tmp_char == '\n') {  // reach the end of info line
-        current_cf = current_cf->next;
-        isBpLine = true;
-        pos_bp = 1;
-      } else {  // Ignore the info line characters
-        continue;
+      if (line >= end_buf) break;
+      int length_name = 0;
+      while (line + 1 + length_name < end_line &&
+             line[1 + length_name] != ' ' && line[1 + length_name] != '\t' &&
+             line[1 + length_name] != '\r' &&
+             length_name < MAX_INFO_LENGTH - 1) {
+        name[length_name] = line[1 + length_name];
+        length_name++;
       }
-    } else {  // Code bases into 64-bit integers and store them into chromsomes
-      if (tmp_char == '\n') {  // Ignore the line shifters
-        continue;
+      name[length_name] = '\0';
+      ifChrom = true;
+      length = 0;
+      offset = end_line + 1 - buf;
+      lineBases = lineWidth = 0;
+      ifEnded = false;
+    } else if (ifChrom) {  // Bases
+      uint32_t width = end_line - line;
+      uint32_t bases = width;
+      if (width > 0 && line[width - 1] == '\r') bases--;
+      if (bases == 0) {
+        ifEnded = true;
+      } else if (lineBases == 0) {  // The first line
+        lineBases = bases;
+        lineWidth = width + 1;
+        length += bases;
       } else {
-        buf_bases[idx_buf_bases++] = tmp_char;
-        if (idx_buf_bases == BP_PER_UINT64) {  // when the buf_bases is full
-          buf_bases[idx_buf_bases] = '\0';
-          current_cf->codedBases[(pos_bp - 1) / BP_PER_UINT64] =
-              codeBpBuf(buf_bases);
-          idx_buf_bases = 0;
+        // Only the last line can be shorter, and all lines must end with the
+        // same line break ("\n" or "\r\n")
+        if (ifEnded || bases > lineBases ||
+            width - bases != lineWidth - lineBases - 1) {
+          return false;
         }
-        pos_bp++;
+        if (bases < lineBases) ifEnded = true;
+        length += bases;
       }
     }
+    line = end_line + 1;
   }
-  // If the file doesn't have an empty line at the end, flush the buf_bases
-  if (idx_buf_bases != 0) {
-    buf_bases[idx_buf_bases] = '\0';
-    current_cf->codedBases[(pos_bp - 1) / BP_PER_UINT64] = codeBpBuf(buf_bases);
-    idx_buf_bases = 0;
+  return true;
+}
+
+/**
+ * @brief  Check whether the file exists and is not older than the *.fa file.
+ */
+static bool ifFreshFileFa(const struct stat *stat_fa, const char *filePath) {
+  struct stat stat_file;
+  if (stat(filePath, &stat_file) != 0) return false;
+  return stat_file.st_mtime >= stat_fa->st_mtime;
+}
+
+/**
+ * @brief  Open the *.fai index of a *.fa file, building it first if it does
+ * not exist or is outdated. If the index cannot be written beside the *.fa
+ * file, it is kept in a temporary file instead.
+ * @param  ifBgzf: whether the file is bgzip compressed, whose *.gzi index is
+ * built together with the *.fai index
+ * @retval the opened index; NULL if the *.fa file cannot be indexed
+ */
+static FILE *openFaiFa(const char *filePath, const struct stat *stat_fa,
+                       bool ifBgzf) {
+  char faiPath[strlen(filePath) + strlen(FAI_SUFFIX) + 1];
+  sprintf(faiPath, "%s%s", filePath, FAI_SUFFIX);
+  char gziPath[strlen(filePath) + strlen(GZI_SUFFIX) + 1];
+  sprintf(gziPath, "%s%s", filePath, GZI_SUFFIX);
+  if (ifFreshFileFa(stat_fa, faiPath) &&
+      (ifBgzf == false || ifFreshFileFa(stat_fa, gziPath))) {
+    return fopen(faiPath, "r");
   }
 
-  fclose(fp);
+  char tmpPath[strlen(faiPath) + 8];
+  sprintf(tmpPath, "%s.tmp", faiPath);
+  FILE *fp = fopen(tmpPath, "w+");
+  bool ifTmpFile = fp == NULL;
+  if (ifTmpFile) fp = tmpfile();
+  if (fp == NULL) {
+    fprintf(stderr, "Error: failed to create index file - %s\n", faiPath);
+    exit(EXIT_FAILURE);
+  }
+  uint64_t size_buf = 0;
+  bool ifMapped = false;
+  char *buf = loadFileContent(filePath, ifBgzf, &size_buf, &ifMapped);
+  bool ifIndexed = writeFaiFa(buf, size_buf, fp);
+  if (ifMapped) {
+    munmap(buf, size_buf);
+  } else {
+    free(buf);
+  }
+  if (ifIndexed == false || fflush(fp) != 0) {
+    fclose(fp);
+    if (ifTmpFile == false) remove(tmpPath);
+    return NULL;
+  }
+  // Other processes may be reading the old index
+  if (ifTmpFile == false && rename(tmpPath, faiPath) != 0) remove(tmpPath);
+  rewind(fp);
+  return fp;
+}
 
-  // printGenomeFa(gf);
+/**
+ * @brief  Free the bases of least recently used chroms until there is space
+ * for size_needed more bytes. Chroms in use are never evicted, so the memory
+ * used may still exceed the cap. Must be called with the mutex held.
+ */
+static void evictChromFa(uint64_t size_needed, GenomeFa *gf) {
+  LazyFa *lazy = gf->lazy;
+  if (lazy->size_cache == 0) return;
+  while (lazy->size_decoded + size_needed > lazy->size_cache) {
+    ChromFa *cf_lru = NULL;
+    for (uint32_t i = 1; i <= gf->chromCnt; i++) {
+      ChromFa *cf = gf->chromArray[i];
+      if (cf->codedBases == NULL || cf->cnt_user != 0) continue;
+      if (cf_lru == NULL || cf->tick_used < cf_lru->tick_used) cf_lru = cf;
+    }
+    if (cf_lru == NULL) break;
+    lazy->size_decoded -= sizeDecodedChromFa(cf_lru);
+    free(cf_lru->codedBases);
+    free(cf_lru->runs);
+    cf_lru->codedBases = NULL;
+    cf_lru->runs = NULL;
+    cf_lru->cnt_run = 0;
+  }
+}
+
+/**
+ * @brief  Read size bytes from the offset of the (decompressed) *.fa file.
+ * Must be called with the mutex held.
+ * @retval false if failed to read all bytes
+ */
+static bool readFileFa(uint64_t offset, uint64_t size, char *dst,
+                       LazyFa *lazy) {
+  if (lazy->fp_bgzf != NULL &&
+      bgzf_useek(lazy->fp_bgzf, offset, SEEK_SET) != 0) {
+    return false;
+  }
+  for (uint64_t size_read = 0; size_read < size;) {
+    ssize_t cnt_read =
+        lazy->fp_bgzf != NULL
+            ? bgzf_read(lazy->fp_bgzf, dst + size_read, size - size_read)
+            : pread(lazy->fd, dst + size_read, size - size_read,
+                    offset + size_read);
+    if (cnt_read <= 0) return false;
+    size_read += cnt_read;
+  }
+  return true;
+}
+
+/**
+ * @brief  Read the bases of a chrom from the *.fa file and decode them. Must
+ * be called with the mutex held.
+ */
+static void decodeChromFa_lazy(ChromFa *cf, GenomeFa *gf) {
+  LazyFa *lazy = gf->lazy;
+  evictChromFa(cnt_codedBases(cf->length) * sizeof(uint64_t), gf);
+  // From the first base to the last base, including line breaks
+  const uint64_t size_seq =
+      (uint64_t)((cf->length - 1) / cf->lineBases) * cf->lineWidth +
+      (cf->length - 1) % cf->lineBases + 1;
+  char *seq = (char *)malloc(size_seq);
+  if (seq == NULL) {
+    fprintf(stderr, "Error: no enough memory for bases of %s\n", cf->name);
+    exit(EXIT_FAILURE);
+  }
+  if (readFileFa(cf->offset_seq, size_seq, seq, lazy) == false) {
+    fprintf(stderr,
+            "Error: failed to read bases of %s from %s. Please remove the "
+            "outdated index %s%s\n",
+            cf->name, lazy->filePath, lazy->filePath, FAI_SUFFIX);
+    exit(EXIT_FAILURE);
+  }
+  // Remove line breaks
+  uint64_t cnt_bp = 0;
+  for (uint64_t offset = 0; offset < size_seq; offset += cf->lineWidth) {
+    uint64_t cnt = cf->length - cnt_bp;
+    if (cnt > cf->lineBases) cnt = cf->lineBases;
+    memmove(seq + cnt_bp, seq + offset, cnt);
+    cnt_bp += cnt;
+  }
+  EncoderFa enc;
+  start_EncoderFa(cf, cnt_codedBases(cf->length), &enc);
+  encodeBasesFa(seq, cf->length, &enc);
+  finish_EncoderFa(&enc);
+  free(seq);
+  lazy->size_decoded += sizeDecodedChromFa(cf);
+  lazy->cnt_bpDecoded += cf->length;
+}
+
+static ChromFa *acquireChromFa(ChromFa *cf, GenomeFa *gf) {
+  LazyFa *lazy = gf->lazy;
+  if (cf == NULL || lazy == NULL || cf->lineWidth == 0) return cf;
+  pthread_mutex_lock(&lazy->mutex);
+  cf->cnt_user++;
+  cf->tick_used = ++lazy->tick;
+  if (cf->codedBases == NULL) decodeChromFa_lazy(cf, gf);
+  pthread_mutex_unlock(&lazy->mutex);
+  return cf;
+}
+
+GenomeFa *genomeFa_loadFileLazy(char *filePath, uint64_t size_cache) {
+  if (ifIndexFileFa(filePath)) {
+    return genomeFa_loadIndexFile(filePath);
+  }
+  char indexPath[strlen(filePath) + strlen(GENOMEFA_INDEX_SUFFIX) + 1];
+  sprintf(indexPath, "%s%s", filePath, GENOMEFA_INDEX_SUFFIX);
+  if (ifFreshIndexFa(filePath, indexPath)) {
+    return genomeFa_loadIndexFile(indexPath);
+  }
+  // Pipes cannot be read on demand
+  struct stat stat_fa;
+  if (stat(filePath, &stat_fa) != 0 || S_ISREG(stat_fa.st_mode) == false) {
+    return genomeFa_loadFile(filePath);
+  }
+  int fd = open(filePath, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Error: failed to open file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+  // Compressed files are read on demand only if compressed by bgzip
+  BGZF *fp_bgzf = NULL;
+  if (ifCompressedFa(fd)) {
+    close(fd);
+    fd = -1;
+    fp_bgzf = bgzf_open(filePath, "r");
+    if (fp_bgzf == NULL || bgzf_compression(fp_bgzf) != bgzf) {
+      fprintf(stderr,
+              "Warning: %s is not compressed by bgzip. The whole file is "
+              "loaded instead of loading chromosomes on demand.\n",
+              filePath);
+      if (fp_bgzf != NULL) bgzf_close(fp_bgzf);
+      return genomeFa_loadFile(filePath);
+    }
+  }
+  FILE *fp_fai = openFaiFa(filePath, &stat_fa, fp_bgzf != NULL);
+  if (fp_fai == NULL) {
+    fprintf(stderr,
+            "Warning: lines of %s are of different lengths. The whole file "
+            "is loaded instead of loading chromosomes on demand.\n",
+            filePath);
+    if (fd >= 0) close(fd);
+    if (fp_bgzf != NULL) bgzf_close(fp_bgzf);
+    return genomeFa_loadFile(filePath);
+  }
+  if (fp_bgzf != NULL) {
+    if (bgzf_index_load(fp_bgzf, filePath, GZI_SUFFIX) != 0) {
+      fprintf(stderr, "Error: failed to load index file - %s%s\n", filePath,
+              GZI_SUFFIX);
+      exit(EXIT_FAILURE);
+    }
+    bgzf_mt(fp_bgzf, cnt_threadDecompression(), 256);
+  }
+  pthread_once(&once_codeOfChar, init_codeOfChar);
+
+  GenomeFa *gf = init_GenomeFa();
+  LazyFa *lazy = (LazyFa *)calloc(1, sizeof(LazyFa));
+  lazy->filePath = strdup(filePath);
+  lazy->fd = fd;
+  lazy->fp_bgzf = fp_bgzf;
+  lazy->size_cache = size_cache;
+  pthread_mutex_init(&lazy->mutex, NULL);
+  gf->lazy = lazy;
+
+  char line[MAX_INFO_LENGTH + 128];
+  char info[MAX_INFO_LENGTH + 1];
+  int64_t absolute_offset = 0;
+  while (fgets(line, sizeof(line), fp_fai) != NULL) {
+    char *name = strtok(line, "\t");
+    char *fields[4];
+    for (int i = 0; i < 4; i++) fields[i] = strtok(NULL, "\t\n");
+    if (name == NULL || fields[3] == NULL) {
+      fprintf(stderr, "Error: invalid line in %s%s\n", filePath, FAI_SUFFIX);
+      exit(EXIT_FAILURE);
+    }
+    int64_t length = strtoll(fields[0], NULL, 10);
+    if (length <= 0) continue;  // chromosomes without bases are ignored
+    // Info lines are not kept in the index
+    snprintf(info, sizeof(info), ">%s", name);
+    ProfileFa profile;
+    profile.info = info;
+    profile.length = length;
+    profile.absolute_offset = absolute_offset;
+    profile.next = NULL;
+    ChromFa *cf = init_ChromFa_profile(&profile);
+    cf->offset_seq = strtoull(fields[1], NULL, 10);
+    cf->lineBases = strtoul(fields[2], NULL, 10);
+    cf->lineWidth = strtoul(fields[3], NULL, 10);
+    if (cf->lineBases == 0 || cf->lineWidth <= cf->lineBases) {
+      fprintf(stderr, "Error: invalid line in %s%s\n", filePath, FAI_SUFFIX);
+      exit(EXIT_FAILURE);
+    }
+    addChromToGenome(cf, gf);
+    absolute_offset += length;
+  }
+  fclose(fp_fai);
   return gf;
 }
 
@@ -504,9 +1759,10 @@ void writeGenomeFaIntoFile(GenomeFa *gf, const char *filePath) {
   ChromFa *tmpCf = gf->chroms->next;
 
   while (tmpCf != NULL) {
+    acquireChromFa(tmpCf, gf);
     fprintf(fp, "%s\n", tmpCf->info);
-    uint32_t baseCnt = tmpCf->length;
-    int i = 1;
+    int64_t baseCnt = tmpCf->length;
+    int64_t i = 1;
     for (i = 1; i <= baseCnt; i++) {
       char tmpBp = charOfBase(getBase(tmpCf, i));
       fprintf(fp, "%c", tmpBp);
@@ -517,6 +1773,7 @@ void writeGenomeFaIntoFile(GenomeFa *gf, const char *filePath) {
     if (i % BP_PER_LINE != 0) {
       fprintf(fp, "\n");
     }
+    genomeFa_releaseChrom(tmpCf, gf);
     tmpCf = tmpCf->next;
   }
   fclose(fp);
@@ -593,11 +1850,10 @@ static void _test_StructureLinks() {
 }
 
 static void _test_CodingBases() {
-  char *bases[] = {"AAAACCCCGGGGTTTTAAAAC", "TACCCCAGCAAGACCAGACAT", "ACGT"};
-  uint64_t codedBases[] = {0x2494926DB9242494, 0x85248b44b2916518,
-                           0x29C0000000000000};
+  char *bases[] = {"AAAACCCCGGGGTTTTAAAACTACCCCAGCAA", "GACCAGACATACGT"};
+  uint64_t codedBases[] = {0x0055AAFF00715490, 0x852131B000000000};
   ChromFa *cf = init_ChromFa();
-  cf->codedBases = (uint64_t *)malloc(sizeof(uint64_t) * 3);
+  cf->codedBases = (uint64_t *)malloc(sizeof(uint64_t) * 2);
   cf->length = 46;
   cf->info = (char *)malloc(sizeof(char *) * strlen(">codingBasesTestCf"));
   strcpy(cf->info, ">codingBasesTestCf");
@@ -697,6 +1953,71 @@ static void _test_SeqExtractor() {
   destroy_GenomeFa(gf);
 }
 
+static void _test_SeqIntoBuf() {
+  GenomeFa *gf = genomeFa_loadFile("data/test.fa");
+  const int64_t testStart[] = {1, 20, 21, 22, -3, 400, 1};
+  const int64_t testEnd[] = {1, 22, 63, 85, 5, 420, 0};
+  const uint8_t nt4[] = {4, 0, 1, 2, 3, 4, 4, 4};  // same as nt4OfCode
+  for (ChromFa *cf = gf->chroms->next; cf != NULL; cf = cf->next) {
+    for (int i = 0; i < sizeof(testStart) / sizeof(int64_t); i++) {
+      int64_t start = testStart[i];
+      int64_t end = i == 5 ? cf->length + 3 : testEnd[i];  // crossing the end
+      char buf_char[end - start + 2 > 0 ? end - start + 2 : 1];
+      uint8_t buf_nt4[end - start + 1 > 0 ? end - start + 1 : 1];
+      int64_t length = end < start ? 0 : end - start + 1;
+      assert(getSeqIntoBuf(cf, start, end, buf_char, GENOMEFA_ENCODING_CHAR) ==
+             length);
+      assert(getSeqIntoBuf(cf, start, end, buf_nt4, GENOMEFA_ENCODING_NT4) ==
+             length);
+      for (int64_t j = 0; j < length; j++) {
+        Base bp = (start + j) >= 1 ? getBase(cf, start + j) : BASE_INVALID;
+        assert(buf_char[j] == charOfBase(bp));
+        assert(buf_nt4[j] == nt4[bp]);
+      }
+      if (length > 0) assert(buf_char[length] == '\0');
+    }
+  }
+  destroy_GenomeFa(gf);
+}
+
+static void _test_WindowFa() {
+  GenomeFa *gf = genomeFa_loadFile("data/test.fa");
+  const int encodings[] = {GENOMEFA_ENCODING_CHAR, GENOMEFA_ENCODING_NT4};
+  for (int e = 0; e < 2; e++) {
+    WindowFa *wf = init_WindowFa(16, encodings[e]);
+    assert(windowFa_seq(1, 10, wf) == NULL);
+    uint64_t cnt_bpRequested = 0;
+    for (uint32_t i = 1; i <= gf->chromCnt; i++) {
+      ChromFa *cf = getChromFromGenomeFabyIndex(i, gf);
+      windowFa_setChrom(cf, wf);
+      // Sorted reads: each one requests a sequence starting a little before
+      // and one after itself, and some go beyond the end of the chrom
+      for (int64_t pos = 1; pos <= cf->length + 8; pos += 3) {
+        const int64_t bounds[][2] = {
+            {pos - 5 < 1 ? 1 : pos - 5, pos + 4}, {pos + 5, pos + 12}};
+        for (int j = 0; j < 2; j++) {
+          const int64_t start = bounds[j][0], end = bounds[j][1];
+          char buf[end - start + 2];
+          getSeqIntoBuf(cf, start, end, buf, encodings[e]);
+          assert(memcmp(windowFa_seq(start, end, wf), buf,
+                        end - start + 1) == 0);
+          cnt_bpRequested += end - start + 1;
+        }
+      }
+      // Sequences longer than the window, and requests going backwards
+      int64_t end = cf->length < 100 ? cf->length : 100;
+      char buf[end + 1];
+      getSeqIntoBuf(cf, 1, end, buf, encodings[e]);
+      assert(memcmp(windowFa_seq(1, end, wf), buf, end) == 0);
+      assert(memcmp(windowFa_seq(2, 2, wf), buf + 1, 1) == 0);
+    }
+    // Bases are decoded far fewer times than they are requested
+    assert(windowFa_decodedBases(wf) * 2 < cnt_bpRequested);
+    destroy_WindowFa(wf);
+  }
+  destroy_GenomeFa(gf);
+}
+
 static void _test_Loader() {
   GenomeFa *gf = genomeFa_loadFile("data/example.fa");
 
@@ -718,23 +2039,19 @@ static void _test_Loader() {
     tmpCf = tmpCf->next;
   }
 
-  uint64_t codedCh1[] = {0x2492492492492492, 0x2492492492492492,
-                         0x2492492492492492, 0x2492492492492492,
-                         0x2492492492492492, 0x2492492492492492,
-                         0x2492492492492492, 0x2490000000000000};
-  uint64_t codedCh2[] = {0x4924924924924924, 0x4924924924924924,
-                         0x4924924924924924, 0x4924924924924924,
-                         0x4924924924924924, 0x4924924924924924,
-                         0x4924924924924924, 0x4924924924924924,
-                         0x4924924924924924, 0x4924924924800000};
-  uint64_t codedCh3[] = {0x6db6db6db6db6db6, 0x6db6db6db6db6db6,
-                         0x6db6db6db6db6db6, 0x6db6db6db6db6db6,
-                         0x6db6db6db6db6db6, 0x6db6db6db6db6db6,
-                         0x6db6db6db6db6db6, 0x6db6000000000000};
-  uint64_t codedCh4[] = {0x9249249249249248, 0x9249249249249248,
-                         0x9249249249249248, 0x9249249249249248,
-                         0x9249249249249248, 0x9249249249249248,
-                         0x9249249249240000};
+  uint64_t codedCh1[] = {0x0000000000000000, 0x0000000000000000,
+                         0x0000000000000000, 0x0000000000000000,
+                         0x0000000000000000};
+  uint64_t codedCh2[] = {0x5555555555555555, 0x5555555555555555,
+                         0x5555555555555555, 0x5555555555555555,
+                         0x5555555555555555, 0x5555555555555555,
+                         0x5555540000000000};
+  uint64_t codedCh3[] = {0xAAAAAAAAAAAAAAAA, 0xAAAAAAAAAAAAAAAA,
+                         0xAAAAAAAAAAAAAAAA, 0xAAAAAAAAAAAAAAAA,
+                         0xAAAAAAAAAAAAAAAA};
+  uint64_t codedCh4[] = {0xFFFFFFFFFFFFFFFF, 0xFFFFFFFFFFFFFFFF,
+                         0xFFFFFFFFFFFFFFFF, 0xFFFFFFFFFFFFFFFF,
+                         0xFFFFFFF000000000};
   uint64_t *codedChs[] = {codedCh1, codedCh2, codedCh3, codedCh4};
   tmpCf = gf->chroms->next;
   for (int i = 0; i < gf->chromCnt; i++) {
@@ -747,6 +2064,28 @@ static void _test_Loader() {
   destroy_GenomeFa(gf);
 }
 
+static void _test_ChromLookup() {
+  GenomeFa *gf = genomeFa_loadFile("data/example.fa");
+  const char *names[] = {"header", "chr1", "chr2", "chr13", "chr14"};
+  const ContigDict *contigs = genomeFa_contigs(gf);
+  assert(contigDict_cnt(contigs) == gf->chromCnt + 1);
+
+  // Lookups by index, by name and by id of contig must agree with the list
+  ChromFa *tmpCf = gf->chroms;
+  for (uint32_t i = 0; i <= gf->chromCnt; i++, tmpCf = tmpCf->next) {
+    assert(getChromFromGenomeFabyIndex(i, gf) == tmpCf);
+    assert(getChromFromGenomeFabyName(names[i], gf) == tmpCf);
+    assert(contigDict_id(contigs, names[i]) == i);
+    assert(getChromFromGenomeFabyContig(i, gf) == tmpCf);
+    assert(genomeFa_absolutePos(i, 1, gf) == tmpCf->absolute_offset + 1);
+  }
+  assert(tmpCf == NULL);
+  assert(getChromFromGenomeFabyIndex(gf->chromCnt + 1, gf) == NULL);
+  assert(getChromFromGenomeFabyName("chr3", gf) == NULL);
+  assert(getChromFromGenomeFabyContig(-1, gf) == NULL);
+  destroy_GenomeFa(gf);
+}
+
 static void _test_Writer() {
   GenomeFa *gf = genomeFa_loadFile("data/test.fa");
 
@@ -757,6 +2096,297 @@ static void _test_Writer() {
   destroy_GenomeFa(gf);
 }
 
+static void _test_LoaderCodes() {
+  // Mixed cases, 'n' (invalid for baseOfChar), IUPAC codes, lines of different
+  // lengths, a chromosome without bases and no '\n' at the end of file
+  const char *infos[] = {">chrA desc", ">chrB", ">chrEmpty", ">chrC"};
+  const char *lines[][4] = {
+      {"ACGTNacgtnRYKMacgtACGTACGTACGTAAAACCCCGGGGTTTTNNNN", "A", "",
+       "ttttggggccccaaaaTTTTGGGGCCCCAAAAtgca"},
+      {"GATTACA", "GATTACAGATTACAGATTACAGATTACAGATTACAGATTACA", NULL},
+      {NULL},
+      {"acgtACGT*-.acgtACGTNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNN", NULL}};
+  const int cnt_chrom = sizeof(infos) / sizeof(char *);
+  const char *filePath = "data/test_loader.tmp.fa";
+  FILE *fp = fopen(filePath, "w");
+  for (int i = 0; i < cnt_chrom; i++) {
+    fprintf(fp, "%s\n", infos[i]);
+    for (int j = 0; j < 4 && lines[i][j] != NULL; j++) {
+      fprintf(fp, (i == cnt_chrom - 1) ? "%s" : "%s\n", lines[i][j]);
+    }
+  }
+  fclose(fp);
+
+  GenomeFa *gf = genomeFa_loadFile((char *)filePath);
+  // The chromosome without bases is ignored
+  assert(gf->chromCnt == cnt_chrom - 1);
+  assert(getChromFromGenomeFabyName("chrEmpty", gf) == NULL);
+  for (int i = 0; i < cnt_chrom; i++) {
+    ChromFa *cf = getChromFromGenomeFabyInfo(infos[i], gf);
+    if (lines[i][0] == NULL) continue;
+    assert(cf != NULL);
+    uint32_t pos = 1;
+    for (int j = 0; j < 4 && lines[i][j] != NULL; j++) {
+      for (int k = 0; lines[i][j][k] != '\0'; k++) {
+        assert(getBase(cf, pos++) == baseOfChar(lines[i][j][k]));
+      }
+    }
+    assert(cf->length == pos - 1);
+  }
+  // Runs of other bases: "*-." and 40 'N's in chrC
+  ChromFa *cf_runs = getChromFromGenomeFabyName("chrC", gf);
+  assert(cf_runs->cnt_run == 2);
+  assert(cf_runs->runs[0].start == 8 && cf_runs->runs[0].length == 3);
+  assert(cf_runs->runs[1].base == BASE_N && cf_runs->runs[1].length == 40);
+
+  // Extracted sequences are the same after writing and loading the index
+  const char *indexPath = "data/test_loader.tmp.fa" GENOMEFA_INDEX_SUFFIX;
+  genomeFa_writeIndexFile(gf, indexPath);
+  GenomeFa *gf_mapped = genomeFa_loadIndexFile(indexPath);
+  for (uint32_t i = 1; i <= gf->chromCnt; i++) {
+    ChromFa *cf = getChromFromGenomeFabyIndex(i, gf);
+    ChromFa *cf_mapped = getChromFromGenomeFabyIndex(i, gf_mapped);
+    assert(cf_mapped->cnt_run == cf->cnt_run);
+    for (int64_t start = -1; start <= cf->length; start += 7) {
+      int64_t end = start + 40;
+      char seq[end - start + 2], seq_mapped[end - start + 2];
+      getSeqIntoBuf(cf, start, end, seq, GENOMEFA_ENCODING_CHAR);
+      getSeqIntoBuf(cf_mapped, start, end, seq_mapped, GENOMEFA_ENCODING_CHAR);
+      assert(strcmp(seq, seq_mapped) == 0);
+      for (int64_t j = 0; j <= end - start; j++) {
+        Base bp = start + j >= 1 ? getBase(cf, start + j) : BASE_INVALID;
+        assert(seq[j] == charOfBase(bp));
+      }
+    }
+  }
+  destroy_GenomeFa(gf_mapped);
+  destroy_GenomeFa(gf);
+  remove(indexPath);
+  remove(filePath);
+}
+
+static void _test_IndexFile() {
+  const char *indexPath = "data/test.fa.tmp" GENOMEFA_INDEX_SUFFIX;
+  GenomeFa *gf = genomeFa_loadFile("data/test.fa");
+  genomeFa_writeIndexFile(gf, indexPath);
+  // The index file is recognized by genomeFa_loadFile as well
+  GenomeFa *gf_mapped = genomeFa_loadFile((char *)indexPath);
+  assert(gf_mapped->mappedIndex != NULL);
+  assert(gf_mapped->chromCnt == gf->chromCnt);
+
+  ChromFa *tmpCf = gf->chroms->next;
+  ChromFa *tmpCf_mapped = gf_mapped->chroms->next;
+  while (tmpCf != NULL) {
+    assert(tmpCf_mapped != NULL);
+    assert(strcmp(tmpCf->info, tmpCf_mapped->info) == 0);
+    assert(strcmp(tmpCf->name, tmpCf_mapped->name) == 0);
+    assert(tmpCf->length == tmpCf_mapped->length);
+    assert(tmpCf->absolute_offset == tmpCf_mapped->absolute_offset);
+    char *seq = getSeqFromChromFa(1, tmpCf->length, tmpCf);
+    char *seq_mapped = getSeqFromChromFa(1, tmpCf->length, tmpCf_mapped);
+    assert(strcmp(seq, seq_mapped) == 0);
+    free(seq);
+    free(seq_mapped);
+    tmpCf = tmpCf->next;
+    tmpCf_mapped = tmpCf_mapped->next;
+  }
+  assert(tmpCf_mapped == NULL);
+
+  destroy_GenomeFa(gf_mapped);
+  destroy_GenomeFa(gf);
+  remove(indexPath);
+}
+
+static void _test_LazyLoader() {
+  // Lines of different widths, "\r\n" line breaks and a chromosome without
+  // bases
+  const char *filePath = "data/test_lazy.tmp.fa";
+  const char *faiPath = "data/test_lazy.tmp.fa" FAI_SUFFIX;
+  const char *names[] = {"chrA", "chrB", "chrEmpty", "chrC"};
+  const int lengths[] = {333, 95, 0, 40};
+  const int lineBases[] = {60, 10, 60, 80};
+  const char *lineBreaks[] = {"\n", "\r\n", "\n", "\n"};
+  const char chars[] = "ACGTACGTNNacgtRYacgt";
+  const int cnt_chrom = sizeof(names) / sizeof(char *);
+#define LAZY_TEST_CHAR(i, j) chars[((i)*7 + (j)*3) % (sizeof(chars) - 1)]
+  FILE *fp = fopen(filePath, "w");
+  for (int i = 0; i < cnt_chrom; i++) {
+    fprintf(fp, ">%s desc%s", names[i], lineBreaks[i]);
+    for (int j = 0; j < lengths[i]; j++) {
+      fputc(LAZY_TEST_CHAR(i, j), fp);
+      if ((j + 1) % lineBases[i] == 0 || j == lengths[i] - 1) {
+        fputs(lineBreaks[i], fp);
+      }
+    }
+  }
+  fclose(fp);
+  remove(faiPath);
+
+  // A cap so small that every unused chrom is evicted
+  GenomeFa *gf = genomeFa_loadFileLazy((char *)filePath, 1);
+  assert(gf->lazy != NULL);
+  assert(gf->chromCnt == cnt_chrom - 1);
+  assert(access(faiPath, F_OK) == 0);
+  assert(genomeFa_decodedBases(gf) == 0);
+  assert(getChromFromGenomeFabyName("chrEmpty", gf) == NULL);
+  ChromFa *cfs[cnt_chrom];
+  for (int i = 0; i < cnt_chrom; i++) {
+    if (lengths[i] == 0) continue;
+    cfs[i] = getChromFromGenomeFabyName(names[i], gf);
+    assert(cfs[i]->codedBases != NULL);
+    assert(cfs[i]->length == lengths[i]);
+    assert(strncmp(cfs[i]->info, ">", 1) == 0);
+    for (int j = 0; j < lengths[i]; j++) {
+      assert(getBase(cfs[i], j + 1) == baseOfChar(LAZY_TEST_CHAR(i, j)));
+    }
+    // chrA is evicted once released, while chrB is kept in use
+    if (i == 0) genomeFa_releaseChrom(cfs[i], gf);
+    if (i == 1) assert(cfs[0]->codedBases == NULL);
+  }
+  assert(cfs[1]->codedBases != NULL);
+  assert(genomeFa_decodedBases(gf) == 333 + 95 + 40);
+  assert(genomeFa_absolutePos(2, 1, gf) == 333 + 1);
+  genomeFa_releaseChrom(cfs[1], gf);
+  genomeFa_releaseChrom(cfs[3], gf);
+  // Decoded again when accessed after eviction
+  ChromFa *cf = getChromFromGenomeFabyIndex(1, gf);
+  assert(cf == cfs[0] && cf->codedBases != NULL);
+  assert(cfs[1]->codedBases == NULL && cfs[3]->codedBases == NULL);
+  assert(genomeFa_decodedBases(gf) == 333 * 2 + 95 + 40);
+  char seq[lengths[0] + 1];
+  getSeqIntoBuf(cf, 1, lengths[0], seq, GENOMEFA_ENCODING_CHAR);
+  for (int j = 0; j < lengths[0]; j++) {
+    assert(seq[j] == charOfBase(baseOfChar(LAZY_TEST_CHAR(0, j))));
+  }
+  genomeFa_releaseChrom(cf, gf);
+  destroy_GenomeFa(gf);
+
+  // The existing index is used, and all chroms are kept without a cap
+  gf = genomeFa_loadFileLazy((char *)filePath, 0);
+  for (uint32_t i = 1; i <= gf->chromCnt; i++) {
+    genomeFa_releaseChrom(getChromFromGenomeFabyIndex(i, gf), gf);
+  }
+  assert(genomeFa_decodedBases(gf) == 333 + 95 + 40);
+  for (uint32_t i = 1; i <= gf->chromCnt; i++) {
+    assert(gf->chromArray[i]->codedBases != NULL);
+    assert(gf->chromArray[i]->cnt_user == 0);
+  }
+  destroy_GenomeFa(gf);
+  remove(faiPath);
+
+  // Lines of different lengths cannot be indexed
+  fp = fopen(filePath, "w");
+  fprintf(fp, ">chrX\nACG\nACGTACGT\n");
+  fclose(fp);
+  gf = genomeFa_loadFileLazy((char *)filePath, 0);
+  assert(gf->lazy == NULL);
+  assert(access(faiPath, F_OK) != 0);
+  cf = getChromFromGenomeFabyName("chrX", gf);
+  assert(cf->length == 11 && getBase(cf, 4) == BASE_A);
+  destroy_GenomeFa(gf);
+  remove(filePath);
+#undef LAZY_TEST_CHAR
+}
+
+static void _test_CompressedLoader() {
+  // Compress data/test.fa with bgzip
+  const char *filePath = "data/test.tmp.fa.gz";
+  uint64_t size_buf = 0;
+  bool ifMapped = false;
+  char *buf = loadFileContent("data/test.fa", false, &size_buf, &ifMapped);
+  assert(ifMapped == true);
+  BGZF *fp = bgzf_open(filePath, "w");
+  assert(bgzf_write(fp, buf, size_buf) == size_buf);
+  bgzf_close(fp);
+  munmap(buf, size_buf);
+
+  GenomeFa *gf = genomeFa_loadFile("data/test.fa");
+  GenomeFa *gf_compressed = genomeFa_loadFile((char *)filePath);
+  GenomeFa *gf_lazy = genomeFa_loadFileLazy((char *)filePath, 0);
+  assert(gf_lazy->lazy != NULL && gf_lazy->lazy->fp_bgzf != NULL);
+  assert(gf_compressed->chromCnt == gf->chromCnt);
+  assert(gf_lazy->chromCnt == gf->chromCnt);
+  // Decode the chroms in reverse order to seek backwards
+  for (uint32_t i = gf->chromCnt; i >= 1; i--) {
+    ChromFa *cf = getChromFromGenomeFabyIndex(i, gf);
+    ChromFa *cf_compressed = getChromFromGenomeFabyIndex(i, gf_compressed);
+    ChromFa *cf_lazy = getChromFromGenomeFabyIndex(i, gf_lazy);
+    assert(strcmp(cf->info, cf_compressed->info) == 0);
+    assert(strcmp(cf->name, cf_lazy->name) == 0);
+    char *seq = getSeqFromChromFa(1, cf->length, cf);
+    char *seq_compressed = getSeqFromChromFa(1, cf->length, cf_compressed);
+    char *seq_lazy = getSeqFromChromFa(1, cf->length, cf_lazy);
+    assert(strcmp(seq, seq_compressed) == 0);
+    assert(strcmp(seq, seq_lazy) == 0);
+    free(seq);
+    free(seq_compressed);
+    free(seq_lazy);
+    genomeFa_releaseChrom(cf_lazy, gf_lazy);
+  }
+  destroy_GenomeFa(gf);
+  destroy_GenomeFa(gf_compressed);
+  destroy_GenomeFa(gf_lazy);
+  remove(filePath);
+  remove("data/test.tmp.fa.gz" FAI_SUFFIX);
+  remove("data/test.tmp.fa.gz" GZI_SUFFIX);
+}
+
+/**
+ * @brief  Check whether two genomes have the same chromosomes.
+ */
+static void _assertSameGenomeFa(GenomeFa *gf, GenomeFa *gf_other) {
+  assert(gf_other->chromCnt == gf->chromCnt);
+  for (uint32_t i = 1; i <= gf->chromCnt; i++) {
+    ChromFa *cf = getChromFromGenomeFabyIndex(i, gf);
+    ChromFa *cf_other = getChromFromGenomeFabyIndex(i, gf_other);
+    assert(strcmp(cf->info, cf_other->info) == 0);
+    assert(cf->length == cf_other->length);
+    assert(cf->absolute_offset == cf_other->absolute_offset);
+    char *seq = getSeqFromChromFa(1, cf->length, cf);
+    char *seq_other = getSeqFromChromFa(1, cf->length, cf_other);
+    assert(strcmp(seq, seq_other) == 0);
+    free(seq);
+    free(seq_other);
+  }
+}
+
+static void _test_StreamLoader() {
+  GenomeFa *gf = genomeFa_loadFile("data/test.fa");
+  uint64_t size_buf = 0;
+  char *buf = mapFileFa("data/test.fa", &size_buf);
+  assert(buf != NULL);
+  // Lines and info lines split between blocks of any size
+  const uint64_t sizes_block[] = {1, 7, 61, SIZE_BLOCK_STREAMFA};
+  for (int i = 0; i < sizeof(sizes_block) / sizeof(uint64_t); i++) {
+    GenomeFa *gf_stream = init_GenomeFa();
+    StreamFa sf;
+    init_StreamFa(1, &sf);  // grow codedBases from a single word
+    for (uint64_t offset = 0; offset < size_buf; offset += sizes_block[i]) {
+      uint64_t size = size_buf - offset;
+      if (size > sizes_block[i]) size = sizes_block[i];
+      feedStreamFa(buf + offset, size, &sf);
+    }
+    close_StreamFa(&sf);
+    addStreamToGenome(&sf, gf_stream);
+    _assertSameGenomeFa(gf, gf_stream);
+    destroy_GenomeFa(gf_stream);
+  }
+  // Chromosomes found by one thread and coded by the others
+  for (int cnt_thread = 1; cnt_thread <= 4; cnt_thread++) {
+    GenomeFa *gf_threads = init_GenomeFa();
+    loadMappedFa(buf, size_buf, cnt_thread, gf_threads);
+    _assertSameGenomeFa(gf, gf_threads);
+    destroy_GenomeFa(gf_threads);
+  }
+  // Files that cannot be mapped
+  GenomeFa *gf_stream = init_GenomeFa();
+  loadStreamFa("data/test.fa", gf_stream);
+  _assertSameGenomeFa(gf, gf_stream);
+  destroy_GenomeFa(gf_stream);
+  munmap(buf, size_buf);
+  destroy_GenomeFa(gf);
+}
+
 static void _test_Loader_refactored() {
   GenomeFa *gf = genomeFa_loadFile("data/example.fa");
 
@@ -770,8 +2400,16 @@ void _testSet_genomeFa() {
   _test_CodingBases();
   _test_CodingBases_Plus();
   _test_SeqExtractor();
+  _test_SeqIntoBuf();
+  _test_WindowFa();
   _test_Loader();
+  _test_ChromLookup();
   _test_Writer();
+  _test_LoaderCodes();
+  _test_IndexFile();
+  _test_LazyLoader();
+  _test_CompressedLoader();
+  _test_StreamLoader();
   _test_Loader_refactored();
 }
 
@@ -780,12 +2418,13 @@ void printGenomeFa(GenomeFa *gf) {
   // Ignore the empty header of the linked list
   ChromFa *tmpCf = gf->chroms->next;
   while (tmpCf != NULL) {
+    acquireChromFa(tmpCf, gf);
     printf("info: %s\n", tmpCf->info);
-    printf("length: %" PRIu32 "\n", tmpCf->length);
-    printf("absolute offset: %" PRIu32 "\n", tmpCf->absolute_offset);
+    printf("length: %" PRId64 "\n", tmpCf->length);
+    printf("absolute offset: %" PRId64 "\n", tmpCf->absolute_offset);
 
-    uint32_t baseCnt = tmpCf->length;
-    int i = 0;
+    int64_t baseCnt = tmpCf->length;
+    int64_t i = 0;
     for (i = 1; i <= baseCnt; i++) {
       char tmpBp = charOfBase((getBase(tmpCf, i)));
       fprintf(stdout, "%c", tmpBp);
@@ -796,15 +2435,16 @@ void printGenomeFa(GenomeFa *gf) {
     if (i % BP_PER_LINE != 0) {
       fprintf(stdout, "\n");
     }
+    genomeFa_releaseChrom(tmpCf, gf);
     tmpCf = tmpCf->next;
   }
 }
 
 void printChromFa(ChromFa *cf) {
   printf("info: %s\n", cf->info);
-  printf("length: %" PRIu32 "\n", cf->length);
+  printf("length: %" PRId64 "\n", cf->length);
 
-  uint32_t arrayLength = 0;
+  uint64_t arrayLength = 0;
   if (cf->length != 0) {
     arrayLength = (cf->length - 1) / BP_PER_UINT64 + 1;
   }
@@ -9,9 +9,26 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "contigDict.h"
 #include "debug.h"
 #include "genomeFaMacros.h"
 
+/*
+ * Suffix of the index file of a *.fa file (see genomeFa_writeIndexFile).
+ * Version of the index file must be increased when its layout changes.
+ */
+#define GENOMEFA_INDEX_SUFFIX ".gfi"
+#define GENOMEFA_INDEX_VERSION 3
+
+/*
+ * Encodings of sequences extracted by getSeqIntoBuf.
+ *  CHAR: 'A', 'C', 'G', 'T', 'N' ('*' for invalid bases), ended with '\0'
+ *  NT4: 0, 1, 2, 3 for 'A', 'C', 'G', 'T' and 4 for others, which can be used
+ *  for alignment directly.
+ */
+#define GENOMEFA_ENCODING_CHAR 0
+#define GENOMEFA_ENCODING_NT4 1
+
 /*********************************************************************
  *                     Structure Declarations
  ********************************************************************/
@@ -45,7 +62,7 @@ void destroy_GenomeFa(GenomeFa *gf);
 /**
  * @brief  Get length of the chromosome.
  */
-extern uint32_t chromFa_length(ChromFa *cf);
+extern int64_t chromFa_length(ChromFa *cf);
 
 /**
  * @brief  Get name of the chromosome.
@@ -54,6 +71,8 @@ extern const char *chromFa_name(ChromFa *cf);
 
 /**
  * @brief  Get the chrom according to given info of that chromosome.
+ * @note   The same as the other getChromFromGenomeFaby* methods, the chrom must
+ * be released by genomeFa_releaseChrom if the genome is loaded on demand.
  * @retval pointer to the ChromFa object matching the give info; NULL if not
  * found
  */
@@ -79,12 +98,44 @@ ChromFa *getChromFromGenomeFabyName(const char *name, GenomeFa *gf);
  */
 ChromFa *getChromFromGenomeFabyIndex(uint32_t idx, GenomeFa *gf);
 
+/**
+ * @brief  Get the names of all chroms in the GenomeFa object. Together with
+ * getChromFromGenomeFabyContig, a chrom can be located by an id translated
+ * from other files (see ContigTable) instead of by its name.
+ * @note   The header chrom is included, and thus the id of a chrom equals to
+ * its 1-based index if names of chroms are unique.
+ */
+const ContigDict *genomeFa_contigs(GenomeFa *gf);
+
+/**
+ * @brief  Get the chrom according to the id of its name in genomeFa_contigs.
+ * @retval pointer to the ChromFa object; NULL if the id is invalid
+ */
+ChromFa *getChromFromGenomeFabyContig(int32_t id_contig, GenomeFa *gf);
+
+/**
+ * @brief  Release a chrom got from the GenomeFa object (by info, name, index
+ * or contig) when its bases are not needed anymore.
+ * @note   Only necessary for genomes loaded by genomeFa_loadFileLazy, where
+ * getting a chrom decodes it on first access and marks it as in use, and only
+ * chroms not in use can be evicted. Each get must be paired with a release.
+ * Nothing is done for other genomes or NULL.
+ */
+void genomeFa_releaseChrom(ChromFa *cf, GenomeFa *gf);
+
+/**
+ * @brief  Get number of bases decoded from the reference genome file. For
+ * genomes loaded by genomeFa_loadFileLazy, only the accessed chroms are counted
+ * (again if decoded again after being evicted).
+ */
+uint64_t genomeFa_decodedBases(GenomeFa *gf);
+
 /**
  * @brief  Get the base according to given position in the chromosome.
  * @param  pos 1-based position of base
  * @retval Base type of the designated base
  */
-Base getBase(ChromFa *cf, uint32_t pos);
+Base getBase(ChromFa *cf, int64_t pos);
 
 /**
  * @brief  Get a specific base sequence from a ChromFa object.
@@ -97,23 +148,121 @@ Base getBase(ChromFa *cf, uint32_t pos);
  */
 char *getSeqFromChromFa(int64_t start, int64_t end, ChromFa *cf);
 
+/**
+ * @brief  Extract a specific base sequence from a ChromFa object into a buffer
+ * of the caller. Bases are decoded a whole coded word at a time.
+ * @param  start: 1-based start position, included
+ * @param  end: 1-based end position, included. Positions out of the chromosome
+ * are extracted as invalid bases.
+ * @param  *dst: buffer of at least (end - start + 1) bytes, plus 1 byte for
+ * '\0' if encoding is GENOMEFA_ENCODING_CHAR
+ * @param  encoding: GENOMEFA_ENCODING_CHAR or GENOMEFA_ENCODING_NT4
+ * @retval number of extracted bases; 0 if end < start
+ */
+int64_t getSeqIntoBuf(ChromFa *cf, int64_t start, int64_t end, void *dst,
+                      int encoding);
+
+/**
+ * @brief  Window of decoded bases on a chromosome, kept by a single thread.
+ * Sequences requested at increasing positions (from sorted reads for example)
+ * are sliced from the window, and the window slides forward decoding only the
+ * bases not decoded yet. Thus bases are decoded about once however many
+ * requests cover them.
+ */
+typedef struct WindowFa WindowFa;
+
+/**
+ * @brief  Create a window of decoded bases.
+ * @param  size: number of bases kept in the window. The window grows if a
+ * longer sequence is requested.
+ * @param  encoding: GENOMEFA_ENCODING_CHAR or GENOMEFA_ENCODING_NT4
+ */
+WindowFa *init_WindowFa(int64_t size, int encoding);
+
+void destroy_WindowFa(WindowFa *wf);
+
+/**
+ * @brief  Set the chromosome of the window. Decoded bases are dropped if the
+ * chromosome changes.
+ * @param  *cf: the chromosome. It must stay decoded (see
+ * genomeFa_releaseChrom) until the window is set to another one.
+ */
+void windowFa_setChrom(ChromFa *cf, WindowFa *wf);
+
+/**
+ * @brief  Get a sequence on the chromosome of the window, as getSeqIntoBuf
+ * does.
+ * @param  start: 1-based start position, included
+ * @param  end: 1-based end position, included
+ * @retval pointer to the (end - start + 1) bases in the window, which is valid
+ * until the next call. It is not ended with '\0'. NULL if the chromosome is
+ * not set.
+ */
+const char *windowFa_seq(int64_t start, int64_t end, WindowFa *wf);
+
+/**
+ * @brief  Get number of bases decoded by the window since it is created.
+ */
+uint64_t windowFa_decodedBases(WindowFa *wf);
+
 /**
  * @brief  Transit local position on a chromsome into the absolute position on the whole genome. For example, the current absolute position equals to the offset of current chromosome plus the ending position of its last chromosome.
  * @param  id_chrom: 1-based index for chromsomes.
  * @param  pos: 1-based position on current chromosome.
  * @retval absolute position on the whole genome
  */
-int32_t genomeFa_absolutePos(uint32_t id_chrom, int32_t pos, GenomeFa *gf);
+int64_t genomeFa_absolutePos(uint32_t id_chrom, int64_t pos, GenomeFa *gf);
 
 /*********************************************************************
  *                      Data Loading and Writing
  ********************************************************************/
 
 /**
- * @brief  Load genome data into a GenomeFa object from designated file.
+ * @brief  Load genome data into a GenomeFa object from designated file. The
+ * file can be compressed by bgzip (or gzip), and blocks compressed by bgzip are
+ * decompressed by multiple threads. The file is read in a single pass, so it
+ * can also be a pipe, or stdin ("-").
+ * @note  If the file is an index file, or "filePath" + GENOMEFA_INDEX_SUFFIX
+ * exists and is not older than the file, the index file is loaded instead (see
+ * genomeFa_loadIndexFile).
  */
 GenomeFa *genomeFa_loadFile(char *filePath);
 
+/**
+ * @brief  Load names and lengths of chromosomes from the samtools-compatible
+ * index ("filePath" + ".fai"), and decode the bases of each chromosome only
+ * when it is got from the GenomeFa object for the first time. The index is
+ * built if it does not exist or is older than the file.
+ * @note   Info lines are not kept in the index, so the info of each chrom is
+ * ">name". If the file cannot be indexed (lines of different lengths, pipes
+ * ...), the whole file is loaded by genomeFa_loadFile. Files compressed by
+ * bgzip are read on demand as well, using the index of compressed blocks
+ * ("filePath" + ".gzi") built together with the ".fai" index, but files
+ * compressed by gzip are loaded as a whole. An index file (see
+ * genomeFa_writeIndexFile) is mapped as genomeFa_loadFile does, which is also
+ * read on demand.
+ * @param  size_cache: maximal memory of decoded bases (bytes). When exceeded,
+ * the least recently used chroms not in use are freed, and decoded again when
+ * accessed later (see genomeFa_releaseChrom). 0 for no limit.
+ */
+GenomeFa *genomeFa_loadFileLazy(char *filePath, uint64_t size_cache);
+
+/**
+ * @brief  Write the coded bases, infos and offsets of all chromosomes into a
+ * binary index file, which can be mapped into memory directly.
+ * @note  The index file uses native byte order, so it should only be used on
+ * machines of the same architecture.
+ */
+void genomeFa_writeIndexFile(GenomeFa *gf, const char *filePath);
+
+/**
+ * @brief  Load genome data from an index file (see genomeFa_writeIndexFile).
+ * The file is mapped read-only, so startup takes almost no time and all
+ * processes using the same index share the bases in the page cache. The
+ * mapping is released by destroy_GenomeFa.
+ */
+GenomeFa *genomeFa_loadIndexFile(const char *filePath);
+
 /**
  * @brief Write genome data into a designated file.
  */
@@ -19,16 +19,21 @@
 
 #define BASE_INVALID 0b111
 
-// this BASE_MASK_LEFT and BASE_MASK_RIGHT can be used to extract a coded base
-// from a long integer (0b) 111 000 000 ... 000 0
-#define BASE_MASK_LEFT 0xE000000000000000
-#define BASE_MASK_RIGHT 0x0000000000000007
+/*
+ * Bases of a chromosome are packed with 2 bits for each base: (0b) 00, 01, 10
+ * and 11 for A, C, G and T, i.e. (Base - BASE_A). Other bases (N, IUPAC codes
+ * ...) are packed as A and kept in a separate list of runs (see genomeFa.c).
+ */
+#define BASE_CODE_LENGTH 2
 
-#define BASE_CODE_LENGTH 3
+// this BASE_MASK_LEFT and BASE_MASK_RIGHT can be used to extract a coded base
+// from a long integer (0b) 11 00 00 ... 00
+#define BASE_MASK_LEFT 0xC000000000000000
+#define BASE_MASK_RIGHT 0x0000000000000003
 
 #define MAX_INFO_LENGTH 2048
 
-#define BP_PER_UINT64 (sizeof(uint64_t) * 8 / 3)
+#define BP_PER_UINT64 (sizeof(uint64_t) * 8 / BASE_CODE_LENGTH)
 
 #define BP_PER_LINE 70
 
@@ -102,6 +102,10 @@ GenomeSam *init_GenomeSam() {
   gs->chromCnt = 0;
   gs->hdr = NULL;
   gs->css = NULL;
+  gs->contigs = init_ContigDict();
+  gs->capacity_chroms = 16;
+  gs->chroms_contig = (ChromSam **)calloc(gs->capacity_chroms,
+                                          sizeof(ChromSam *));
   return gs;
 }
 
@@ -116,6 +120,8 @@ void destroy_GenomeSam(GenomeSam *gs) {
     gs->chromCnt--;
     cs = tmpCs;
   }
+  destroy_ContigDict(gs->contigs);
+  free(gs->chroms_contig);
   free(gs);
 }
 
@@ -162,23 +168,41 @@ RecSam *gsItNextRec(GenomeSamIterator *gsIt) {
   return gsIt->tmpRs;
 }
 
+/**
+ * @brief  Make sure there is a slot in chroms_contig for the chrom with id.
+ */
+static void reserveChromSlot(GenomeSam *gs, int32_t id) {
+  if (id < gs->capacity_chroms) return;
+  int32_t capacity = gs->capacity_chroms;
+  while (capacity <= id) capacity *= 2;
+  gs->chroms_contig = (ChromSam **)realloc(gs->chroms_contig,
+                                           capacity * sizeof(ChromSam *));
+  if (gs->chroms_contig == NULL) {
+    fprintf(stderr, "Error: memory not enough for indexing ChromSam. \n");
+    exit(EXIT_FAILURE);
+  }
+  memset(gs->chroms_contig + gs->capacity_chroms, 0,
+         (capacity - gs->capacity_chroms) * sizeof(ChromSam *));
+  gs->capacity_chroms = capacity;
+}
+
 void addChromToGenomeSam(ChromSam *cs, GenomeSam *gs) {
+  int32_t id = contigDict_add(gs->contigs, cs->name);
+  reserveChromSlot(gs, id);
+  if (gs->chroms_contig[id] != NULL) {  // if there already exists the same cs
+    fprintf(stderr, "Warning: trying to add duplicated ChromSam. \n");
+    return;
+  }
+  gs->chroms_contig[id] = cs;
+
   ChromSam *tmpCs = gs->css;
   if (tmpCs == NULL) {  // if there is no chrom in GenomeSam
     gs->css = cs;
     gs->chromCnt++;
     return;
   }
-
-  while (tmpCs->next != NULL) {
-    if (strcmp(cs->name, tmpCs->name) ==
-        0) {  // if there already exists the same cs
-      fprintf(stderr, "Warning: trying to add duplicated ChromSam. \n");
-      return;
-    }
-    tmpCs = tmpCs->next;
-  }
-  // if same cs not found, add it to the end of the linked-list of ChromSam
+  while (tmpCs->next != NULL) tmpCs = tmpCs->next;
+  // add it to the end of the linked-list of ChromSam
   tmpCs->next = cs;
   gs->chromCnt++;
 }
@@ -240,16 +264,10 @@ void addRecToChromSam(RecSam *rs, ChromSam *cs) {
 }
 
 ChromSam *getChromFromGenomeSam(char *chromName, GenomeSam *gs) {
-  ChromSam *tmpCs = gs->css;
-  while (tmpCs != NULL) {
-    if (strcmp(tmpCs->name, chromName) == 0) {
-      return tmpCs;
-    } else {
-      tmpCs = tmpCs->next;
-    }
-  }
+  int32_t id = contigDict_id(gs->contigs, chromName);
   // if never found ChromSam with the same name as chromName
-  return NULL;
+  if (id < 0 || id >= gs->capacity_chroms) return NULL;
+  return gs->chroms_contig[id];
 }
 
 RecSam *getRecFromChromSam(uint32_t idx, ChromSam *cs) {
@@ -281,12 +299,17 @@ void loadGenomeSamFromFile(GenomeSam *gs, char *filePath) {
   } else {
     gs->hdr = sam_hdr_dup(hdr);
   }
+  // Register names in the header first, so that ids of chroms equal to tids
+  for (int32_t tid = 0; tid < hdr->n_targets; tid++) {
+    contigDict_add(gs->contigs, sam_hdr_tid2name(hdr, tid));
+  }
   if (rec == NULL) {
     fprintf(stderr, "Error: memory not enough for new bcf1_t object.\n");
     exit(EXIT_FAILURE);
   }
 
   ChromSam *lastUsedChrom = NULL;
+  int32_t lastUsedTid = -2;  // no read has this tid
   uint32_t loadedCnt = 0;
   while (sam_read1(fp, hdr, rec) >= 0) {
     // printSamRecord_brief(gs, rec);
@@ -295,21 +318,25 @@ void loadGenomeSamFromFile(GenomeSam *gs, char *filePath) {
     newRs->rec = bam_dup1(rec);
 
     //  add the record into GenomeSam object
-    char *rsChNam = getRecSam_chNam(newRs, gs);
-    if (lastUsedChrom != NULL &&
-        strcmp(rsChNam, lastUsedChrom->name) ==
-            0) {  // if the new record points to the same chrom as the last one
+    if (rsDataTid(newRs) == lastUsedTid) {
+      // if the new record points to the same chrom as the last one
       addRecToChromSam(newRs, lastUsedChrom);
     } else {
       // if the new record points to another chrom
-      lastUsedChrom = getChromFromGenomeSam(rsChNam, gs);
+      lastUsedTid = rsDataTid(newRs);
+      if (lastUsedTid >= 0) {
+        reserveChromSlot(gs, lastUsedTid);
+        lastUsedChrom = gs->chroms_contig[lastUsedTid];
+      } else {  // unmapped reads
+        lastUsedChrom = getChromFromGenomeSam("(unknown)", gs);
+      }
       if (lastUsedChrom == NULL) {
         // if there is no such chrom as the new record points to
         ChromSam *newCs = init_ChromSam();
-        newCs->name = rsChNam;
+        newCs->name = getRecSam_chNam(newRs, gs);
         addChromToGenomeSam(newCs, gs);
         lastUsedChrom = newCs;
-        // printf("... new chrom assigned, name: %s\n", rsChNam);
+        // printf("... new chrom assigned, name: %s\n", newCs->name);
       }
       addRecToChromSam(newRs, lastUsedChrom);
     }
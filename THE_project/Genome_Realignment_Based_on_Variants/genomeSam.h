@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "contigDict.h"
 #include "debug.h"
 
 /******************
@@ -35,6 +36,13 @@ typedef struct _define_GenomeSam {
   uint32_t chromCnt;
   bam_hdr_t *hdr;
   ChromSam *css;
+  /*
+   * Names of the chroms. Names in the header are added first, so the id of a
+   * chrom in the dictionary equals to its tid.
+   */
+  ContigDict *contigs;
+  ChromSam **chroms_contig;  // chroms_contig[id]: chrom with id in contigs
+  int32_t capacity_chroms;   // size of chroms_contig
 } GenomeSam;
 
 typedef struct _define_GenomeSamIterator {
@@ -64,6 +72,12 @@ static inline const char *rsDataQname(RecSam *rs) {
   return bam_get_qname(rsData(rs));
 }
 
+/**
+ * @brief  Get the tid of a mapped read, which is also the id of its chrom in
+ * gsDataContigs. -1 if the read is unmapped.
+ */
+static inline int32_t rsDataTid(RecSam *rs) { return rs->rec->core.tid; }
+
 static inline const char *rsDataRname(GenomeSam *gs, RecSam *rs) {
   return sam_hdr_tid2name(gs->hdr, rs->rec->core.tid);
 }
@@ -194,6 +208,10 @@ static inline uint32_t gsDataChromCnt(GenomeSam *gs) { return gs->chromCnt; }
 
 static inline bam_hdr_t *gsDataHdr(GenomeSam *gs) { return gs->hdr; }
 
+static inline const ContigDict *gsDataContigs(GenomeSam *gs) {
+  return gs->contigs;
+}
+
 /************************************
  * Methods for manipulating GenomeVcf
  ************************************/
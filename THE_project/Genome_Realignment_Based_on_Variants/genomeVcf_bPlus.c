@@ -1,15 +1,77 @@
 #include "genomeVcf_bPlus.h"
 
+#include <fcntl.h>
+#include <htslib/bgzf.h>
+#include <htslib/hfile.h>
+#include <htslib/kstring.h>
+#include <htslib/tbx.h>
+#include <htslib/thread_pool.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+// Keys of nodes are compared with AVX2 if the cpu supports it at runtime
+#define VCFBPLUS_DISPATCH_AVX2
+#endif
+
 /************************************
  *       Definitions: structures
  ************************************/
 
 struct RecVcf_bplus {
-  bcf1_t *data;          // Key is the record's POS
-  VcfBPlusNode *bpnode;  // Bpnode where this record is kept
-  RecVcf_bplus *next;    // Pointer to the next record that have the same POS
+  bcf1_t *data;  // Key is the record's POS. NULL for compact records
+  /*
+   * Pointer to the next record that have the same POS. For records of a static
+   * index (see StaticIndexVcf), pointer to the next record of the chromosome.
+   */
+  RecVcf_bplus *next;
+  /*
+   * Infos of alleles (AlleleInfoVcf[n_allele]), kept right after the record
+   * object, or in the record arena for records of a mapped index file.
+   */
+  AlleleInfoVcf *infos;
 };
 
+/*
+ * Compact vcf record (see genomeVcf_bplus_loadFileCompact). Only POS, ID and
+ * alleles are kept, in the string pool of the genome or in the mapped index
+ * file (see genomeVcf_bplus_loadIndexFile). The record object itself is kept
+ * in the record arena of the genome, and its data field is NULL.
+ */
+typedef struct _define_CompactRecVcf {
+  RecVcf_bplus rv;
+  int64_t pos;          // 1-based
+  int64_t offset_file;  // offset of the record in the vcf file; -1 if unknown
+  /*
+   * Types of the alleles (uint8_t[n_allele], see bcf_get_variant_type),
+   * followed by ID and the alleles, each ended with '\0'. No pointers are
+   * kept within, so that the strings can be mapped from an index file.
+   */
+  uint8_t *strs;
+  int32_t rid;  // id of the chromosome in contigs of the genome
+  uint16_t n_allele;
+} CompactRecVcf;
+
+/*
+ * Memory kept in blocks that are never moved, and thus pointers to objects
+ * within it are kept valid. Objects are freed together with the arena.
+ */
+typedef struct _define_ArenaVcf {
+  char **blocks;
+  int cnt_block;
+  int capacity_block;
+  size_t size_used;  // used bytes of the last block
+  size_t size_last;  // size of the last block
+} ArenaVcf;
+
+#define SIZE_BLOCK_ARENAVCF (1 << 20)
+
+#define SIZE_CACHE_LINE 64
+#define CNT_KEY_LINE (SIZE_CACHE_LINE / (int)sizeof(VcfBPlusKey))
+
 struct VcfBPlusNode {
   bool isLeaf;
   // Pointer to the parent of this bpnode
@@ -22,26 +84,32 @@ struct VcfBPlusNode {
 
   // Number of keys filled in this node
   int cnt_key;
-  /**
-   * @brief  A 1-dimension array of VcfBPlusKey. The size of it depends on
-   * whether this node is a leaf node. If it's a leaf node, size(keys) =
-   * rank_leaf_node. If it's an inner node, size(keys) = rank_inner_node - 1.
-   */
-  VcfBPlusKey *keys;
+  // Size of keys of this node, in whole cache lines (see keys)
+  int capacity_key;
 
   // Pointers to the node's brothers
   VcfBPlusNode *left;
   VcfBPlusNode *right;
 
   /**
-   * @brief  A 1-dimension array of pointers. The size of it depends on whether
-   * this node is a leaf node or an inner node. If it's a leaf node,
-   * size(pointers) = rank_leaf_node. If it's an inner node, size(pointers) =
-   * rank_inner_node. These pointers can point to either VcfBPlusNode, or
-   * RecVcf_bplus. As for the recognization of the pointers, it depends on the
-   * principle of a b plus tree.
+   * @brief  A 1-dimension array of pointers, kept right after the keys in the
+   * memory of this node. The size of it depends on whether this node is a leaf
+   * node or an inner node. If it's a leaf node, size(pointers) =
+   * rank_leaf_node. If it's an inner node, size(pointers) = rank_inner_node.
+   * These pointers can point to either VcfBPlusNode, or RecVcf_bplus. As for
+   * the recognization of the pointers, it depends on the principle of a b plus
+   * tree.
    */
   Pointer *pointers;
+
+  /**
+   * @brief  A 1-dimension array of VcfBPlusKey, which starts at a cache line.
+   * If it's a leaf node, size(keys) = rank_leaf_node. If it's an inner node,
+   * size(keys) = rank_inner_node - 1. The size is then rounded up to whole
+   * cache lines (CNT_KEY_LINE keys), and unused keys are unavailable_keyValue,
+   * so that keys can be searched line by line without checking cnt_key.
+   */
+  _Alignas(SIZE_CACHE_LINE) VcfBPlusKey keys[];
 };
 
 struct VcfBPlusTree {
@@ -53,13 +121,64 @@ struct VcfBPlusTree {
   VcfBPlusNode *last;
 };
 
+/*
+ * Read-only index of records of a chromosome (see genomeVcf_bplus_freeze).
+ * Distinct POS of records are kept in a sorted array in Eytzinger order (the
+ * order of a breadth-first traversal of a complete binary search tree), which
+ * is searched without branches, with the next levels prefetched. Records are
+ * linked in order of POS by their next fields.
+ */
+typedef struct _define_StaticIndexVcf {
+  int64_t cnt_key;
+  VcfBPlusKey *keys;     // keys[1..cnt_key] in Eytzinger order; keys[0] unused
+  RecVcf_bplus **heads;  // heads[k]: first record with POS keys[k]
+  bool ifMapped;         // keys are kept in the mapped index file
+} StaticIndexVcf;
+
+/*
+ * Area [start, end] of the reference covered by a record, where start is its
+ * POS and end is POS+len(REF)-1.
+ */
+typedef struct _define_AreaVcf {
+  int64_t start;
+  int64_t end;
+  int64_t max_end;  // max end of areas within the sub-tree of this area
+  RecVcf_bplus *rv;
+} AreaVcf;
+
+/*
+ * Index of areas covered by records of a chromosome, for finding records that
+ * overlap a window (see genomeVcf_bplus_indexOverlaps). Areas are sorted by
+ * start, and the array is an implicit binary search tree: an area whose index
+ * ends with exactly k bits of 1 is on level k, and its children are the areas
+ * at index-2^(k-1) and index+2^(k-1). Sub-trees whose max_end is before the
+ * window are skipped, and thus long deletions are found wherever they start.
+ */
+typedef struct _define_OverlapIndexVcf {
+  int64_t cnt_area;
+  int level_root;  // level of the root, which is at index 2^level_root-1
+  AreaVcf *areas;
+} OverlapIndexVcf;
+
 struct ChromVcf_bplus {
   char *name;
   // Number of records within this chrom (bplus tree)
   uint64_t cnt_rec;
-  // The tree structure for keeping data
+  // The tree structure for keeping data. NULL if the chrom is frozen.
   VcfBPlusTree *tree;
+  // Static index of a frozen chrom; NULL if records are kept in the tree
+  StaticIndexVcf *index;
+  // Index of areas covered by records; NULL if overlaps are not indexed
+  OverlapIndexVcf *overlaps;
   ChromVcf_bplus *next;
+  /*
+   * Bulk loading of sorted records (see chromVcf_bplus_appendRec). Records are
+   * packed into leaves from left to right and inner nodes are not built until
+   * chromVcf_bplus_build is called.
+   */
+  bool if_bulk;
+  // The last appended record
+  RecVcf_bplus *rv_last;
 };
 
 struct GenomeVcf_bplus {
@@ -67,6 +186,18 @@ struct GenomeVcf_bplus {
   uint32_t cnt_chrom;
   // This is a linked-list without empty header.
   ChromVcf_bplus *chroms;
+  // Names of chroms. Contigs in the header are added first in order of their
+  // rids, so the id of a chrom equals to the rid of its records.
+  ContigDict *contigs;
+  // chroms_contig[id]: chrom with id in contigs; NULL if it has no records
+  ChromVcf_bplus **chroms_contig;
+  int32_t capacity_chroms;  // size of chroms_contig
+  // Compact records and their strings. NULL if records are bcf1_t objects.
+  ArenaVcf *arena_rec;
+  ArenaVcf *pool_str;
+  char *filePath;  // vcf file, where compact records are fetched from
+  void *mappedIndex;  // the mapped index file, or NULL if loaded from vcf
+  size_t size_mappedIndex;
 };
 
 /************************************
@@ -183,15 +314,171 @@ void vcfbplus_node_locate(VcfBPlusKey requested_key, VcfBPlusNode *localRoot,
 void vcfbplus_tree_insertRec(RecVcf_bplus *rv, VcfBPlusTree *bptree);
 
 /**
- * @brief  Synchronize all records' fields in genomeVcf (update pointers and
- * validate their connections).
+ * @brief  Build inner levels of the bplus tree from bottom to top, upon the
+ * leaf nodes linked from bptree->first to bptree->last.
+ */
+void vcfbplus_tree_build(VcfBPlusTree *bptree);
+
+/**
+ * @brief  Append a record to a chromosome. While records are appended in order
+ * of POS, they are packed into full leaf nodes and the inner nodes are built
+ * later by chromVcf_bplus_build. Once a record comes out of order, the tree is
+ * built and this record, together with all records afterwards, is inserted.
+ * @param  *rv: appended record. Note that this method will not create a copy
+ * of the input record object.
+ */
+void chromVcf_bplus_appendRec(ChromVcf_bplus *cv, RecVcf_bplus *rv);
+
+/**
+ * @brief  Finish bulk loading of a chromosome and build its bplus tree.
  */
-void genomeVcf_bplus_synchronize(GenomeVcf_bplus *gv);
+void chromVcf_bplus_build(ChromVcf_bplus *cv);
 
 /************************************
  *         Basic Structures
  ************************************/
 
+static ArenaVcf *init_ArenaVcf() {
+  ArenaVcf *av = (ArenaVcf *)calloc(1, sizeof(ArenaVcf));
+  if (av == NULL) {
+    fprintf(stderr, "Error: memory not enough for vcf records.\n");
+    exit(EXIT_FAILURE);
+  }
+  return av;
+}
+
+static void destroy_ArenaVcf(ArenaVcf *av) {
+  if (av == NULL) return;
+  for (int i = 0; i < av->cnt_block; i++) free(av->blocks[i]);
+  free(av->blocks);
+  free(av);
+}
+
+/**
+ * @brief  Move all blocks of src into dst, and destroy src. Objects within the
+ * blocks are kept where they are.
+ */
+static void arenaVcf_merge(ArenaVcf *dst, ArenaVcf *src) {
+  if (src->cnt_block > 0) {
+    if (dst->cnt_block + src->cnt_block > dst->capacity_block) {
+      dst->capacity_block = dst->cnt_block + src->cnt_block;
+      dst->blocks = (char **)realloc(dst->blocks,
+                                     dst->capacity_block * sizeof(char *));
+      if (dst->blocks == NULL) {
+        fprintf(stderr, "Error: memory not enough for vcf records.\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    memcpy(dst->blocks + dst->cnt_block, src->blocks,
+           src->cnt_block * sizeof(char *));
+    dst->cnt_block += src->cnt_block;
+    // Objects are then allocated from the last block of src
+    dst->size_used = src->size_used;
+    dst->size_last = src->size_last;
+  }
+  free(src->blocks);
+  free(src);
+}
+
+/**
+ * @brief  Allocate memory from the arena. The memory is aligned to 8 bytes.
+ */
+static void *arenaVcf_alloc(size_t size, ArenaVcf *av) {
+  size = (size + 7) & ~(size_t)7;
+  if (av->cnt_block == 0 || av->size_used + size > av->size_last) {
+    if (av->cnt_block == av->capacity_block) {
+      av->capacity_block =
+          av->capacity_block == 0 ? 64 : av->capacity_block * 2;
+      av->blocks =
+          (char **)realloc(av->blocks, av->capacity_block * sizeof(char *));
+    }
+    av->size_last = size > SIZE_BLOCK_ARENAVCF ? size : SIZE_BLOCK_ARENAVCF;
+    char *block = (char *)malloc(av->size_last);
+    if (av->blocks == NULL || block == NULL) {
+      fprintf(stderr, "Error: memory not enough for vcf records.\n");
+      exit(EXIT_FAILURE);
+    }
+    av->blocks[av->cnt_block++] = block;
+    av->size_used = 0;
+  }
+  void *ret = av->blocks[av->cnt_block - 1] + av->size_used;
+  av->size_used += size;
+  return ret;
+}
+
+/**
+ * @brief  Get the offset of the next record to read in the vcf file.
+ * @retval -1 if the offset is unavailable
+ */
+static int64_t tellFileVcf(htsFile *fp) {
+  if (fp->is_bgzf) return bgzf_tell(fp->fp.bgzf);
+  return fp->fp.hfile == NULL ? -1 : (int64_t)htell(fp->fp.hfile);
+}
+
+/**
+ * @brief  Set the info of an allele.
+ * @param  length: length of the allele
+ * @param  length_ref: length of REF of the record
+ * @param  type: type of the allele (see bcf_get_variant_type)
+ * @param  offset: offset of the allele in strs of a compact record; 0 for
+ * other records
+ */
+static void setAlleleInfoVcf(AlleleInfoVcf *info, int32_t length,
+                             int32_t length_ref, int type, int32_t offset) {
+  info->length = length;
+  info->length_cover = length_ref;
+  info->length_sv = length > length_ref ? length : length_ref;
+  info->type = type;
+  info->offset = offset;
+}
+
+/**
+ * @brief  Initialize a compact vcf record object.
+ * @param  *data: vcf record with at least BCF_UN_STR unpacked. Only its POS, ID
+ * and alleles are copied.
+ * @param  rid: id of the chromosome of the record in contigs of gv
+ * @param  offset_file: offset of the record in the vcf file
+ * @param  *arena_rec, *pool_str: arenas the record and its strings are
+ * allocated from
+ * @retval A vcf record object kept in the arenas. Do not destroy it.
+ */
+static RecVcf_bplus *init_CompactRecVcf(bcf1_t *data, int32_t rid,
+                                        int64_t offset_file,
+                                        ArenaVcf *arena_rec,
+                                        ArenaVcf *pool_str) {
+  CompactRecVcf *crv = (CompactRecVcf *)arenaVcf_alloc(
+      sizeof(CompactRecVcf) + data->n_allele * sizeof(AlleleInfoVcf),
+      arena_rec);
+  crv->rv.data = NULL;
+  crv->rv.next = NULL;
+  crv->rv.infos = (AlleleInfoVcf *)(crv + 1);
+  crv->pos = data->pos + 1;
+  crv->offset_file = offset_file;
+  crv->rid = rid;
+  crv->n_allele = data->n_allele;
+  // Layout: types[n_allele], ID, alleles (strings)
+  size_t size = data->n_allele * sizeof(uint8_t);
+  size_t length_id = strlen(data->d.id);
+  size += length_id + 1;
+  size_t length_alleles[data->n_allele];
+  for (int i = 0; i < data->n_allele; i++) {
+    length_alleles[i] = strlen(data->d.allele[i]);
+    size += length_alleles[i] + 1;
+  }
+  crv->strs = (uint8_t *)arenaVcf_alloc(size, pool_str);
+  char *str = (char *)(crv->strs + data->n_allele);
+  memcpy(str, data->d.id, length_id + 1);
+  str += length_id + 1;
+  for (int i = 0; i < data->n_allele; i++) {
+    crv->strs[i] = (uint8_t)bcf_get_variant_type(data, i);
+    memcpy(str, data->d.allele[i], length_alleles[i] + 1);
+    setAlleleInfoVcf(crv->rv.infos + i, length_alleles[i], length_alleles[0],
+                     crv->strs[i], (int32_t)((uint8_t *)str - crv->strs));
+    str += length_alleles[i] + 1;
+  }
+  return (RecVcf_bplus *)crv;
+}
+
 /**
  * @brief  Initialize a vcf record object.
  * @param  *data: vcf record. This method will create a copy of the record, and
@@ -201,47 +488,18 @@ void genomeVcf_bplus_synchronize(GenomeVcf_bplus *gv);
  * @retval A vcf record object. Must be freed using destroy_RecVcf_bplus method.
  */
 RecVcf_bplus *init_RecVcf_bplus(bcf1_t *data, RecVcf_bplus *next) {
-  RecVcf_bplus *rv = (RecVcf_bplus *)malloc(sizeof(RecVcf_bplus));
-  rv->bpnode = NULL;
+  RecVcf_bplus *rv = (RecVcf_bplus *)malloc(
+      sizeof(RecVcf_bplus) + data->n_allele * sizeof(AlleleInfoVcf));
   rv->data = bcf_dup(data);
   bcf_unpack(rv->data, BCF_UN_ALL);
   rv->next = next;
-  return rv;
-}
-
-RecVcf_bplus *next_RecVcf_bplus(RecVcf_bplus *rv) {
-  if (rv->next != NULL) {
-    // There exists records with the same POS
-    return rv->next;
-  } else {
-    // Find next record on bpnodes
-    VcfBPlusNode *bpnode = rv->bpnode;
-    if (bpnode == NULL) {
-      fprintf(stderr,
-              "Error: need to synchronize genomeVcf before iteration.\n");
-      exit(EXIT_FAILURE);
-    } else {
-      int ret_pointerIdx = 0;
-      vcfbplus_node_locate(rv_pos(rv), bpnode, &ret_pointerIdx);
-      ret_pointerIdx = ret_pointerIdx + 1;  // Go on to the next record
-      if (ret_pointerIdx < bpnode->cnt_key) {
-        // Find next record on this bpnode
-        return (RecVcf_bplus *)bpnode->pointers[ret_pointerIdx];
-      } else {
-        // If the next record is not on this bpnode
-        bpnode = bpnode->right;
-        if (bpnode == NULL) {
-          // If this bpnode is the last bpnode
-          return NULL;
-        } else {
-          // According to principles of bplus tree, the next bpnode must be
-          // unempty if it exists.
-          assert(bpnode->pointers[0] != NULL);
-          return (RecVcf_bplus *)bpnode->pointers[0];
-        }
-      }
-    }
+  rv->infos = (AlleleInfoVcf *)(rv + 1);
+  int32_t length_ref = strlen(rv->data->d.allele[0]);
+  for (int i = 0; i < rv->data->n_allele; i++) {
+    setAlleleInfoVcf(rv->infos + i, strlen(rv->data->d.allele[i]), length_ref,
+                     bcf_get_variant_type(rv->data, i), 0);
   }
+  return rv;
 }
 
 /**
@@ -249,6 +507,8 @@ RecVcf_bplus *next_RecVcf_bplus(RecVcf_bplus *rv) {
  * connection to the next record with the same POS.
  */
 void destroy_RecVcf_bplus(RecVcf_bplus *rv) {
+  // Compact records are freed together with the arena of the genome
+  if (rv->data == NULL) return;
   bcf_destroy1(rv_object(rv));
   free(rv);
 }
@@ -263,24 +523,30 @@ void destroy_RecVcf_bplus(RecVcf_bplus *rv) {
  * one of the records, instead of destroying a single node.
  */
 VcfBPlusNode *init_VcfBPlusNode(bool isLeaf) {
-  VcfBPlusNode *bpnode = (VcfBPlusNode *)malloc(sizeof(VcfBPlusNode));
+  // Keys and pointers are kept in the same memory as the node
+  int cnt_key_max = isLeaf ? RANK_LEAF_NODE : RANK_INNER_NODE - 1;
+  int capacity_key =
+      (cnt_key_max + CNT_KEY_LINE - 1) / CNT_KEY_LINE * CNT_KEY_LINE;
+  int cnt_pointer = isLeaf ? RANK_LEAF_NODE : RANK_INNER_NODE;
+  size_t size_node = sizeof(VcfBPlusNode) + capacity_key * sizeof(VcfBPlusKey) +
+                     cnt_pointer * sizeof(Pointer);
+  VcfBPlusNode *bpnode = NULL;
+  if (posix_memalign((void **)&bpnode, SIZE_CACHE_LINE, size_node) != 0) {
+    fprintf(stderr, "Error: memory not enough for bplus tree nodes.\n");
+    exit(EXIT_FAILURE);
+  }
   bpnode->isLeaf = isLeaf;
   bpnode->parent = NULL;
   // bpnode->idx_key_parent = -1;
   // bpnode->idx_pointer_parent = -1;
   bpnode->cnt_key = 0;
+  bpnode->capacity_key = capacity_key;
   bpnode->left = NULL;
   bpnode->right = NULL;
-  // Assign memories for pointers
-  // Use calloc to set all values either NULL or unavailable_keyValue
-  if (isLeaf) {
-    bpnode->keys = (VcfBPlusKey *)calloc(RANK_LEAF_NODE, sizeof(VcfBPlusKey));
-    bpnode->pointers = (Pointer *)calloc(RANK_LEAF_NODE, sizeof(Pointer));
-  } else {
-    bpnode->keys =
-        (VcfBPlusKey *)calloc(RANK_INNER_NODE - 1, sizeof(VcfBPlusKey));
-    bpnode->pointers = (Pointer *)calloc(RANK_INNER_NODE, sizeof(Pointer));
-  }
+  // Set all values either NULL or unavailable_keyValue
+  for (int i = 0; i < capacity_key; i++) bpnode->keys[i] = unavailable_keyValue;
+  bpnode->pointers = (Pointer *)(bpnode->keys + capacity_key);
+  memset(bpnode->pointers, 0, cnt_pointer * sizeof(Pointer));
   return bpnode;
 }
 
@@ -337,18 +603,61 @@ ChromVcf_bplus *init_ChromVcf_bplus(const char *name) {
   return cv;
 }
 
+static void destroy_StaticIndexVcf(StaticIndexVcf *si) {
+  // The record with the smallest POS is the leftmost node of the binary tree
+  int64_t k = 1;
+  while (k * 2 <= si->cnt_key) k = k * 2;
+  RecVcf_bplus *rv = si->cnt_key == 0 ? NULL : si->heads[k];
+  while (rv != NULL) {
+    RecVcf_bplus *tmp_rv = rv->next;
+    destroy_RecVcf_bplus(rv);
+    rv = tmp_rv;
+  }
+  if (si->ifMapped == false) free(si->keys);
+  free(si->heads);
+  free(si);
+}
+
+static void destroy_OverlapIndexVcf(OverlapIndexVcf *oi) {
+  if (oi == NULL) return;
+  free(oi->areas);
+  free(oi);
+}
+
 void destroy_ChromVcf_bplus(ChromVcf_bplus *cv) {
   free(cv->name);
-  destroy_VcfBPlusTree(cv->tree);
+  destroy_OverlapIndexVcf(cv->overlaps);
+  if (cv->index != NULL) {
+    destroy_StaticIndexVcf(cv->index);
+  } else {
+    destroy_VcfBPlusTree(cv->tree);
+  }
   free(cv);
 }
 
-GenomeVcf_bplus *init_GenomeVcf_bplus(int rank_inner_node, int rank_leaf_node,
-                                      bcf_hdr_t *hdr) {
+/**
+ * @brief  Set ranks of nodes of all bplus trees created afterwards.
+ */
+static void vcfbplus_setRanks(int rank_inner_node, int rank_leaf_node) {
   RANK_INNER_NODE = rank_inner_node;
   RANK_LEAF_NODE = rank_leaf_node;
+}
+
+GenomeVcf_bplus *init_GenomeVcf_bplus(int rank_inner_node, int rank_leaf_node,
+                                      bcf_hdr_t *hdr) {
+  vcfbplus_setRanks(rank_inner_node, rank_leaf_node);
   GenomeVcf_bplus *gv = (GenomeVcf_bplus *)calloc(1, sizeof(GenomeVcf_bplus));
   gv->hdr = bcf_hdr_dup(hdr);
+  gv->contigs = init_ContigDict();
+  int cnt_seqname = 0;
+  const char **seqnames = bcf_hdr_seqnames(hdr, &cnt_seqname);
+  for (int rid = 0; rid < cnt_seqname; rid++) {
+    contigDict_add(gv->contigs, seqnames[rid]);
+  }
+  free(seqnames);
+  gv->capacity_chroms = cnt_seqname > 16 ? cnt_seqname : 16;
+  gv->chroms_contig = (ChromVcf_bplus **)calloc(gv->capacity_chroms,
+                                                sizeof(ChromVcf_bplus *));
   return gv;
 }
 
@@ -359,6 +668,13 @@ void destroy_GenomeVcf_bplus(GenomeVcf_bplus *gv) {
     destroy_ChromVcf_bplus(cv);
     cv = tmp_cv;
   }
+  destroy_ContigDict(gv->contigs);
+  free(gv->chroms_contig);
+  destroy_ArenaVcf(gv->arena_rec);
+  destroy_ArenaVcf(gv->pool_str);
+  free(gv->filePath);
+  if (gv->mappedIndex != NULL) munmap(gv->mappedIndex, gv->size_mappedIndex);
+  bcf_hdr_destroy(gv->hdr);
   free(gv);
 }
 
@@ -369,6 +685,14 @@ void genomeVcf_bplus_traverse(GenomeVcf_bplus *gv) {
   while (cv != NULL) {
     // Print info fields of the chromosome
     printf("chrom: %s, cnt(records): %" PRIu64 "\n", cv->name, cv->cnt_rec);
+    if (cv->index != NULL) {
+      CursorVcf cursor = chromVcf_bplus_cursor(cv, 1);
+      for (; cursor.rv != NULL; cursorVcf_next(&cursor)) {
+        genomeVcf_bplus_printRec(gv, cursor.rv);
+      }
+      cv = cv->next;
+      continue;
+    }
     VcfBPlusNode *node = cv->tree->first;  // start from the first node
     // Print all nodes in the chromosome
     while (node != NULL) {
@@ -379,7 +703,7 @@ void genomeVcf_bplus_traverse(GenomeVcf_bplus *gv) {
         // Print all records in the element (linked-list)
         while (rv != NULL) {
           genomeVcf_bplus_printRec(gv, rv);
-          rv = next_RecVcf_bplus(rv);
+          rv = rv->next;
         }
       }
       printf("node key cnt: %d, node root: %p\n", node->cnt_key, node->parent);
@@ -789,31 +1113,62 @@ void vcfbplus_node_insert(VcfBPlusTree *bptree, VcfBPlusNode *bpnode,
   }
 }
 
-void vcfbplus_node_locate(VcfBPlusKey requested_key, VcfBPlusNode *localRoot,
-                          int *ret_pointerIdx) {
-  *ret_pointerIdx = -1;
+#if defined(VCFBPLUS_DISPATCH_AVX2)
+/**
+ * @brief  Count keys of the bpnode that are smaller than the requested key.
+ * All cache lines of keys are compared without branches, as unused keys are
+ * unavailable_keyValue, which is bigger than any requested key.
+ */
+__attribute__((target("avx2"))) static int
+vcfbplus_node_countSmallerKeys_avx2(VcfBPlusKey requested_key,
+                                    const VcfBPlusNode *bpnode) {
+  int cnt = 0;
+  const __m256i key = _mm256_set1_epi64x(requested_key);
+  for (int i = 0; i < bpnode->capacity_key; i += 4) {
+    __m256i keys = _mm256_load_si256((const __m256i *)(bpnode->keys + i));
+    cnt += __builtin_popcount(
+        _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(key, keys))));
+  }
+  return cnt;
+}
+#endif
+
+/**
+ * @brief  Count keys of the bpnode that are smaller than the requested key.
+ * Keys are compared with AVX2 if the cpu supports it. Otherwise, filled keys
+ * are binary searched.
+ */
+static inline int vcfbplus_node_countSmallerKeys(VcfBPlusKey requested_key,
+                                                 const VcfBPlusNode *bpnode) {
+#if defined(VCFBPLUS_DISPATCH_AVX2)
+  if (__builtin_cpu_supports("avx2")) {
+    return vcfbplus_node_countSmallerKeys_avx2(requested_key, bpnode);
+  }
+#endif
+  // Binary search within filled keys
   int l_idx = 0;
-  int r_idx = localRoot->cnt_key - 1;
-  while (1) {
-    // Binary search the position of the requested key
-    if (l_idx <= r_idx) {
-      int mid_idx = (l_idx + r_idx) / 2;
-      VcfBPlusKey mid_key = localRoot->keys[mid_idx];
-      if (requested_key == mid_key) {
-        *ret_pointerIdx = mid_idx;
-        if (localRoot->isLeaf == false) *ret_pointerIdx = *ret_pointerIdx + 1;
-        return;
-      } else if (mid_key < requested_key) {
-        l_idx = mid_idx + 1;
-      } else {
-        r_idx = mid_idx - 1;
-      }
-    } else {  // If there is no such record with requested key
-      *ret_pointerIdx = l_idx - 1;
-      *ret_pointerIdx = *ret_pointerIdx + 1;
-      return;
+  int r_idx = bpnode->cnt_key - 1;
+  while (l_idx <= r_idx) {
+    int mid_idx = (l_idx + r_idx) / 2;
+    VcfBPlusKey mid_key = bpnode->keys[mid_idx];
+    if (mid_key == requested_key) return mid_idx;
+    if (mid_key < requested_key) {
+      l_idx = mid_idx + 1;
+    } else {
+      r_idx = mid_idx - 1;
     }
   }
+  return l_idx;
+}
+
+void vcfbplus_node_locate(VcfBPlusKey requested_key, VcfBPlusNode *localRoot,
+                          int *ret_pointerIdx) {
+  int idx = vcfbplus_node_countSmallerKeys(requested_key, localRoot);
+  // In an inner node, the pointer after the requested key leads to it
+  if (localRoot->isLeaf == false) {
+    idx += idx < localRoot->cnt_key && localRoot->keys[idx] == requested_key;
+  }
+  *ret_pointerIdx = idx;
 }
 
 void vcfbplus_tree_insertRec(RecVcf_bplus *rv, VcfBPlusTree *bptree) {
@@ -837,45 +1192,172 @@ void vcfbplus_tree_insertRec(RecVcf_bplus *rv, VcfBPlusTree *bptree) {
                             (Pointer)rv);
 }
 
+/**
+ * @brief  Get the chromosome with id in contigs of the genome. If there exists
+ * no such chromosome, create it.
+ */
+static ChromVcf_bplus *genomeVcf_bplus_chromOfContig(GenomeVcf_bplus *gv,
+                                                     int32_t id) {
+  if (id >= gv->capacity_chroms) {
+    int32_t capacity = gv->capacity_chroms;
+    while (capacity <= id) capacity *= 2;
+    gv->chroms_contig = (ChromVcf_bplus **)realloc(
+        gv->chroms_contig, capacity * sizeof(ChromVcf_bplus *));
+    memset(gv->chroms_contig + gv->capacity_chroms, 0,
+           (capacity - gv->capacity_chroms) * sizeof(ChromVcf_bplus *));
+    gv->capacity_chroms = capacity;
+  }
+  ChromVcf_bplus *cv = gv->chroms_contig[id];
+  // Possibly there exists no such chromosome
+  if (cv == NULL) {
+    cv = init_ChromVcf_bplus(contigDict_name(gv->contigs, id));
+    gv->chroms_contig[id] = cv;
+    ChromVcf_bplus *tmp_chromVcf = gv->chroms;
+    if (tmp_chromVcf == NULL) {
+      gv->chroms = cv;
+    } else {
+      while (tmp_chromVcf->next != NULL) tmp_chromVcf = tmp_chromVcf->next;
+      tmp_chromVcf->next = cv;
+    }
+    gv->cnt_chrom++;
+  }
+  return cv;
+}
+
+/**
+ * @brief  Get the chromosome where a record should be kept. If there exists no
+ * such chromosome, create it.
+ */
+static ChromVcf_bplus *genomeVcf_bplus_chromOfRec(GenomeVcf_bplus *gv,
+                                                  RecVcf_bplus *rv) {
+  // Locate the chromosome by rid. Contigs missing in the header are added to
+  // the dictionary by name.
+  int32_t id =
+      rv->data == NULL ? ((CompactRecVcf *)rv)->rid : rv->data->rid;
+  if (id < 0 || id >= contigDict_cnt(gv->contigs)) {
+    id = contigDict_add(gv->contigs, rv_chromName(rv, gv));
+  }
+  return genomeVcf_bplus_chromOfContig(gv, id);
+}
+
 void genomeVcf_bplus_insertRec(GenomeVcf_bplus *gv, RecVcf_bplus *rv) {
-  const char *chromName = rv_chromName(rv, gv);
-  // The static variable is used for keeping the last used chromosome.
-  // This will accelerate the program by omitting the process of locating
-  // chromosome, if requested chrom is the same as the last used one.
-  static ChromVcf_bplus *lastUsed_chromVcf;
-  if (lastUsed_chromVcf == NULL ||
-      strcmp(chromName, lastUsed_chromVcf->name) != 0) {
-    // Locate the chromosome (check from the 1st chrom in the linked-list)
-    lastUsed_chromVcf = gv->chroms;
-    while (lastUsed_chromVcf != NULL) {
-      if (strcmp(lastUsed_chromVcf->name, chromName) == 0) {
-        break;
-      } else {
-        lastUsed_chromVcf = lastUsed_chromVcf->next;
+  ChromVcf_bplus *cv = genomeVcf_bplus_chromOfRec(gv, rv);
+  if (cv->index != NULL) {
+    fprintf(stderr, "Error: records cannot be inserted into frozen chrom %s\n",
+            cv->name);
+    exit(EXIT_FAILURE);
+  }
+  // Records inserted later are not indexed until indexing overlaps again
+  destroy_OverlapIndexVcf(cv->overlaps);
+  cv->overlaps = NULL;
+  if (cv->if_bulk) chromVcf_bplus_build(cv);
+  // Insert the record into vcf_bplus tree
+  vcfbplus_tree_insertRec(rv, cv->tree);
+  cv->cnt_rec++;
+}
+
+void vcfbplus_tree_build(VcfBPlusTree *bptree) {
+  int64_t cnt_node = 0;
+  for (VcfBPlusNode *bpnode = bptree->first; bpnode != NULL;
+       bpnode = bpnode->right) {
+    cnt_node++;
+  }
+  // Nodes of the current level and the leftmost keys of their sub-trees
+  VcfBPlusNode **nodes =
+      (VcfBPlusNode **)malloc(cnt_node * sizeof(VcfBPlusNode *));
+  VcfBPlusKey *keys_leftmost =
+      (VcfBPlusKey *)malloc(cnt_node * sizeof(VcfBPlusKey));
+  if (nodes == NULL || keys_leftmost == NULL) {
+    fprintf(stderr, "Error: memory not enough for building bplus tree.\n");
+    exit(EXIT_FAILURE);
+  }
+  int64_t idx_node = 0;
+  for (VcfBPlusNode *bpnode = bptree->first; bpnode != NULL;
+       bpnode = bpnode->right) {
+    nodes[idx_node] = bpnode;
+    keys_leftmost[idx_node] = bpnode->keys[0];
+    idx_node++;
+  }
+  bptree->height = 1;
+  while (cnt_node > 1) {
+    // Spread nodes evenly over their parents, so that each parent has at least
+    // 2 children.
+    int64_t cnt_parent = (cnt_node + RANK_INNER_NODE - 1) / RANK_INNER_NODE;
+    int64_t idx_child = 0;
+    for (int64_t idx_parent = 0; idx_parent < cnt_parent; idx_parent++) {
+      int64_t cnt_parent_left = cnt_parent - idx_parent;
+      int cnt_child =
+          (cnt_node - idx_child + cnt_parent_left - 1) / cnt_parent_left;
+      VcfBPlusNode *parent = init_VcfBPlusNode(false);
+      parent->pointers[0] = nodes[idx_child];
+      nodes[idx_child]->parent = parent;
+      for (int i = 1; i < cnt_child; i++) {
+        parent->keys[i - 1] = keys_leftmost[idx_child + i];
+        parent->pointers[i] = nodes[idx_child + i];
+        nodes[idx_child + i]->parent = parent;
       }
+      parent->cnt_key = cnt_child - 1;
+      // Parents overwrite their children, which have been linked
+      keys_leftmost[idx_parent] = keys_leftmost[idx_child];
+      nodes[idx_parent] = parent;
+      idx_child += cnt_child;
     }
-    // Possibly there exists no such chromosome
-    if (lastUsed_chromVcf == NULL) {
-      lastUsed_chromVcf = init_ChromVcf_bplus(chromName);
-      ChromVcf_bplus *tmp_chromVcf = gv->chroms;
-      if (tmp_chromVcf == NULL) {
-        gv->chroms = lastUsed_chromVcf;
-      } else {
-        while (tmp_chromVcf != NULL) {
-          if (tmp_chromVcf->next == NULL) {
-            tmp_chromVcf->next = lastUsed_chromVcf;
-            break;
-          } else {
-            tmp_chromVcf = tmp_chromVcf->next;
-          }
-        }
-      }
-      gv->cnt_chrom++;
+    cnt_node = cnt_parent;
+    bptree->height = bptree->height + 1;
+  }
+  bptree->root = nodes[0];
+  free(nodes);
+  free(keys_leftmost);
+}
+
+void chromVcf_bplus_appendRec(ChromVcf_bplus *cv, RecVcf_bplus *rv) {
+  if (cv->index != NULL) {
+    fprintf(stderr, "Error: records cannot be inserted into frozen chrom %s\n",
+            cv->name);
+    exit(EXIT_FAILURE);
+  }
+  destroy_OverlapIndexVcf(cv->overlaps);
+  cv->overlaps = NULL;
+  VcfBPlusKey appended_key = rv_pos(rv);
+  if (cv->cnt_rec == 0) cv->if_bulk = true;
+  if (cv->if_bulk && cv->rv_last != NULL &&
+      appended_key < rv_pos(cv->rv_last)) {
+    // Unsorted records. Fall back to insertion.
+    chromVcf_bplus_build(cv);
+  }
+  if (cv->if_bulk == false) {
+    vcfbplus_tree_insertRec(rv, cv->tree);
+    cv->cnt_rec++;
+    return;
+  }
+  VcfBPlusTree *bptree = cv->tree;
+  VcfBPlusNode *bpnode = bptree->last;
+  if (cv->rv_last != NULL && appended_key == rv_pos(cv->rv_last)) {
+    // Link the record with records that have the same POS
+    cv->rv_last->next = rv;
+  } else {
+    if (bpnode->cnt_key == RANK_LEAF_NODE) {
+      // This leaf node is full. Start a new one on its right.
+      VcfBPlusNode *new_bpnode = init_VcfBPlusNode(true);
+      new_bpnode->left = bpnode;
+      bpnode->right = new_bpnode;
+      bptree->last = new_bpnode;
+      bpnode = new_bpnode;
     }
+    bpnode->keys[bpnode->cnt_key] = appended_key;
+    bpnode->pointers[bpnode->cnt_key] = (Pointer)rv;
+    bpnode->cnt_key = bpnode->cnt_key + 1;
+  }
+  cv->rv_last = rv;
+  cv->cnt_rec++;
+}
+
+void chromVcf_bplus_build(ChromVcf_bplus *cv) {
+  if (cv->index != NULL) return;
+  if (cv->if_bulk) {
+    vcfbplus_tree_build(cv->tree);
+    cv->if_bulk = false;
   }
-  // Insert the record into vcf_bplus tree
-  vcfbplus_tree_insertRec(rv, lastUsed_chromVcf->tree);
-  lastUsed_chromVcf->cnt_rec++;
 }
 
 void genomeVcf_bplus_removeRec(GenomeVcf_bplus *gv, RecVcf_bplus *rv) {
@@ -885,48 +1367,50 @@ void genomeVcf_bplus_removeRec(GenomeVcf_bplus *gv, RecVcf_bplus *rv) {
   exit(EXIT_FAILURE);
 }
 
+const ContigDict *genomeVcf_bplus_contigs(GenomeVcf_bplus *gv) {
+  return gv->contigs;
+}
+
+ChromVcf_bplus *genomeVcf_bplus_getChromByContig(GenomeVcf_bplus *gv,
+                                                 int32_t id_contig) {
+  if (id_contig < 0 || id_contig >= gv->capacity_chroms) return NULL;
+  return gv->chroms_contig[id_contig];
+}
+
 RecVcf_bplus *genomeVcf_bplus_getRecAfterPos(GenomeVcf_bplus *gv,
                                              const char *chromName,
                                              int64_t pos) {
-  assert(pos >= 1);
-  // Locate the chromosome of vcf records
-  // The following codes used "static" to accelerate the process. But in a
-  // multi-thread program, I'm afraid that this may result in bugs. Because I
-  // didn't add a thread-lock here. So we used the simple impelmention.
-  /*
-  static ChromVcf_bplus *lastUsed_chromVcf;
-  if (lastUsed_chromVcf == NULL ||
-      strcmp(lastUsed_chromVcf->name, chromName) != 0) {
-    lastUsed_chromVcf = gv->chroms;
-    while (lastUsed_chromVcf != NULL) {
-      if (strcmp(lastUsed_chromVcf->name, chromName) == 0) {
-        break;
-      } else {
-        lastUsed_chromVcf = lastUsed_chromVcf->next;
-      }
-    }
-  }
-  if (lastUsed_chromVcf == NULL) {
-    // Possibly there is no requested chrom in genomeVcf
-    return NULL;
-  }
-  // Locate and find record(s)
-  VcfBPlusTree *bptree = lastUsed_chromVcf->tree;
-  */
+  // Locate the chromosome of vcf records. The dictionary is only read here, so
+  // it's safe for multi-thread programs.
+  int32_t id = contigDict_id(gv->contigs, chromName);
+  return chromVcf_bplus_getRecAfterPos(
+      genomeVcf_bplus_getChromByContig(gv, id), pos);
+}
 
-  ChromVcf_bplus *cf = gv->chroms;
-  while (cf != NULL) {
-    if (strcmp(cf->name, chromName) == 0) {
-      break;
-    } else {
-      cf = cf->next;
-    }
-  }
-  if (cf == NULL) {
-    return NULL;
+/**
+ * @brief  Search the first record with POS >= pos in a static index.
+ */
+static inline RecVcf_bplus *staticIndexVcf_getRecAfterPos(
+    const StaticIndexVcf *si, int64_t pos) {
+  const VcfBPlusKey *keys = si->keys;
+  int64_t k = 1;
+  while (k <= si->cnt_key) {
+    // Keys of the next 3 levels below k share a cache line
+    __builtin_prefetch(keys + k * 8);
+    k = 2 * k + (keys[k] < pos);
   }
-  VcfBPlusTree *bptree = cf->tree;
+  // Go back to the last node where the search turned left
+  k >>= __builtin_ffsll(~k);
+  return k == 0 ? NULL : si->heads[k];
+}
 
+/**
+ * @brief  Locate the first key >= pos in leaves of the tree.
+ * @retval the leaf, with the index of the key in *ret_idx; NULL if there is no
+ * key >= pos
+ */
+static VcfBPlusNode *vcfbplus_tree_locateLeaf(VcfBPlusTree *bptree,
+                                              int64_t pos, int *ret_idx) {
   VcfBPlusNode *bpnode = bptree->root;
 
   int ret_pointerIdx = -1;
@@ -947,129 +1431,1428 @@ RecVcf_bplus *genomeVcf_bplus_getRecAfterPos(GenomeVcf_bplus *gv,
     }
     vcfbplus_node_locate(pos, bpnode, &ret_pointerIdx);
   }
-  return (RecVcf_bplus *)bpnode->pointers[ret_pointerIdx];
+  *ret_idx = ret_pointerIdx;
+  return bpnode;
 }
 
-void genomeVcf_bplus_synchronize(GenomeVcf_bplus *gv) {
-  ChromVcf_bplus *cv = gv->chroms;
-  while (cv != NULL) {
-    VcfBPlusNode *node = cv->tree->first;  // start from the first node
-    // Synchronize all nodes in the chromosome
-    while (node != NULL) {
-      assert(node->isLeaf == true);
-      // Synchronize all arrays in the node
-      for (int i = 0; i < node->cnt_key; i++) {
-        RecVcf_bplus *rv = (RecVcf_bplus *)node->pointers[i];
-        // Synchronize all records in the element (linked-list)
-        while (rv != NULL) {
-          rv->bpnode = node;
-          rv = rv->next;
-        }
-      }
-      node = node->right;
-    }
-    cv = cv->next;
+RecVcf_bplus *chromVcf_bplus_getRecAfterPos(ChromVcf_bplus *cv, int64_t pos) {
+  assert(pos >= 1);
+  if (cv == NULL) {
+    return NULL;
   }
+  if (cv->index != NULL) return staticIndexVcf_getRecAfterPos(cv->index, pos);
+  int idx = 0;
+  VcfBPlusNode *leaf = vcfbplus_tree_locateLeaf(cv->tree, pos, &idx);
+  return leaf == NULL ? NULL : (RecVcf_bplus *)leaf->pointers[idx];
 }
 
-GenomeVcf_bplus *genomeVcf_bplus_loadFile(char *filePath, int rank_inner_node,
-                                          int rank_leaf_node) {
-  htsFile *fp = hts_open(filePath, "r");
-  bcf_hdr_t *hdr = bcf_hdr_read(fp);
-  bcf1_t *rec = bcf_init1();
-
-  if (hdr == NULL) {
-    fprintf(stderr, "Error: failed creating bcf header struct.\n");
-    exit(EXIT_FAILURE);
-  }
-  if (rec == NULL) {
-    fprintf(stderr, "Error: memory not enough for new bcf1_t object.\n");
-    exit(EXIT_FAILURE);
-  }
-
-  GenomeVcf_bplus *gv =
-      init_GenomeVcf_bplus(rank_inner_node, rank_leaf_node, hdr);
-  uint32_t loadedCnt = 0;
-  while (bcf_read1(fp, hdr, rec) >= 0) {
-    // The "bcf_unpack" method must be called for every new bcf1_t object
-    bcf_unpack(rec, BCF_UN_ALL);
-    bcf1_t *tmpRec = bcf_dup(rec);
-    bcf_unpack(tmpRec, BCF_UN_ALL);
-
-    RecVcf_bplus *rv = init_RecVcf_bplus(tmpRec, NULL);
-    bcf_destroy1(tmpRec);
-
-    // Ignore those variants with tags or with empty ALT fields
-    if (rv_alleleCnt(rv) == 1) {
-      continue;
-    } else {
-      const char *vcf_ALT = rv_allele(rv, 1);
-      if (vcf_ALT[0] == '<') {
-        continue;
-      }
+CursorVcf chromVcf_bplus_range(ChromVcf_bplus *cv, int64_t begin,
+                               int64_t end) {
+  CursorVcf cursor = {NULL, NULL, 0, end};
+  if (cv == NULL) return cursor;
+  if (begin < 1) begin = 1;
+  if (cv->index != NULL) {
+    cursor.rv = staticIndexVcf_getRecAfterPos(cv->index, begin);
+  } else {
+    cursor.leaf = vcfbplus_tree_locateLeaf(cv->tree, begin, &cursor.idx);
+    if (cursor.leaf != NULL) {
+      cursor.rv = (RecVcf_bplus *)cursor.leaf->pointers[cursor.idx];
     }
-
-    genomeVcf_bplus_insertRec(gv, rv);
-
-    // Debug lines: used for checking the correctness of the bplus tree
-    // vcfbplus_tree_print(gv->chroms->tree);
-
-    // genomeVcf_bplus_printRec(gv, rv);
-    loadedCnt++;
   }
-
-  genomeVcf_bplus_synchronize(gv);
-
-  bcf_hdr_destroy(hdr);
-  return gv;
+  if (cursor.rv != NULL && rv_pos(cursor.rv) >= end) cursor.rv = NULL;
+  return cursor;
 }
 
-void genomeVcf_bplus_writeFile(GenomeVcf_bplus *gv, char *filePath) {
-  fprintf(stderr, "Error: this method is unnecessary to implement.\n");
-  exit(EXIT_FAILURE);
+CursorVcf chromVcf_bplus_cursor(ChromVcf_bplus *cv, int64_t pos) {
+  return chromVcf_bplus_range(cv, pos, INT64_MAX);
 }
 
-/**********************************
- * Accessing data within structures
- **********************************/
-
-inline int gv_cnt_rec(GenomeVcf_bplus *gv) {
-  int cnt_rec = 0;
-  ChromVcf_bplus *cv = gv->chroms;
-  while (cv != NULL) {
-    cnt_rec = cnt_rec + cv->cnt_rec;
-    cv = cv->next;
-  }
-  return cnt_rec;
+CursorVcf genomeVcf_bplus_range(GenomeVcf_bplus *gv, const char *chromName,
+                                int64_t begin, int64_t end) {
+  int32_t id = contigDict_id(gv->contigs, chromName);
+  return chromVcf_bplus_range(genomeVcf_bplus_getChromByContig(gv, id), begin,
+                              end);
 }
 
-inline bcf1_t *rv_object(RecVcf_bplus *rv) {
-  assert(rv->data != NULL);
-  return rv->data;
+RecVcf_bplus *cursorVcf_next(CursorVcf *cursor) {
+  RecVcf_bplus *rv = cursor->rv;
+  if (rv == NULL) return NULL;
+  if (rv->next != NULL || cursor->leaf == NULL) {
+    // Records with the same POS are linked, and so are all records of a
+    // static index
+    rv = rv->next;
+  } else {
+    // Heads of records are kept one after another in the leaves
+    VcfBPlusNode *leaf = cursor->leaf;
+    if (++cursor->idx == leaf->cnt_key) {
+      leaf = cursor->leaf = leaf->right;
+      cursor->idx = 0;
+    }
+    rv = leaf == NULL ? NULL : (RecVcf_bplus *)leaf->pointers[cursor->idx];
+  }
+  if (rv != NULL && rv_pos(rv) >= cursor->end) rv = NULL;
+  cursor->rv = rv;
+  return rv;
 }
 
-const char *rv_ID(RecVcf_bplus *rv) { return rv->data->d.id; }
-
-inline int64_t rv_pos(RecVcf_bplus *rv) {
-  assert(rv->data != NULL);
-  return rv->data->pos + 1;
+/**
+ * @brief  Fill keys of a static index in Eytzinger order with sorted keys.
+ * Keys mapped from an index file are already filled, and only heads are.
+ * @param  idx_sorted: index of the next sorted key to fill
+ * @param  k: node of the complete binary tree to fill
+ * @retval index of the next sorted key to fill after the sub-tree of node k
+ */
+static int64_t staticIndexVcf_fill(StaticIndexVcf *si,
+                                   RecVcf_bplus **heads_sorted,
+                                   int64_t idx_sorted, int64_t k) {
+  if (k > si->cnt_key) return idx_sorted;
+  idx_sorted = staticIndexVcf_fill(si, heads_sorted, idx_sorted, 2 * k);
+  si->heads[k] = heads_sorted[idx_sorted];
+  if (si->ifMapped == false) si->keys[k] = rv_pos(heads_sorted[idx_sorted]);
+  idx_sorted++;
+  return staticIndexVcf_fill(si, heads_sorted, idx_sorted, 2 * k + 1);
+}
+
+/**
+ * @brief  Replace the bplus tree of a chromosome with a static index.
+ */
+static void chromVcf_bplus_freeze(ChromVcf_bplus *cv) {
+  chromVcf_bplus_build(cv);
+  VcfBPlusTree *bptree = cv->tree;
+  StaticIndexVcf *si = (StaticIndexVcf *)calloc(1, sizeof(StaticIndexVcf));
+  for (VcfBPlusNode *bpnode = bptree->first; bpnode != NULL;
+       bpnode = bpnode->right) {
+    si->cnt_key += bpnode->cnt_key;
+  }
+  // Heads of records in order of POS, and records linked one after another
+  RecVcf_bplus **heads_sorted =
+      (RecVcf_bplus **)malloc((si->cnt_key + 1) * sizeof(RecVcf_bplus *));
+  si->heads =
+      (RecVcf_bplus **)malloc((si->cnt_key + 1) * sizeof(RecVcf_bplus *));
+  if (heads_sorted == NULL || si->heads == NULL ||
+      posix_memalign((void **)&si->keys, SIZE_CACHE_LINE,
+                     (si->cnt_key + 1) * sizeof(VcfBPlusKey)) != 0) {
+    fprintf(stderr, "Error: memory not enough for static vcf index.\n");
+    exit(EXIT_FAILURE);
+  }
+  int64_t cnt_head = 0;
+  RecVcf_bplus *rv_tail = NULL;
+  for (VcfBPlusNode *bpnode = bptree->first; bpnode != NULL;
+       bpnode = bpnode->right) {
+    for (int i = 0; i < bpnode->cnt_key; i++) {
+      RecVcf_bplus *rv = (RecVcf_bplus *)bpnode->pointers[i];
+      heads_sorted[cnt_head++] = rv;
+      if (rv_tail != NULL) rv_tail->next = rv;
+      for (; rv != NULL; rv = rv->next) rv_tail = rv;
+      // Records are now kept by the static index
+      bpnode->pointers[i] = NULL;
+    }
+    bpnode->cnt_key = 0;
+  }
+  si->keys[0] = unavailable_keyValue;
+  si->heads[0] = NULL;
+  staticIndexVcf_fill(si, heads_sorted, 0, 1);
+  free(heads_sorted);
+  destroy_VcfBPlusTree(bptree);
+  cv->tree = NULL;
+  cv->index = si;
+}
+
+void genomeVcf_bplus_freeze(GenomeVcf_bplus *gv) {
+  for (ChromVcf_bplus *cv = gv->chroms; cv != NULL; cv = cv->next) {
+    if (cv->index == NULL) chromVcf_bplus_freeze(cv);
+  }
+}
+
+/**
+ * @brief  Build the overlap index of a chromosome with its records.
+ */
+static void chromVcf_bplus_indexOverlaps(ChromVcf_bplus *cv) {
+  chromVcf_bplus_build(cv);
+  OverlapIndexVcf *oi = (OverlapIndexVcf *)calloc(1, sizeof(OverlapIndexVcf));
+  oi->areas = (AreaVcf *)malloc((cv->cnt_rec + 1) * sizeof(AreaVcf));
+  if (oi->areas == NULL) {
+    fprintf(stderr, "Error: memory not enough for overlap index of vcf.\n");
+    exit(EXIT_FAILURE);
+  }
+  // Records are iterated in order of POS, so areas are sorted by start
+  CursorVcf cursor = chromVcf_bplus_cursor(cv, 1);
+  for (RecVcf_bplus *rv = cursor.rv; rv != NULL; rv = cursorVcf_next(&cursor)) {
+    AreaVcf *area = oi->areas + oi->cnt_area++;
+    area->start = rv_pos(rv);
+    area->end = rv_end(rv);
+    area->max_end = area->end;
+    area->rv = rv;
+  }
+  // Max ends of sub-trees, level by level. Nodes beyond the array have no
+  // areas, and their max ends are those of their children within the array.
+  int64_t cnt_area = oi->cnt_area;
+  AreaVcf *areas = oi->areas;
+  int64_t idx_last = (cnt_area - 1) & ~(int64_t)1;  // last area on level 0
+  int64_t max_end_last = cnt_area > 0 ? areas[idx_last].max_end : 0;
+  int k = 1;
+  for (; ((int64_t)1 << k) <= cnt_area; k++) {
+    int64_t x = (int64_t)1 << (k - 1);
+    for (int64_t i = (x << 1) - 1; i < cnt_area; i += x << 2) {
+      int64_t max_end_left = areas[i - x].max_end;
+      int64_t max_end_right =
+          i + x < cnt_area ? areas[i + x].max_end : max_end_last;
+      if (max_end_left > areas[i].max_end) areas[i].max_end = max_end_left;
+      if (max_end_right > areas[i].max_end) areas[i].max_end = max_end_right;
+    }
+    // Move to the ancestor of the last area on level k
+    idx_last = (idx_last >> k & 1) ? idx_last - x : idx_last + x;
+    if (idx_last < cnt_area && areas[idx_last].max_end > max_end_last) {
+      max_end_last = areas[idx_last].max_end;
+    }
+  }
+  oi->level_root = k - 1;
+  destroy_OverlapIndexVcf(cv->overlaps);
+  cv->overlaps = oi;
+}
+
+void genomeVcf_bplus_indexOverlaps(GenomeVcf_bplus *gv) {
+  for (ChromVcf_bplus *cv = gv->chroms; cv != NULL; cv = cv->next) {
+    if (cv->overlaps == NULL) chromVcf_bplus_indexOverlaps(cv);
+  }
+}
+
+/**
+ * @brief  Append a record to a buffer of records, which is enlarged if full.
+ */
+static inline void bufferRecs_append(RecVcf_bplus *rv, RecVcf_bplus ***rvs,
+                                     int64_t *capacity, int64_t *cnt_rv) {
+  if (*cnt_rv == *capacity) {
+    *capacity = *capacity > 0 ? *capacity * 2 : 16;
+    *rvs = (RecVcf_bplus **)realloc(*rvs, *capacity * sizeof(RecVcf_bplus *));
+  }
+  (*rvs)[(*cnt_rv)++] = rv;
+}
+
+int64_t chromVcf_bplus_getRecsOverlap(ChromVcf_bplus *cv, int64_t lbound,
+                                      int64_t rbound, RecVcf_bplus ***ret_rvs,
+                                      int64_t *ret_capacity) {
+  if (cv == NULL || lbound > rbound) return 0;
+  const OverlapIndexVcf *oi = cv->overlaps;
+  if (oi == NULL) {
+    fprintf(stderr, "Error: overlaps of records of chrom %s are not indexed\n",
+            cv->name);
+    exit(EXIT_FAILURE);
+  }
+  const AreaVcf *areas = oi->areas;
+  int64_t cnt_rv = 0;
+  // Sub-trees to visit. Each node is visited twice, before and after its left
+  // sub-tree, so that records are found in order of POS.
+  struct {
+    int64_t idx;
+    int level;
+    bool if_visited;
+  } stack[64];
+  int cnt_stack = 0;
+  if (oi->cnt_area > 0) {
+    stack[0].idx = ((int64_t)1 << oi->level_root) - 1;
+    stack[0].level = oi->level_root;
+    stack[0].if_visited = false;
+    cnt_stack = 1;
+  }
+  while (cnt_stack > 0) {
+    cnt_stack--;
+    int64_t idx = stack[cnt_stack].idx;
+    int level = stack[cnt_stack].level;
+    if (level <= 2) {
+      // Small sub-tree. Scan its areas one by one.
+      int64_t i = idx >> level << level;
+      int64_t i_end = i + ((int64_t)1 << (level + 1)) - 1;
+      if (i_end > oi->cnt_area) i_end = oi->cnt_area;
+      for (; i < i_end && areas[i].start <= rbound; i++) {
+        if (areas[i].end >= lbound) {
+          bufferRecs_append(areas[i].rv, ret_rvs, ret_capacity, &cnt_rv);
+        }
+      }
+      continue;
+    }
+    int64_t x = (int64_t)1 << (level - 1);
+    if (stack[cnt_stack].if_visited == false) {
+      // Visit the left sub-tree first, if any of its areas reaches lbound
+      stack[cnt_stack++].if_visited = true;
+      if (idx - x >= oi->cnt_area || areas[idx - x].max_end >= lbound) {
+        stack[cnt_stack].idx = idx - x;
+        stack[cnt_stack].level = level - 1;
+        stack[cnt_stack++].if_visited = false;
+      }
+    } else if (idx < oi->cnt_area && areas[idx].start <= rbound) {
+      if (areas[idx].end >= lbound) {
+        bufferRecs_append(areas[idx].rv, ret_rvs, ret_capacity, &cnt_rv);
+      }
+      // Areas of the right sub-tree start after this one
+      stack[cnt_stack].idx = idx + x;
+      stack[cnt_stack].level = level - 1;
+      stack[cnt_stack++].if_visited = false;
+    }
+  }
+  return cnt_rv;
+}
+
+/*
+ * Layout of the index file (native byte order):
+ *  IndexHeaderVcf
+ *  IndexChromVcf[cnt_chrom]
+ *  path of the vcf file and names of chroms ('\0' terminated)
+ *  keys of static indexes of all chroms (each array aligned to a cache line)
+ *  IndexRecVcf[cnt_rec] (records of each chrom in order of POS)
+ *  strings of all records (see CompactRecVcf)
+ */
+typedef struct _define_IndexHeaderVcf {
+  char magic[8];
+  uint32_t version;
+  uint32_t cnt_chrom;
+  uint64_t size_file;        // used to detect truncated files
+  uint64_t size_source;      // size of the vcf file
+  uint64_t checksum_source;  // see checksumFileVcf
+  uint64_t offset_path;      // path of the vcf file
+  uint64_t offset_recs;
+  uint64_t cnt_rec;
+} IndexHeaderVcf;
+
+typedef struct _define_IndexChromVcf {
+  uint64_t offset_name;
+  uint64_t offset_keys;  // keys[0..cnt_key] of the static index
+  int64_t cnt_key;
+  uint64_t idx_rec;  // index of the first record of the chrom
+  uint64_t cnt_rec;
+} IndexChromVcf;
+
+typedef struct _define_IndexRecVcf {
+  int64_t pos;
+  int64_t offset_file;  // offset of the record in the vcf file; -1 if unknown
+  uint64_t offset_strs;
+  uint16_t n_allele;
+  uint16_t padding[3];
+} IndexRecVcf;
+
+static const char indexMagicVcf[8] = {'G', 'R', 'B', 'V', 'G', 'V', 'I', '\0'};
+
+#define SIZE_BLOCK_CHECKSUMVCF (1 << 20)
+
+/**
+ * @brief  Hash bytes into the hash (FNV-1a, taking 8 bytes at a time). Each
+ * step is a bijection of the hash, so a single changed word always changes the
+ * result.
+ */
+static uint64_t hashBytesVcf(uint64_t hash, const void *bytes, size_t size) {
+  const unsigned char *p = (const unsigned char *)bytes;
+  size_t cnt_word = size / 8;
+  for (size_t i = 0; i < cnt_word; i++) {
+    uint64_t word = 0;
+    memcpy(&word, p + i * 8, 8);
+    hash = (hash ^ word) * 1099511628211ULL;
+  }
+  for (size_t i = cnt_word * 8; i < size; i++) {
+    hash = (hash ^ p[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * @brief  Checksum of the whole content of a vcf file, used to check whether
+ * an index file is built from the file as it is now. Copies of the file share
+ * the checksum, while any edit changes it. The file is read through, which is
+ * still much faster than parsing it.
+ * @retval false if the file cannot be read
+ */
+static bool checksumFileVcf(const char *filePath, uint64_t *ret_size,
+                            uint64_t *ret_checksum) {
+  FILE *fp = fopen(filePath, "rb");
+  if (fp == NULL) return false;
+  struct stat stat_file;
+  if (fstat(fileno(fp), &stat_file) != 0) {
+    fclose(fp);
+    return false;
+  }
+  uint64_t size = stat_file.st_size;
+  uint64_t checksum = 14695981039346656037ULL;
+  checksum = hashBytesVcf(checksum, &size, sizeof(size));
+  unsigned char *buf = (unsigned char *)malloc(SIZE_BLOCK_CHECKSUMVCF);
+  if (buf == NULL) {
+    fprintf(stderr, "Error: memory not enough for checksum of vcf file.\n");
+    exit(EXIT_FAILURE);
+  }
+  uint64_t size_total = 0;
+  size_t size_read = 0;
+  while ((size_read = fread(buf, 1, SIZE_BLOCK_CHECKSUMVCF, fp)) > 0) {
+    checksum = hashBytesVcf(checksum, buf, size_read);
+    size_total += size_read;
+  }
+  free(buf);
+  bool ifRead = ferror(fp) == 0 && size_total == size;
+  fclose(fp);
+  if (ifRead == false) return false;
+  *ret_size = size;
+  *ret_checksum = checksum;
+  return true;
+}
+
+/**
+ * @brief  Check whether the file begins with the magic of an index file. Only
+ * regular files are checked, so that nothing is consumed from pipes.
+ */
+static bool ifIndexFileVcf(const char *filePath) {
+  struct stat stat_file;
+  if (stat(filePath, &stat_file) != 0 || S_ISREG(stat_file.st_mode) == false) {
+    return false;
+  }
+  FILE *fp = fopen(filePath, "rb");
+  if (fp == NULL) return false;
+  char magic[sizeof(indexMagicVcf)];
+  bool ifIndex = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+                 memcmp(magic, indexMagicVcf, sizeof(indexMagicVcf)) == 0;
+  fclose(fp);
+  return ifIndex;
+}
+
+/**
+ * @brief  Check whether "*.vcf" + GENOMEVCF_INDEX_SUFFIX exists, is of the
+ * current version and is built from the vcf file as it is now.
+ */
+static bool ifFreshIndexVcf(const char *filePath, const char *indexPath) {
+  if (ifIndexFileVcf(indexPath) == false) return false;
+  FILE *fp = fopen(indexPath, "rb");
+  if (fp == NULL) return false;
+  IndexHeaderVcf header;
+  bool ifRead = fread(&header, sizeof(IndexHeaderVcf), 1, fp) == 1;
+  fclose(fp);
+  uint64_t size_source = 0;
+  uint64_t checksum_source = 0;
+  if (ifRead == false || header.version != GENOMEVCF_INDEX_VERSION ||
+      checksumFileVcf(filePath, &size_source, &checksum_source) == false) {
+    return false;
+  }
+  if (header.size_source != size_source ||
+      header.checksum_source != checksum_source) {
+    fprintf(stderr,
+            "Warning: %s is not built from the current %s and is ignored. "
+            "Please rebuild it with buildVcfIndex.\n",
+            indexPath, filePath);
+    return false;
+  }
+  return true;
+}
+
+static inline uint64_t alignToVcf(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * @brief  Get the size of strings of a record kept in the index file.
+ */
+static uint64_t sizeStrsVcf(RecVcf_bplus *rv) {
+  uint64_t size = rv_alleleCnt(rv) + strlen(rv_ID(rv)) + 1;
+  for (int i = 0; i < rv_alleleCnt(rv); i++) {
+    size += strlen(rv_allele(rv, i)) + 1;
+  }
+  return size;
+}
+
+void genomeVcf_bplus_writeFile(GenomeVcf_bplus *gv, char *filePath) {
+  IndexHeaderVcf header;
+  memset(&header, 0, sizeof(IndexHeaderVcf));
+  memcpy(header.magic, indexMagicVcf, sizeof(indexMagicVcf));
+  header.version = GENOMEVCF_INDEX_VERSION;
+  header.cnt_chrom = gv->cnt_chrom;
+  if (gv->filePath == NULL ||
+      checksumFileVcf(gv->filePath, &header.size_source,
+                      &header.checksum_source) == false) {
+    fprintf(stderr, "Error: failed to read the vcf file of the genome - %s\n",
+            gv->filePath == NULL ? "(null)" : gv->filePath);
+    exit(EXIT_FAILURE);
+  }
+  // The absolute path is kept, so that the vcf file is found from any working
+  // directory when the index file is loaded directly
+  char *sourcePath = realpath(gv->filePath, NULL);
+  if (sourcePath == NULL) {
+    fprintf(stderr, "Error: failed to read the vcf file of the genome - %s\n",
+            gv->filePath);
+    exit(EXIT_FAILURE);
+  }
+  // The keys written are those of static indexes
+  genomeVcf_bplus_freeze(gv);
+
+  // Calculate offsets of names, keys, records and strings
+  IndexChromVcf *table =
+      (IndexChromVcf *)calloc(gv->cnt_chrom + 1, sizeof(IndexChromVcf));
+  uint64_t offset =
+      sizeof(IndexHeaderVcf) + gv->cnt_chrom * sizeof(IndexChromVcf);
+  header.offset_path = offset;
+  offset += strlen(sourcePath) + 1;
+  ChromVcf_bplus *cv = gv->chroms;
+  for (uint32_t i = 0; cv != NULL; i++, cv = cv->next) {
+    table[i].offset_name = offset;
+    offset += strlen(cv->name) + 1;
+  }
+  cv = gv->chroms;
+  for (uint32_t i = 0; cv != NULL; i++, cv = cv->next) {
+    offset = alignToVcf(offset, SIZE_CACHE_LINE);
+    table[i].offset_keys = offset;
+    table[i].cnt_key = cv->index->cnt_key;
+    table[i].idx_rec = header.cnt_rec;
+    table[i].cnt_rec = cv->cnt_rec;
+    header.cnt_rec += cv->cnt_rec;
+    offset += (cv->index->cnt_key + 1) * sizeof(VcfBPlusKey);
+  }
+  offset = alignToVcf(offset, 8);
+  header.offset_recs = offset;
+  offset += header.cnt_rec * sizeof(IndexRecVcf);
+  uint64_t offset_strs = offset;
+  for (cv = gv->chroms; cv != NULL; cv = cv->next) {
+    CursorVcf cursor = chromVcf_bplus_cursor(cv, 1);
+    for (; cursor.rv != NULL; cursorVcf_next(&cursor)) {
+      offset += sizeStrsVcf(cursor.rv);
+    }
+  }
+  header.size_file = offset;
+
+  // Processes that mapped the old index file keep using it until they exit.
+  // Writing into it directly would break them, so write a new file and then
+  // replace the old one.
+  char tmpPath[strlen(filePath) + 8];
+  sprintf(tmpPath, "%s.tmp", filePath);
+  FILE *fp = fopen(tmpPath, "wb");
+  if (fp == NULL) {
+    fprintf(stderr, "Error: failed to open file - %s\n", tmpPath);
+    exit(EXIT_FAILURE);
+  }
+  static const char padding[SIZE_CACHE_LINE] = {0};
+  fwrite(&header, sizeof(IndexHeaderVcf), 1, fp);
+  fwrite(table, sizeof(IndexChromVcf), gv->cnt_chrom, fp);
+  fwrite(sourcePath, 1, strlen(sourcePath) + 1, fp);
+  for (cv = gv->chroms; cv != NULL; cv = cv->next) {
+    fwrite(cv->name, 1, strlen(cv->name) + 1, fp);
+  }
+  cv = gv->chroms;
+  for (uint32_t i = 0; cv != NULL; i++, cv = cv->next) {
+    fwrite(padding, 1, table[i].offset_keys - ftell(fp), fp);
+    fwrite(cv->index->keys, sizeof(VcfBPlusKey), cv->index->cnt_key + 1, fp);
+  }
+  fwrite(padding, 1, header.offset_recs - ftell(fp), fp);
+  IndexRecVcf rec_index;
+  memset(&rec_index, 0, sizeof(IndexRecVcf));
+  rec_index.offset_strs = offset_strs;
+  for (cv = gv->chroms; cv != NULL; cv = cv->next) {
+    CursorVcf cursor = chromVcf_bplus_cursor(cv, 1);
+    for (RecVcf_bplus *rv = cursor.rv; rv != NULL;
+         rv = cursorVcf_next(&cursor)) {
+      rec_index.pos = rv_pos(rv);
+      rec_index.offset_file =
+          rv->data == NULL ? ((CompactRecVcf *)rv)->offset_file : -1;
+      rec_index.n_allele = rv_alleleCnt(rv);
+      fwrite(&rec_index, sizeof(IndexRecVcf), 1, fp);
+      rec_index.offset_strs += sizeStrsVcf(rv);
+    }
+  }
+  for (cv = gv->chroms; cv != NULL; cv = cv->next) {
+    CursorVcf cursor = chromVcf_bplus_cursor(cv, 1);
+    for (RecVcf_bplus *rv = cursor.rv; rv != NULL;
+         rv = cursorVcf_next(&cursor)) {
+      for (int i = 0; i < rv_alleleCnt(rv); i++) {
+        fputc((uint8_t)rv_alleleType(rv, i), fp);
+      }
+      fwrite(rv_ID(rv), 1, strlen(rv_ID(rv)) + 1, fp);
+      for (int i = 0; i < rv_alleleCnt(rv); i++) {
+        fwrite(rv_allele(rv, i), 1, strlen(rv_allele(rv, i)) + 1, fp);
+      }
+    }
+  }
+  if (ftell(fp) != (long)header.size_file) {
+    fprintf(stderr, "Error: failed writing index file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+  free(table);
+  free(sourcePath);
+  if (fclose(fp) != 0 || rename(tmpPath, filePath) != 0) {
+    fprintf(stderr, "Error: failed writing index file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * @brief  Load a genomeVcf object from an index file.
+ * @param  *sourcePath: path of the vcf file the index is built from; NULL to
+ * use the path kept in the index file
+ */
+static GenomeVcf_bplus *loadIndexFileVcf(const char *filePath,
+                                         const char *sourcePath) {
+  int fd = open(filePath, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Error: failed to open file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+  struct stat stat_index;
+  if (fstat(fd, &stat_index) != 0 ||
+      stat_index.st_size < (off_t)sizeof(IndexHeaderVcf)) {
+    fprintf(stderr, "Error: invalid index file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+  size_t size_file = stat_index.st_size;
+  void *mapped = mmap(NULL, size_file, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    fprintf(stderr, "Error: failed to map file - %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+
+  const char *base = (const char *)mapped;
+  const IndexHeaderVcf *header = (const IndexHeaderVcf *)base;
+  if (memcmp(header->magic, indexMagicVcf, sizeof(indexMagicVcf)) != 0 ||
+      header->version != GENOMEVCF_INDEX_VERSION ||
+      header->size_file != size_file) {
+    fprintf(stderr,
+            "Error: index file %s is invalid, truncated or of another version. "
+            "Please rebuild it with buildVcfIndex.\n",
+            filePath);
+    exit(EXIT_FAILURE);
+  }
+  // The header of the vcf file is read again from the vcf file itself
+  if (sourcePath == NULL) sourcePath = base + header->offset_path;
+  uint64_t size_source = 0;
+  uint64_t checksum_source = 0;
+  if (checksumFileVcf(sourcePath, &size_source, &checksum_source) == false ||
+      header->size_source != size_source ||
+      header->checksum_source != checksum_source) {
+    fprintf(stderr,
+            "Error: index file %s is not built from the current %s. Please "
+            "rebuild it with buildVcfIndex.\n",
+            filePath, sourcePath);
+    exit(EXIT_FAILURE);
+  }
+  htsFile *fp = hts_open(sourcePath, "r");
+  bcf_hdr_t *hdr = fp == NULL ? NULL : bcf_hdr_read(fp);
+  if (hdr == NULL) {
+    fprintf(stderr, "Error: failed reading header of vcf file %s\n",
+            sourcePath);
+    exit(EXIT_FAILURE);
+  }
+  GenomeVcf_bplus *gv = init_GenomeVcf_bplus(RANK_INNER_NODE_DEFAULT,
+                                             RANK_LEAF_NODE_DEFAULT, hdr);
+  bcf_hdr_destroy(hdr);
+  hts_close(fp);
+  gv->filePath = strdup(sourcePath);
+  gv->arena_rec = init_ArenaVcf();
+  gv->mappedIndex = mapped;
+  gv->size_mappedIndex = size_file;
+
+  // Records and static indexes of chroms, with keys and strings in the mapped
+  // file. Only objects with pointers are created.
+  const IndexChromVcf *table =
+      (const IndexChromVcf *)(base + sizeof(IndexHeaderVcf));
+  const IndexRecVcf *recs_index =
+      (const IndexRecVcf *)(base + header->offset_recs);
+  for (uint32_t i = 0; i < header->cnt_chrom; i++) {
+    int32_t rid = contigDict_add(gv->contigs, base + table[i].offset_name);
+    ChromVcf_bplus *cv = genomeVcf_bplus_chromOfContig(gv, rid);
+    destroy_VcfBPlusTree(cv->tree);
+    cv->tree = NULL;
+    cv->cnt_rec = table[i].cnt_rec;
+    CompactRecVcf *crvs = (CompactRecVcf *)arenaVcf_alloc(
+        table[i].cnt_rec * sizeof(CompactRecVcf), gv->arena_rec);
+    StaticIndexVcf *si = (StaticIndexVcf *)calloc(1, sizeof(StaticIndexVcf));
+    si->cnt_key = table[i].cnt_key;
+    si->keys = (VcfBPlusKey *)(base + table[i].offset_keys);
+    si->ifMapped = true;
+    si->heads =
+        (RecVcf_bplus **)malloc((si->cnt_key + 1) * sizeof(RecVcf_bplus *));
+    RecVcf_bplus **heads_sorted =
+        (RecVcf_bplus **)malloc((si->cnt_key + 1) * sizeof(RecVcf_bplus *));
+    if (heads_sorted == NULL || si->heads == NULL) {
+      fprintf(stderr, "Error: memory not enough for static vcf index.\n");
+      exit(EXIT_FAILURE);
+    }
+    int64_t cnt_head = 0;
+    for (uint64_t j = 0; j < table[i].cnt_rec; j++) {
+      const IndexRecVcf *rec_index = recs_index + table[i].idx_rec + j;
+      CompactRecVcf *crv = crvs + j;
+      crv->rv.data = NULL;
+      crv->rv.next = j + 1 < table[i].cnt_rec ? &crvs[j + 1].rv : NULL;
+      crv->pos = rec_index->pos;
+      crv->offset_file = rec_index->offset_file;
+      crv->strs = (uint8_t *)(base + rec_index->offset_strs);
+      crv->rid = rid;
+      crv->n_allele = rec_index->n_allele;
+      // Infos are not kept in the file, as they are cheap to compute
+      crv->rv.infos = (AlleleInfoVcf *)arenaVcf_alloc(
+          crv->n_allele * sizeof(AlleleInfoVcf), gv->arena_rec);
+      const char *str = (const char *)(crv->strs + crv->n_allele);
+      str += strlen(str) + 1;  // ID
+      int32_t length_ref = strlen(str);
+      for (int k = 0; k < crv->n_allele; k++) {
+        int32_t length = strlen(str);
+        setAlleleInfoVcf(crv->rv.infos + k, length, length_ref, crv->strs[k],
+                         (int32_t)((const uint8_t *)str - crv->strs));
+        str += length + 1;
+      }
+      if (j == 0 || crvs[j - 1].pos != crv->pos) {
+        heads_sorted[cnt_head++] = &crv->rv;
+      }
+    }
+    assert(cnt_head == si->cnt_key);
+    si->heads[0] = NULL;
+    staticIndexVcf_fill(si, heads_sorted, 0, 1);
+    free(heads_sorted);
+    cv->index = si;
+  }
+  return gv;
+}
+
+GenomeVcf_bplus *genomeVcf_bplus_loadIndexFile(const char *filePath) {
+  return loadIndexFileVcf(filePath, NULL);
+}
+
+/**
+ * @brief  Check whether a record read from a vcf file should be kept. Records
+ * with tags or with empty ALT fields are ignored.
+ */
+static bool ifKeepRecVcf(bcf1_t *rec) {
+  // Only alleles are needed for filtering. The copy kept in the tree is
+  // fully unpacked by init_RecVcf_bplus.
+  bcf_unpack(rec, BCF_UN_STR);
+  if (rec->n_allele == 1) return false;
+  const char *vcf_ALT = rec->d.allele[1];
+  return vcf_ALT[0] != '<';
+}
+
+/**
+ * @brief  Keep a record read from a vcf file in the genome, unless it has tags
+ * or an empty ALT field.
+ * @param  offset_rec: offset of the record in the vcf file; -1 if unknown
+ */
+static void loadRecVcf(GenomeVcf_bplus *gv, bcf_hdr_t *hdr, bcf1_t *rec,
+                       int64_t offset_rec, bool ifCompact) {
+  if (ifKeepRecVcf(rec) == false) return;
+
+  // Contigs missing in the header of gv are added to the dictionary here with
+  // the header of the file, where they are added while parsing.
+  int32_t rid = rec->rid;
+  if (rid < 0 || rid >= contigDict_cnt(gv->contigs)) {
+    rid = contigDict_add(gv->contigs, bcf_seqname_safe(hdr, rec));
+  }
+  RecVcf_bplus *rv = NULL;
+  if (ifCompact) {
+    rv = init_CompactRecVcf(rec, rid, offset_rec, gv->arena_rec,
+                            gv->pool_str);
+  } else {
+    rv = init_RecVcf_bplus(rec, NULL);
+  }
+  // Records of a vcf file are sorted, and thus are appended to their trees
+  chromVcf_bplus_appendRec(genomeVcf_bplus_chromOfContig(gv, rid), rv);
+
+  // Debug lines: used for checking the correctness of the bplus tree
+  // vcfbplus_tree_print(gv->chroms->tree);
+
+  // genomeVcf_bplus_printRec(gv, rv);
+}
+
+static int cmp_RegionVcf(const void *a, const void *b) {
+  const RegionVcf *ra = (const RegionVcf *)a;
+  const RegionVcf *rb = (const RegionVcf *)b;
+  int ret = strcmp(ra->contig, rb->contig);
+  if (ret != 0) return ret;
+  return ra->beg < rb->beg ? -1 : (ra->beg > rb->beg ? 1 : 0);
+}
+
+/**
+ * @brief  Sort regions by contig and beg, and merge overlapping or adjacent
+ * regions of the same contig.
+ * @retval merged regions. Must be freed later.
+ */
+static RegionVcf *mergeRegionsVcf(const RegionVcf *regions, int cnt_region,
+                                  int *ret_cnt_region) {
+  RegionVcf *merged = (RegionVcf *)malloc(cnt_region * sizeof(RegionVcf));
+  memcpy(merged, regions, cnt_region * sizeof(RegionVcf));
+  qsort(merged, cnt_region, sizeof(RegionVcf), cmp_RegionVcf);
+  int cnt_merged = 0;
+  for (int i = 0; i < cnt_region; i++) {
+    RegionVcf *last = cnt_merged > 0 ? merged + cnt_merged - 1 : NULL;
+    if (last != NULL && strcmp(last->contig, merged[i].contig) == 0 &&
+        merged[i].beg <= last->end + 1) {
+      if (merged[i].end > last->end) last->end = merged[i].end;
+    } else {
+      merged[cnt_merged++] = merged[i];
+    }
+  }
+  *ret_cnt_region = cnt_merged;
+  return merged;
+}
+
+/**
+ * @brief  Check whether a record overlaps any of the merged regions.
+ */
+static bool ifRecInRegionsVcf(bcf_hdr_t *hdr, bcf1_t *rec,
+                              const RegionVcf *regions, int cnt_region) {
+  bcf_unpack(rec, BCF_UN_STR);
+  const char *contig = bcf_seqname_safe(hdr, rec);
+  int64_t pos = rec->pos + 1;
+  int64_t end = pos + strlen(rec->d.allele[0]) - 1;
+  // The last region that is not after the record
+  int lo = 0;
+  int hi = cnt_region;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    int ret = strcmp(regions[mid].contig, contig);
+    if (ret < 0 || (ret == 0 && regions[mid].beg <= end)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo > 0 && strcmp(regions[lo - 1].contig, contig) == 0 &&
+         regions[lo - 1].end >= pos;
+}
+
+/**
+ * @brief  Load records of a vcf file overlapping regions, through the index of
+ * the file.
+ * @retval false if the file has no index
+ */
+static bool loadRegionsVcf(GenomeVcf_bplus *gv, htsFile *fp, bcf_hdr_t *hdr,
+                           bcf1_t *rec, const char *filePath,
+                           const RegionVcf *regions, int cnt_region,
+                           bool ifCompact) {
+  hts_idx_t *idx = NULL;
+  tbx_t *tbx = NULL;
+  if (hts_get_format(fp)->format == bcf) {
+    idx = bcf_index_load(filePath);
+  } else if (hts_get_format(fp)->compression == bgzf) {
+    tbx = tbx_index_load(filePath);
+  }
+  if (idx == NULL && tbx == NULL) return false;
+  kstring_t str = {0, 0, NULL};
+  char buf_region[1024];
+  for (int i = 0; i < cnt_region; i++) {
+    snprintf(buf_region, sizeof(buf_region), "%s:%" PRId64 "-%" PRId64,
+             regions[i].contig, regions[i].beg, regions[i].end);
+    hts_itr_t *itr = idx != NULL ? bcf_itr_querys(idx, hdr, buf_region)
+                                 : tbx_itr_querys(tbx, buf_region);
+    // No such contig in the file
+    if (itr == NULL) continue;
+    // Records starting within the last region of the same contig have been
+    // loaded by the last query, as regions are merged.
+    int64_t pos_loaded = 0;
+    if (i > 0 && strcmp(regions[i - 1].contig, regions[i].contig) == 0) {
+      pos_loaded = regions[i - 1].end;
+    }
+    while (true) {
+      if (idx != NULL) {
+        if (bcf_itr_next(fp, itr, rec) < 0) break;
+      } else {
+        if (tbx_itr_next(fp, tbx, itr, &str) < 0) break;
+        if (vcf_parse(&str, hdr, rec) < 0) {
+          fprintf(stderr, "Error: failed parsing vcf record in region %s\n",
+                  buf_region);
+          exit(EXIT_FAILURE);
+        }
+      }
+      if (rec->pos + 1 <= pos_loaded) continue;
+      loadRecVcf(gv, hdr, rec, -1, ifCompact);
+    }
+    hts_itr_destroy(itr);
+  }
+  free(str.s);
+  if (idx != NULL) hts_idx_destroy(idx);
+  if (tbx != NULL) tbx_destroy(tbx);
+  return true;
+}
+
+/*
+ * Maximal number of threads loading a vcf file.
+ */
+#define LOADER_MAX_THREADS_VCF 16
+
+/*
+ * Number of records read into a batch, which are parsed together.
+ */
+#define SIZE_BATCH_VCF 1024
+
+/*
+ * Maximal number of batches read but not parsed yet for each thread, so that
+ * the reader does not run far ahead of the parsers.
+ */
+#define MAX_BATCH_LOADERVCF 8
+
+/**
+ * @brief  Get the number of threads loading a vcf file.
+ * @param  cnt_thread: number of threads asked for
+ * @retval cnt_thread, capped by the number of cores and LOADER_MAX_THREADS_VCF
+ */
+static int cnt_threadLoaderVcf(int cnt_thread) {
+  long cnt_core = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cnt_core >= 1 && cnt_thread > cnt_core) cnt_thread = (int)cnt_core;
+  if (cnt_thread > LOADER_MAX_THREADS_VCF) cnt_thread = LOADER_MAX_THREADS_VCF;
+  return cnt_thread < 1 ? 1 : cnt_thread;
+}
+
+/*
+ * Records of the same chromosome, read one after another from the vcf file.
+ */
+typedef struct _define_BatchVcf {
+  int cnt_rec;
+  kstring_t lines;  // lines of a text vcf file, each ended by '\0'
+  bcf1_t *recs[SIZE_BATCH_VCF];      // records of a bcf file
+  int64_t offsets[SIZE_BATCH_VCF];  // offsets in the file; -1 if unknown
+  struct _define_BatchVcf *next;
+} BatchVcf;
+
+/*
+ * A chromosome being loaded. Its batches are parsed by one thread at a time
+ * in order of the file, so records are appended to its tree in order without
+ * locking the tree.
+ */
+typedef struct _define_TaskVcf {
+  ChromVcf_bplus *cv;
+  int32_t rid;       // id of the chromosome in contigs of the genome
+  BatchVcf *first;   // batches waiting to be parsed
+  BatchVcf *last;
+  bool ifQueued;     // waiting in the queue of the loader
+  bool ifBusy;       // taken by a thread
+  ArenaVcf *arena_rec;  // compact records of the chromosome
+  ArenaVcf *pool_str;
+  struct _define_TaskVcf *next;  // next in the queue
+} TaskVcf;
+
+/*
+ * The vcf file is read by one thread, which only splits it into batches of
+ * records by chromosome. Batches are parsed and inserted into the trees of
+ * their chromosomes by other threads, and each chromosome is built by the
+ * thread that parses its last batch.
+ */
+typedef struct _define_LoaderVcf {
+  bcf_hdr_t *hdr;  // duplicated by each thread, as parsing may change it
+  bool ifBcf;
+  bool ifCompact;
+  const RegionVcf *regions;  // merged regions; NULL for all records
+  int cnt_region;
+  TaskVcf **tasks;  // tasks[id]: chromosome with id in contigs of the genome
+  int32_t capacity_task;
+  TaskVcf *first;  // queue of chromosomes having batches to parse
+  TaskVcf *last;
+  int cnt_batch;      // batches read but not parsed yet
+  int max_batch;
+  bool ifRead;        // all records are read
+  pthread_mutex_t mutex;
+  pthread_cond_t cond_task;   // a chromosome is queued, or all are read
+  pthread_cond_t cond_batch;  // batches are parsed
+} LoaderVcf;
+
+static inline void loaderVcf_queue(TaskVcf *task, LoaderVcf *loader) {
+  task->ifQueued = true;
+  task->next = NULL;
+  if (loader->last == NULL) {
+    loader->first = task;
+  } else {
+    loader->last->next = task;
+  }
+  loader->last = task;
+  pthread_cond_signal(&loader->cond_task);
+}
+
+/**
+ * @brief  Parse records of a batch and append them to the chromosome.
+ */
+static void parseBatchVcf(BatchVcf *batch, TaskVcf *task, bcf_hdr_t *hdr,
+                          bcf1_t *rec, LoaderVcf *loader) {
+  char *line = batch->lines.s;
+  for (int i = 0; i < batch->cnt_rec; i++) {
+    if (loader->ifBcf) {
+      rec = batch->recs[i];
+    } else {
+      size_t length_line = strlen(line);
+      kstring_t str = {length_line, length_line + 1, line};
+      if (vcf_parse(&str, hdr, rec) < 0) {
+        fprintf(stderr, "Error: failed parsing vcf record of chromosome %s\n",
+                task->cv->name);
+        exit(EXIT_FAILURE);
+      }
+      line += length_line + 1;
+    }
+    if (ifKeepRecVcf(rec) &&
+        (loader->regions == NULL ||
+         ifRecInRegionsVcf(hdr, rec, loader->regions, loader->cnt_region))) {
+      RecVcf_bplus *rv = NULL;
+      if (loader->ifCompact) {
+        rv = init_CompactRecVcf(rec, task->rid, batch->offsets[i],
+                                task->arena_rec, task->pool_str);
+      } else {
+        rv = init_RecVcf_bplus(rec, NULL);
+      }
+      chromVcf_bplus_appendRec(task->cv, rv);
+    }
+    if (loader->ifBcf) bcf_destroy1(rec);
+  }
+}
+
+static void *parseRecVcf_threads(void *args) {
+  LoaderVcf *loader = (LoaderVcf *)args;
+  bcf_hdr_t *hdr = bcf_hdr_dup(loader->hdr);
+  bcf1_t *rec = loader->ifBcf ? NULL : bcf_init1();
+  if (hdr == NULL || (loader->ifBcf == false && rec == NULL)) {
+    fprintf(stderr, "Error: memory not enough for loading vcf file.\n");
+    exit(EXIT_FAILURE);
+  }
+  while (true) {
+    pthread_mutex_lock(&loader->mutex);
+    while (loader->first == NULL && loader->ifRead == false) {
+      pthread_cond_wait(&loader->cond_task, &loader->mutex);
+    }
+    TaskVcf *task = loader->first;
+    BatchVcf *batch = NULL;
+    if (task != NULL) {
+      loader->first = task->next;
+      if (loader->first == NULL) loader->last = NULL;
+      task->ifQueued = false;
+      task->ifBusy = true;
+      batch = task->first;
+      task->first = task->last = NULL;
+    }
+    pthread_mutex_unlock(&loader->mutex);
+    if (task == NULL) break;
+
+    int cnt_batch = 0;
+    while (batch != NULL) {
+      parseBatchVcf(batch, task, hdr, rec, loader);
+      BatchVcf *next = batch->next;
+      free(batch->lines.s);
+      free(batch);
+      batch = next;
+      cnt_batch++;
+    }
+
+    pthread_mutex_lock(&loader->mutex);
+    loader->cnt_batch -= cnt_batch;
+    pthread_cond_signal(&loader->cond_batch);
+    // No more batches come once all records are read, and the chromosome is
+    // kept busy until it is built.
+    bool ifBuild = false;
+    if (task->first != NULL) {
+      task->ifBusy = false;
+      loaderVcf_queue(task, loader);
+    } else if (loader->ifRead) {
+      ifBuild = true;
+    } else {
+      task->ifBusy = false;
+    }
+    pthread_mutex_unlock(&loader->mutex);
+    if (ifBuild) chromVcf_bplus_build(task->cv);
+  }
+  if (rec != NULL) bcf_destroy1(rec);
+  bcf_hdr_destroy(hdr);
+  return NULL;
+}
+
+/**
+ * @brief  Get the task of a chromosome by its name. The chromosome is created
+ * if it is not found.
+ */
+static TaskVcf *taskOfContig_loader(const char *contig, GenomeVcf_bplus *gv,
+                                    LoaderVcf *loader) {
+  int32_t id = contigDict_id(gv->contigs, contig);
+  if (id < 0) id = contigDict_add(gv->contigs, contig);
+  if (id >= loader->capacity_task) {
+    int32_t capacity = loader->capacity_task * 2;
+    if (capacity <= id) capacity = id + 1;
+    loader->tasks =
+        (TaskVcf **)realloc(loader->tasks, capacity * sizeof(TaskVcf *));
+    if (loader->tasks == NULL) {
+      fprintf(stderr, "Error: memory not enough for loading vcf file.\n");
+      exit(EXIT_FAILURE);
+    }
+    memset(loader->tasks + loader->capacity_task, 0,
+           (capacity - loader->capacity_task) * sizeof(TaskVcf *));
+    loader->capacity_task = capacity;
+  }
+  if (loader->tasks[id] == NULL) {
+    TaskVcf *task = (TaskVcf *)calloc(1, sizeof(TaskVcf));
+    if (task == NULL) {
+      fprintf(stderr, "Error: memory not enough for loading vcf file.\n");
+      exit(EXIT_FAILURE);
+    }
+    // Chromosomes are created by the reader only, in order of the file
+    task->cv = genomeVcf_bplus_chromOfContig(gv, id);
+    task->rid = id;
+    if (loader->ifCompact) {
+      task->arena_rec = init_ArenaVcf();
+      task->pool_str = init_ArenaVcf();
+    }
+    loader->tasks[id] = task;
+  }
+  return loader->tasks[id];
+}
+
+/**
+ * @brief  Hand a batch over to the threads, waiting while too many batches
+ * are not parsed yet.
+ */
+static void submitBatchVcf_loader(BatchVcf *batch, TaskVcf *task,
+                                  LoaderVcf *loader) {
+  pthread_mutex_lock(&loader->mutex);
+  while (loader->cnt_batch >= loader->max_batch) {
+    pthread_cond_wait(&loader->cond_batch, &loader->mutex);
+  }
+  loader->cnt_batch++;
+  if (task->last == NULL) {
+    task->first = batch;
+  } else {
+    task->last->next = batch;
+  }
+  task->last = batch;
+  if (task->ifQueued == false && task->ifBusy == false) {
+    loaderVcf_queue(task, loader);
+  }
+  pthread_mutex_unlock(&loader->mutex);
+}
+
+/**
+ * @brief  Read records of the vcf file and split them into batches by
+ * chromosome. Text lines are only split at the first '\t' here, and are
+ * parsed by the threads.
+ */
+static void readRecVcf_loader(htsFile *fp, GenomeVcf_bplus *gv,
+                              LoaderVcf *loader) {
+  kstring_t str = {0, 0, NULL};
+  TaskVcf *task = NULL;
+  BatchVcf *batch = NULL;
+  int64_t offset_file = loader->ifCompact ? tellFileVcf(fp) : -1;
+  while (true) {
+    bcf1_t *rec = NULL;
+    const char *contig = NULL;
+    char *tab = NULL;  // the first '\t' of the line, replaced by '\0'
+    if (loader->ifBcf) {
+      rec = bcf_init1();
+      if (rec == NULL) {
+        fprintf(stderr, "Error: memory not enough for new bcf1_t object.\n");
+        exit(EXIT_FAILURE);
+      }
+      if (bcf_read1(fp, loader->hdr, rec) < 0) {
+        bcf_destroy1(rec);
+        break;
+      }
+      contig = bcf_seqname_safe(loader->hdr, rec);
+    } else {
+      if (hts_getline(fp, KS_SEP_LINE, &str) < 0) break;
+      tab = strchr(str.s, '\t');
+      if (str.l == 0 || str.s[0] == '#' || tab == NULL) {
+        if (loader->ifCompact) offset_file = tellFileVcf(fp);
+        continue;
+      }
+      *tab = '\0';
+      contig = str.s;
+    }
+    int64_t offset_rec = offset_file;
+    if (loader->ifCompact) offset_file = tellFileVcf(fp);
+
+    if (task == NULL || strcmp(task->cv->name, contig) != 0) {
+      if (batch != NULL) submitBatchVcf_loader(batch, task, loader);
+      batch = NULL;
+      task = taskOfContig_loader(contig, gv, loader);
+    }
+    if (batch == NULL) {
+      batch = (BatchVcf *)calloc(1, sizeof(BatchVcf));
+      if (batch == NULL) {
+        fprintf(stderr, "Error: memory not enough for loading vcf file.\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    if (loader->ifBcf) {
+      batch->recs[batch->cnt_rec] = rec;
+    } else {
+      *tab = '\t';
+      kputsn(str.s, str.l, &batch->lines);
+      kputc('\0', &batch->lines);
+    }
+    batch->offsets[batch->cnt_rec++] = offset_rec;
+    if (batch->cnt_rec == SIZE_BATCH_VCF) {
+      submitBatchVcf_loader(batch, task, loader);
+      batch = NULL;
+    }
+  }
+  if (batch != NULL) submitBatchVcf_loader(batch, task, loader);
+  free(str.s);
+
+  // Idle chromosomes are queued again to be built
+  pthread_mutex_lock(&loader->mutex);
+  loader->ifRead = true;
+  for (int32_t id = 0; id < loader->capacity_task; id++) {
+    TaskVcf *task_idle = loader->tasks[id];
+    if (task_idle != NULL && task_idle->ifQueued == false &&
+        task_idle->ifBusy == false) {
+      loaderVcf_queue(task_idle, loader);
+    }
+  }
+  pthread_cond_broadcast(&loader->cond_task);
+  pthread_mutex_unlock(&loader->mutex);
+}
+
+/**
+ * @brief  Load all records of the vcf file with cnt_thread threads. The
+ * chromosomes are built when this method returns.
+ * @param  *regions: merged regions of records to keep; NULL for all records
+ */
+static void loadStreamVcf_threads(htsFile *fp, bcf_hdr_t *hdr,
+                                  const RegionVcf *regions, int cnt_region,
+                                  bool ifCompact, int cnt_thread,
+                                  GenomeVcf_bplus *gv) {
+  LoaderVcf loader;
+  memset(&loader, 0, sizeof(LoaderVcf));
+  loader.hdr = hdr;
+  loader.ifBcf = hts_get_format(fp)->format == bcf;
+  loader.ifCompact = ifCompact;
+  loader.regions = regions;
+  loader.cnt_region = cnt_region;
+  loader.max_batch = cnt_thread * MAX_BATCH_LOADERVCF;
+  pthread_mutex_init(&loader.mutex, NULL);
+  pthread_cond_init(&loader.cond_task, NULL);
+  pthread_cond_init(&loader.cond_batch, NULL);
+  pthread_t threads[cnt_thread];
+  for (int i = 1; i < cnt_thread; i++) {
+    if (pthread_create(&threads[i], NULL, parseRecVcf_threads, &loader) !=
+        0) {
+      fprintf(stderr, "Error: failed to create thread to load vcf file\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  readRecVcf_loader(fp, gv, &loader);
+  parseRecVcf_threads(&loader);
+  for (int i = 1; i < cnt_thread; i++) pthread_join(threads[i], NULL);
+  pthread_cond_destroy(&loader.cond_batch);
+  pthread_cond_destroy(&loader.cond_task);
+  pthread_mutex_destroy(&loader.mutex);
+
+  for (int32_t id = 0; id < loader.capacity_task; id++) {
+    TaskVcf *task = loader.tasks[id];
+    if (task == NULL) continue;
+    if (ifCompact) {
+      arenaVcf_merge(gv->arena_rec, task->arena_rec);
+      arenaVcf_merge(gv->pool_str, task->pool_str);
+    }
+    free(task);
+  }
+  free(loader.tasks);
+
+  // Chromosomes are created before their records are parsed. Remove those
+  // left without records, which are not created when loaded by one thread.
+  ChromVcf_bplus **link = &gv->chroms;
+  while (*link != NULL) {
+    ChromVcf_bplus *cv = *link;
+    if (cv->cnt_rec > 0) {
+      link = &cv->next;
+      continue;
+    }
+    *link = cv->next;
+    gv->chroms_contig[contigDict_id(gv->contigs, cv->name)] = NULL;
+    gv->cnt_chrom--;
+    destroy_ChromVcf_bplus(cv);
+  }
+}
+
+/**
+ * @brief  Load a vcf file into a GenomeVcf_bplus object.
+ * @param  *regions: regions of records to load; NULL for all records
+ * @param  ifCompact: whether to keep compact records instead of bcf1_t objects
+ * @param  cnt_thread: number of threads decompressing and parsing the file
+ */
+static GenomeVcf_bplus *loadFileVcf(char *filePath, int rank_inner_node,
+                                    int rank_leaf_node,
+                                    const RegionVcf *regions, int cnt_region,
+                                    bool ifCompact, int cnt_thread) {
+  if (ifIndexFileVcf(filePath)) {
+    return loadIndexFileVcf(filePath, NULL);
+  }
+  // Records of index files are compact, so the index beside the vcf file is
+  // only used when compact records are asked for
+  char indexPath[strlen(filePath) + strlen(GENOMEVCF_INDEX_SUFFIX) + 1];
+  sprintf(indexPath, "%s%s", filePath, GENOMEVCF_INDEX_SUFFIX);
+  if (ifCompact && ifFreshIndexVcf(filePath, indexPath)) {
+    return loadIndexFileVcf(indexPath, filePath);
+  }
+  htsFile *fp = hts_open(filePath, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Error: cannot open vcf file %s\n", filePath);
+    exit(EXIT_FAILURE);
+  }
+  // Blocks of bgzip compressed files are decompressed by the pool
+  htsThreadPool pool = {NULL, 0};
+  if (cnt_thread > 1) {
+    pool.pool = hts_tpool_init(cnt_thread);
+    if (pool.pool != NULL) hts_set_thread_pool(fp, &pool);
+  }
+  bcf_hdr_t *hdr = bcf_hdr_read(fp);
+  bcf1_t *rec = bcf_init1();
+
+  if (hdr == NULL) {
+    fprintf(stderr, "Error: failed creating bcf header struct.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (rec == NULL) {
+    fprintf(stderr, "Error: memory not enough for new bcf1_t object.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  GenomeVcf_bplus *gv =
+      init_GenomeVcf_bplus(rank_inner_node, rank_leaf_node, hdr);
+  gv->filePath = strdup(filePath);
+  if (ifCompact) {
+    gv->arena_rec = init_ArenaVcf();
+    gv->pool_str = init_ArenaVcf();
+  }
+  RegionVcf *regions_merged = NULL;
+  int cnt_region_merged = 0;
+  bool ifLoaded = false;
+  if (regions != NULL) {
+    regions_merged = mergeRegionsVcf(regions, cnt_region, &cnt_region_merged);
+    ifLoaded = loadRegionsVcf(gv, fp, hdr, rec, filePath, regions_merged,
+                              cnt_region_merged, ifCompact);
+    if (ifLoaded == false) {
+      fprintf(stderr,
+              "Warning: no index for vcf file %s. The whole file is read.\n",
+              filePath);
+    }
+  }
+  if (ifLoaded == false && cnt_thread > 1) {
+    // Chromosomes are built by the threads
+    loadStreamVcf_threads(fp, hdr, regions_merged, cnt_region_merged,
+                          ifCompact, cnt_thread, gv);
+  } else {
+    int64_t offset_file = ifCompact ? tellFileVcf(fp) : -1;
+    while (ifLoaded == false && bcf_read1(fp, hdr, rec) >= 0) {
+      int64_t offset_rec = offset_file;
+      if (ifCompact) offset_file = tellFileVcf(fp);
+      if (regions_merged != NULL &&
+          ifRecInRegionsVcf(hdr, rec, regions_merged, cnt_region_merged) ==
+              false) {
+        continue;
+      }
+      loadRecVcf(gv, hdr, rec, offset_rec, ifCompact);
+    }
+    for (ChromVcf_bplus *cv = gv->chroms; cv != NULL; cv = cv->next) {
+      chromVcf_bplus_build(cv);
+    }
+  }
+  free(regions_merged);
+
+  bcf_destroy1(rec);
+  bcf_hdr_destroy(hdr);
+  hts_close(fp);
+  if (pool.pool != NULL) hts_tpool_destroy(pool.pool);
+  return gv;
+}
+
+GenomeVcf_bplus *genomeVcf_bplus_loadFile(char *filePath, int rank_inner_node,
+                                          int rank_leaf_node,
+                                          const RegionVcf *regions,
+                                          int cnt_region, int cnt_thread) {
+  return loadFileVcf(filePath, rank_inner_node, rank_leaf_node, regions,
+                     cnt_region, false, cnt_threadLoaderVcf(cnt_thread));
+}
+
+GenomeVcf_bplus *genomeVcf_bplus_loadFileCompact(char *filePath,
+                                                 int rank_inner_node,
+                                                 int rank_leaf_node,
+                                                 const RegionVcf *regions,
+                                                 int cnt_region,
+                                                 int cnt_thread) {
+  return loadFileVcf(filePath, rank_inner_node, rank_leaf_node, regions,
+                     cnt_region, true, cnt_threadLoaderVcf(cnt_thread));
+}
+
+bcf1_t *genomeVcf_bplus_fetchRec(GenomeVcf_bplus *gv, RecVcf_bplus *rv) {
+  if (rv->data != NULL) return bcf_dup(rv->data);
+  CompactRecVcf *crv = (CompactRecVcf *)rv;
+  if (crv->offset_file < 0) {
+    fprintf(stderr, "Error: unknown offset of the record in vcf file %s\n",
+            gv->filePath);
+    exit(EXIT_FAILURE);
+  }
+  htsFile *fp = hts_open(gv->filePath, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Error: cannot open vcf file %s\n", gv->filePath);
+    exit(EXIT_FAILURE);
+  }
+  int64_t ret_seek =
+      fp->is_bgzf ? bgzf_seek(fp->fp.bgzf, crv->offset_file, SEEK_SET)
+                  : (int64_t)hseek(fp->fp.hfile, crv->offset_file, SEEK_SET);
+  bcf1_t *rec = bcf_init1();
+  if (ret_seek < 0 || bcf_read1(fp, gv->hdr, rec) < 0 ||
+      rec->pos + 1 != crv->pos) {
+    fprintf(stderr,
+            "Error: failed fetching record at POS %" PRId64 " from %s. Plain "
+            "gzip compressed files are not seekable.\n",
+            crv->pos, gv->filePath);
+    exit(EXIT_FAILURE);
+  }
+  bcf_unpack(rec, BCF_UN_ALL);
+  hts_close(fp);
+  return rec;
+}
+
+/**********************************
+ * Accessing data within structures
+ **********************************/
+
+inline int gv_cnt_rec(GenomeVcf_bplus *gv) {
+  int cnt_rec = 0;
+  ChromVcf_bplus *cv = gv->chroms;
+  while (cv != NULL) {
+    cnt_rec = cnt_rec + cv->cnt_rec;
+    cv = cv->next;
+  }
+  return cnt_rec;
+}
+
+inline bcf1_t *rv_object(RecVcf_bplus *rv) {
+  if (rv->data == NULL) {
+    fprintf(stderr,
+            "Error: compact records keep no bcf1_t object. Use "
+            "genomeVcf_bplus_fetchRec instead.\n");
+    exit(EXIT_FAILURE);
+  }
+  return rv->data;
+}
+
+const char *rv_ID(RecVcf_bplus *rv) {
+  if (rv->data == NULL) {
+    CompactRecVcf *crv = (CompactRecVcf *)rv;
+    return (const char *)(crv->strs + crv->n_allele);
+  }
+  return rv->data->d.id;
+}
+
+inline int64_t rv_pos(RecVcf_bplus *rv) {
+  if (rv->data == NULL) return ((CompactRecVcf *)rv)->pos;
+  return rv->data->pos + 1;
 }
 
 inline const char *rv_chromName(RecVcf_bplus *rv, GenomeVcf_bplus *gv) {
   assert(gv->hdr != NULL);
-  assert(rv->data != NULL);
+  if (rv->data == NULL) {
+    return contigDict_name(gv->contigs, ((CompactRecVcf *)rv)->rid);
+  }
   return bcf_seqname_safe(gv->hdr, rv->data);
 }
 
 inline int rv_alleleCnt(RecVcf_bplus *rv) {
-  assert(rv->data != NULL);
+  if (rv->data == NULL) return ((CompactRecVcf *)rv)->n_allele;
   return rv->data->n_allele;
 }
 
+inline int64_t rv_end(RecVcf_bplus *rv) {
+  return rv_pos(rv) + rv->infos[0].length - 1;
+}
+
+inline int rv_alleleType(RecVcf_bplus *rv, int alleleIdx) {
+  assert(alleleIdx < rv_alleleCnt(rv));
+  return rv->infos[alleleIdx].type;
+}
+
 inline int rv_alleleCoverLength(RecVcf_bplus *rv, int alleleIdx) {
-  assert(rv->data != NULL);
   assert(
-      (alleleIdx < rv->data->n_allele) ||
+      (alleleIdx < rv_alleleCnt(rv)) ||
       (fprintf(stderr,
                "Error: array out of boundary for rv_alleleCoverLength(...)\n") <
        0));
@@ -1078,56 +2861,55 @@ inline int rv_alleleCoverLength(RecVcf_bplus *rv, int alleleIdx) {
          (fprintf(stderr,
                   "Error: variants with tags should be ignored when "
                   "loading.\n") < 0));
-  int len_ref = strlen(rv_allele(rv, 0));
-  int len_allele = strlen(rv_allele(rv, alleleIdx));
-  if (len_ref == 1) {  // Insertion
-    return 1;
-  } else if (len_allele == 1) {  // Deletion
-    return len_ref;
-  } else {  // Other cases (MNP, etc.)
-    return len_ref;
-  }
+  return rv->infos[alleleIdx].length_cover;
 }
 
 inline const char *rv_allele(RecVcf_bplus *rv, int alleleIdx) {
-  assert(rv->data != NULL);
   assert(
-      (alleleIdx < rv->data->n_allele) ||
+      (alleleIdx < rv_alleleCnt(rv)) ||
       (fprintf(
            stderr,
            "Error: array out of boundary for rvDataAlleleCoverLength(...)\n") <
        0));
+  if (rv->data == NULL) {
+    CompactRecVcf *crv = (CompactRecVcf *)rv;
+    return (const char *)(crv->strs + rv->infos[alleleIdx].offset);
+  }
   return rv->data->d.allele[alleleIdx];
 }
 
+inline const AlleleInfoVcf *rv_alleleInfos(RecVcf_bplus *rv) {
+  return rv->infos;
+}
+
 void genomeVcf_bplus_printRec(GenomeVcf_bplus *gv, RecVcf_bplus *rv) {
   assert(gv->hdr != NULL);
-  assert(rv->data != NULL);
-  bcf1_t *rec = rv_object(rv);
   // chrom
-  fprintf(stderr, "%s\t", bcf_seqname_safe(gv->hdr, rec));
+  fprintf(stderr, "%s\t", rv_chromName(rv, gv));
   // pos
-  fprintf(stderr, "%" PRId64 "\t", rec->pos + 1);
+  fprintf(stderr, "%" PRId64 "\t", rv_pos(rv));
   // id
-  fprintf(stderr, "%s\t", rec->d.id);
+  fprintf(stderr, "%s\t", rv_ID(rv));
   // ref alt
-  fprintf(stderr, "%s\t", rec->d.allele[0]);
-  if (rec->n_allele == 1) {
+  fprintf(stderr, "%s\t", rv_allele(rv, 0));
+  if (rv_alleleCnt(rv) == 1) {
     fprintf(stderr, ".");
   } else {
-    for (int i = 1; i < rec->n_allele; i++) {
+    for (int i = 1; i < rv_alleleCnt(rv); i++) {
       if (i >= 2) {
-        fprintf(stderr, ",%s(%d)", rec->d.allele[i],
-                bcf_get_variant_type(rec, i));
+        fprintf(stderr, ",%s(%d)", rv_allele(rv, i), rv_alleleType(rv, i));
       } else {
-        fprintf(stderr, "%s(%d)", rec->d.allele[i],
-                bcf_get_variant_type(rec, i));
+        fprintf(stderr, "%s(%d)", rv_allele(rv, i), rv_alleleType(rv, i));
       }
     }
   }
   fprintf(stderr, "\t");
-  // qual
-  fprintf(stderr, "%f\t", rec->qual);
+  // qual (not kept by compact records)
+  if (rv->data != NULL) {
+    fprintf(stderr, "%f\t", rv->data->qual);
+  } else {
+    fprintf(stderr, ".\t");
+  }
   // TODO filter, info, format and other fields are ignored
   fprintf(stderr, "\n");
 }
@@ -1148,4 +2930,599 @@ void genomeVcf_bplus_printRec(GenomeVcf_bplus *gv, RecVcf_bplus *rv) {
 
 static int _test_BasicFunctions() { return 1; }
 
-void _testSet_genomeVcf_bplus() { assert(_test_BasicFunctions()); }
\ No newline at end of file
+/**
+ * @brief  Create a record with only POS set.
+ */
+static RecVcf_bplus *_init_testRec(int64_t pos) {
+  bcf1_t *data = bcf_init1();
+  data->pos = pos - 1;
+  RecVcf_bplus *rv = (RecVcf_bplus *)calloc(
+      1, sizeof(RecVcf_bplus) + sizeof(AlleleInfoVcf));
+  rv->data = data;
+  rv->infos = (AlleleInfoVcf *)(rv + 1);
+  return rv;
+}
+
+/**
+ * @brief  Create a record with POS and a REF of len_ref bases.
+ */
+static RecVcf_bplus *_init_testRecRef(int64_t pos, int len_ref) {
+  RecVcf_bplus *rv = _init_testRec(pos);
+  bcf1_t *data = rv->data;
+  data->d.als = (char *)malloc(len_ref + 1);
+  memset(data->d.als, 'A', len_ref);
+  data->d.als[len_ref] = '\0';
+  data->d.m_als = len_ref + 1;
+  data->d.allele = (char **)malloc(sizeof(char *));
+  data->d.allele[0] = data->d.als;
+  data->d.m_allele = 1;
+  data->n_allele = 1;
+  setAlleleInfoVcf(rv->infos, len_ref, len_ref, VCF_REF, 0);
+  return rv;
+}
+
+/**
+ * @brief  Check records of a chromosome against counts of records at each POS.
+ */
+static void _check_testChrom(ChromVcf_bplus *cv, const int *cnt_pos,
+                             int64_t pos_max) {
+  // Iterate all records
+  uint64_t cnt_rec = 0;
+  int64_t pos_last = 0;
+  CursorVcf cursor = chromVcf_bplus_cursor(cv, 1);
+  for (; cursor.rv != NULL; cursorVcf_next(&cursor)) {
+    assert(rv_pos(cursor.rv) >= pos_last);
+    pos_last = rv_pos(cursor.rv);
+    cnt_rec++;
+  }
+  assert(cnt_rec == cv->cnt_rec);
+  assert(cursorVcf_next(&cursor) == NULL);
+  // Iterate records within ranges [begin, end)
+  for (int64_t begin = 0; begin <= pos_max + 1; begin += 7) {
+    for (int64_t end = begin; end <= begin + 40; end += 13) {
+      int cnt_expected = 0;
+      for (int64_t pos = begin < 1 ? 1 : begin; pos < end && pos <= pos_max;
+           pos++) {
+        cnt_expected += cnt_pos[pos];
+      }
+      int cnt_range = 0;
+      CursorVcf range = chromVcf_bplus_range(cv, begin, end);
+      for (; range.rv != NULL; cursorVcf_next(&range)) {
+        assert(rv_pos(range.rv) >= begin && rv_pos(range.rv) < end);
+        cnt_range++;
+      }
+      assert(cnt_range == cnt_expected);
+    }
+  }
+  // Search every POS
+  int64_t pos_expected = 0;  // 0 for no record
+  for (int64_t pos = pos_max; pos >= 1; pos--) {
+    if (cnt_pos[pos] > 0) pos_expected = pos;
+    RecVcf_bplus *rv = chromVcf_bplus_getRecAfterPos(cv, pos);
+    if (pos_expected == 0) {
+      assert(rv == NULL);
+      continue;
+    }
+    assert(rv != NULL && rv_pos(rv) == pos_expected);
+    int cnt_same = 0;
+    for (; rv != NULL && rv_pos(rv) == pos_expected; rv = rv->next) {
+      cnt_same++;
+    }
+    assert(cnt_same == cnt_pos[pos_expected]);
+  }
+}
+
+static void _test_BulkLoading(int rank_inner_node, int rank_leaf_node) {
+  int rank_inner_node_saved = RANK_INNER_NODE;
+  int rank_leaf_node_saved = RANK_LEAF_NODE;
+  vcfbplus_setRanks(rank_inner_node, rank_leaf_node);
+  const int cnt_rec = 1000;
+  const int64_t pos_max = 2000;
+  int *cnt_pos = (int *)calloc(pos_max + 1, sizeof(int));
+
+  // Sorted records, some of which have the same POS
+  ChromVcf_bplus *cv = init_ChromVcf_bplus("chr1");
+  for (int i = 0; i < cnt_rec; i++) {
+    int64_t pos = 1 + (i / 2) * 3;
+    cnt_pos[pos]++;
+    chromVcf_bplus_appendRec(cv, _init_testRec(pos));
+  }
+  chromVcf_bplus_build(cv);
+  // All leaf nodes except the last one are full
+  for (VcfBPlusNode *bpnode = cv->tree->first; bpnode != cv->tree->last;
+       bpnode = bpnode->right) {
+    assert(bpnode->cnt_key == RANK_LEAF_NODE);
+  }
+  _check_testChrom(cv, cnt_pos, pos_max);
+  // Records inserted after building
+  for (int64_t pos = 2; pos < pos_max; pos += 7) {
+    cnt_pos[pos]++;
+    chromVcf_bplus_appendRec(cv, _init_testRec(pos));
+  }
+  chromVcf_bplus_build(cv);
+  _check_testChrom(cv, cnt_pos, pos_max);
+  // Static index of the same records
+  chromVcf_bplus_freeze(cv);
+  _check_testChrom(cv, cnt_pos, pos_max);
+  destroy_ChromVcf_bplus(cv);
+
+  // Unsorted records fall back to insertion
+  memset(cnt_pos, 0, (pos_max + 1) * sizeof(int));
+  cv = init_ChromVcf_bplus("chr2");
+  uint32_t seed = 42;
+  for (int i = 0; i < cnt_rec; i++) {
+    int64_t pos = 1 + i;
+    if (i >= cnt_rec / 2) {
+      seed = seed * 1103515245 + 12345;
+      pos = 1 + (seed >> 8) % (pos_max - 1);
+    }
+    cnt_pos[pos]++;
+    chromVcf_bplus_appendRec(cv, _init_testRec(pos));
+  }
+  chromVcf_bplus_build(cv);
+  _check_testChrom(cv, cnt_pos, pos_max);
+  // Static index of the same records
+  chromVcf_bplus_freeze(cv);
+  _check_testChrom(cv, cnt_pos, pos_max);
+  destroy_ChromVcf_bplus(cv);
+
+  free(cnt_pos);
+  vcfbplus_setRanks(rank_inner_node_saved, rank_leaf_node_saved);
+}
+
+/**
+ * @brief  Search a tree after another tree with bigger nodes is built, as
+ * sizes of keys of nodes depend on ranks of the tree that they belong to.
+ */
+static void _test_MixedRanks() {
+  int rank_inner_node_saved = RANK_INNER_NODE;
+  int rank_leaf_node_saved = RANK_LEAF_NODE;
+  const int64_t pos_max = 600;
+  int *cnt_pos = (int *)calloc(pos_max + 1, sizeof(int));
+  for (int64_t pos = 1; pos <= pos_max; pos += 2) cnt_pos[pos]++;
+  vcfbplus_setRanks(4, 3);
+  ChromVcf_bplus *cv_small = init_ChromVcf_bplus("chr1");
+  for (int64_t pos = 1; pos <= pos_max; pos += 2) {
+    chromVcf_bplus_appendRec(cv_small, _init_testRec(pos));
+  }
+  chromVcf_bplus_build(cv_small);
+  vcfbplus_setRanks(RANK_INNER_NODE_DEFAULT, RANK_LEAF_NODE_DEFAULT);
+  ChromVcf_bplus *cv_big = init_ChromVcf_bplus("chr2");
+  for (int64_t pos = 1; pos <= pos_max; pos += 2) {
+    chromVcf_bplus_appendRec(cv_big, _init_testRec(pos));
+  }
+  chromVcf_bplus_build(cv_big);
+  assert(cv_small->tree->first->capacity_key <
+         cv_big->tree->first->capacity_key);
+  _check_testChrom(cv_small, cnt_pos, pos_max);
+  _check_testChrom(cv_big, cnt_pos, pos_max);
+  destroy_ChromVcf_bplus(cv_small);
+  destroy_ChromVcf_bplus(cv_big);
+  free(cnt_pos);
+  vcfbplus_setRanks(rank_inner_node_saved, rank_leaf_node_saved);
+}
+
+/**
+ * @brief  Check records found by chromVcf_bplus_getRecsOverlap against records
+ * found by iterating all records.
+ */
+static void _check_testOverlaps(ChromVcf_bplus *cv, int64_t pos_max) {
+  RecVcf_bplus **rvs = NULL;
+  int64_t capacity = 0;
+  for (int64_t lbound = 1; lbound <= pos_max; lbound += 3) {
+    for (int64_t length = 1; length <= 64; length *= 4) {
+      int64_t rbound = lbound + length - 1;
+      int64_t cnt_rv =
+          chromVcf_bplus_getRecsOverlap(cv, lbound, rbound, &rvs, &capacity);
+      int64_t idx_rv = 0;
+      CursorVcf cursor = chromVcf_bplus_range(cv, 1, rbound + 1);
+      for (RecVcf_bplus *rv = cursor.rv; rv != NULL;
+           rv = cursorVcf_next(&cursor)) {
+        if (rv_pos(rv) + (int64_t)strlen(rv_allele(rv, 0)) - 1 < lbound) {
+          continue;
+        }
+        assert(idx_rv < cnt_rv && rvs[idx_rv] == rv);
+        idx_rv++;
+      }
+      assert(idx_rv == cnt_rv);
+    }
+  }
+  free(rvs);
+}
+
+static void _test_OverlapIndex(int cnt_rec) {
+  const int64_t pos_max = 2000;
+  ChromVcf_bplus *cv = init_ChromVcf_bplus("chr1");
+  uint32_t seed = 7;
+  for (int i = 0; i < cnt_rec; i++) {
+    seed = seed * 1103515245 + 12345;
+    int64_t pos = 1 + (seed >> 8) % pos_max;
+    // Mostly SNPs, with a few long deletions
+    seed = seed * 1103515245 + 12345;
+    int len_ref = (seed >> 8) % 16 == 0 ? 1 + (seed >> 12) % 300 : 1;
+    chromVcf_bplus_appendRec(cv, _init_testRecRef(pos, len_ref));
+  }
+  chromVcf_bplus_indexOverlaps(cv);
+  _check_testOverlaps(cv, pos_max);
+  // The index is dropped by insertion, and then built again
+  chromVcf_bplus_appendRec(cv, _init_testRecRef(pos_max / 2, 500));
+  assert(cv->overlaps == NULL);
+  chromVcf_bplus_indexOverlaps(cv);
+  _check_testOverlaps(cv, pos_max);
+  // Records of the static index
+  chromVcf_bplus_freeze(cv);
+  _check_testOverlaps(cv, pos_max);
+  destroy_ChromVcf_bplus(cv);
+}
+
+/**
+ * @brief  Check infos of alleles of a record against the allele strings.
+ */
+static void _check_testAlleleInfos(RecVcf_bplus *rv, RecVcf_bplus *rv_full) {
+  const AlleleInfoVcf *infos = rv_alleleInfos(rv);
+  int length_ref = strlen(rv_allele(rv, 0));
+  assert(rv_end(rv) == rv_pos(rv) + length_ref - 1);
+  for (int i = 0; i < rv_alleleCnt(rv); i++) {
+    int length = strlen(rv_allele(rv, i));
+    assert(infos[i].length == length);
+    assert(infos[i].length_sv == (length > length_ref ? length : length_ref));
+    assert(infos[i].length_cover == length_ref);
+    assert(infos[i].type == bcf_get_variant_type(rv_full->data, i));
+  }
+}
+
+static void _test_CompactRecords() {
+  const char *filePath = "data/example.vcf";
+  GenomeVcf_bplus *gv =
+      genomeVcf_bplus_loadFile((char *)filePath, 7, 6, NULL, 0, 1);
+  GenomeVcf_bplus *gv_compact =
+      genomeVcf_bplus_loadFileCompact((char *)filePath, 7, 6, NULL, 0, 1);
+  // Compare with records of the static index
+  genomeVcf_bplus_freeze(gv);
+  assert(gv_cnt_rec(gv) == 7);
+  assert(gv_cnt_rec(gv_compact) == gv_cnt_rec(gv));
+  ChromVcf_bplus *cv = gv->chroms;
+  ChromVcf_bplus *cv_compact = gv_compact->chroms;
+  for (; cv != NULL; cv = cv->next, cv_compact = cv_compact->next) {
+    assert(strcmp(cv->name, cv_compact->name) == 0);
+    CursorVcf cursor = chromVcf_bplus_cursor(cv, 1);
+    CursorVcf cursor_compact = chromVcf_bplus_cursor(cv_compact, 1);
+    RecVcf_bplus *rv = cursor.rv;
+    RecVcf_bplus *rv_compact = cursor_compact.rv;
+    while (rv != NULL) {
+      assert(rv_compact != NULL && rv_compact->data == NULL);
+      assert(rv_pos(rv_compact) == rv_pos(rv));
+      assert(strcmp(rv_ID(rv_compact), rv_ID(rv)) == 0);
+      assert(strcmp(rv_chromName(rv_compact, gv_compact),
+                    rv_chromName(rv, gv)) == 0);
+      assert(rv_alleleCnt(rv_compact) == rv_alleleCnt(rv));
+      for (int i = 0; i < rv_alleleCnt(rv); i++) {
+        assert(strcmp(rv_allele(rv_compact, i), rv_allele(rv, i)) == 0);
+        assert(rv_alleleType(rv_compact, i) == rv_alleleType(rv, i));
+      }
+      _check_testAlleleInfos(rv, rv);
+      _check_testAlleleInfos(rv_compact, rv);
+      // The full record is read again from the file
+      bcf1_t *rec = genomeVcf_bplus_fetchRec(gv_compact, rv_compact);
+      assert(rec->pos + 1 == rv_pos(rv));
+      assert(strcmp(rec->d.id, rv_ID(rv)) == 0);
+      assert(rec->n_allele == rv_alleleCnt(rv));
+      bcf_destroy1(rec);
+      rv = cursorVcf_next(&cursor);
+      rv_compact = cursorVcf_next(&cursor_compact);
+    }
+    assert(rv_compact == NULL);
+  }
+  assert(cv_compact == NULL);
+  destroy_GenomeVcf_bplus(gv);
+  destroy_GenomeVcf_bplus(gv_compact);
+}
+
+/**
+ * @brief  Check that both genomes have the same chromosomes in the same order,
+ * and the same records in each chromosome.
+ */
+static void _check_testSameGenome(GenomeVcf_bplus *gv_a,
+                                  GenomeVcf_bplus *gv_b) {
+  assert(gv_a->cnt_chrom == gv_b->cnt_chrom);
+  ChromVcf_bplus *cv_a = gv_a->chroms;
+  ChromVcf_bplus *cv_b = gv_b->chroms;
+  for (; cv_a != NULL; cv_a = cv_a->next, cv_b = cv_b->next) {
+    assert(strcmp(cv_a->name, cv_b->name) == 0);
+    assert(cv_a->cnt_rec == cv_b->cnt_rec);
+    CursorVcf cursor_a = chromVcf_bplus_cursor(cv_a, 1);
+    CursorVcf cursor_b = chromVcf_bplus_cursor(cv_b, 1);
+    RecVcf_bplus *rv_b = cursor_b.rv;
+    for (RecVcf_bplus *rv_a = cursor_a.rv; rv_a != NULL;
+         rv_a = cursorVcf_next(&cursor_a)) {
+      assert(rv_b != NULL && rv_pos(rv_a) == rv_pos(rv_b));
+      assert(strcmp(rv_ID(rv_a), rv_ID(rv_b)) == 0);
+      assert(strcmp(rv_chromName(rv_a, gv_a), rv_chromName(rv_b, gv_b)) == 0);
+      rv_b = cursorVcf_next(&cursor_b);
+    }
+    assert(rv_b == NULL);
+  }
+  assert(cv_b == NULL);
+}
+
+/**
+ * @brief  Compress a file with bgzip, and index it with tabix.
+ */
+static void _bgzip_testFile(const char *srcPath, const char *dstPath) {
+  FILE *fp_in = fopen(srcPath, "rb");
+  BGZF *fp_out = bgzf_open(dstPath, "w");
+  assert(fp_in != NULL && fp_out != NULL);
+  char buf[4096];
+  size_t size_read = 0;
+  while ((size_read = fread(buf, 1, sizeof(buf), fp_in)) > 0) {
+    assert(bgzf_write(fp_out, buf, size_read) == (ssize_t)size_read);
+  }
+  fclose(fp_in);
+  assert(bgzf_close(fp_out) == 0);
+  assert(tbx_index_build(dstPath, 0, &tbx_conf_vcf) == 0);
+}
+
+static void _test_RegionLoading() {
+  const char *filePath = "data/example.vcf";
+  // Unsorted and overlapping regions. The deletion at 1:169519049 (CTG) is
+  // loaded by the region starting at its last base.
+  const RegionVcf regions[] = {{"5", 1, 200000000},
+                               {"1", 169519051, 169519060},
+                               {"1", 12065940, 12065947},
+                               {"1", 12065945, 109817589},
+                               {"chrX", 1, 100}};
+  GenomeVcf_bplus *gv =
+      genomeVcf_bplus_loadFile((char *)filePath, 7, 6, regions, 5, 1);
+  assert(gv_cnt_rec(gv) == 3);
+  ChromVcf_bplus *cv =
+      genomeVcf_bplus_getChromByContig(gv, contigDict_id(gv->contigs, "1"));
+  CursorVcf cursor = chromVcf_bplus_cursor(cv, 1);
+  assert(cursor.rv != NULL && rv_pos(cursor.rv) == 12065947);
+  RecVcf_bplus *rv = cursorVcf_next(&cursor);
+  assert(rv != NULL && rv_pos(rv) == 169519049);
+  assert(cursorVcf_next(&cursor) == NULL);
+  cv = genomeVcf_bplus_getChromByContig(gv, contigDict_id(gv->contigs, "5"));
+  rv = chromVcf_bplus_getRecAfterPos(cv, 1);
+  assert(rv != NULL && rv_pos(rv) == 156108541);
+  destroy_GenomeVcf_bplus(gv);
+
+  // A sorted file and its copy with bgzip and tabix. Every fourth record is a
+  // 20bp deletion, some of which overlap 2 regions that are not merged.
+  const char *sortedPath = "data/test_region.vcf.tmp";
+  const char *gzPath = "data/test_region.vcf.gz.tmp";
+  const char *tbiPath = "data/test_region.vcf.gz.tmp.tbi";
+  FILE *fp = fopen(sortedPath, "w");
+  assert(fp != NULL);
+  fprintf(fp, "##fileformat=VCFv4.1\n");
+  fprintf(fp, "##contig=<ID=chr1>\n##contig=<ID=chr2>\n");
+  fprintf(fp, "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\n");
+  const char *contigs[] = {"chr1", "chr2"};
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 300; j++) {
+      fprintf(fp, "%s\t%d\trec%d_%d\t%s\t%s\t30\tPASS\t.\n", contigs[i],
+              100 + j * 10, i, j, j % 4 == 0 ? "ACGTACGTACGTACGTACGT" : "A",
+              j % 4 == 0 ? "A" : "C");
+    }
+  }
+  fclose(fp);
+  _bgzip_testFile(sortedPath, gzPath);
+  // The deletion at chr1:1700 overlaps both [1600, 1705] and [1710, 1712],
+  // and the one at chr1:1740 only overlaps [1750, 1755]
+  const RegionVcf regions_tbi[] = {
+      {"chr1", 1710, 1712}, {"chr2", 300, 2000}, {"chr1", 1600, 1705},
+      {"chr1", 1000, 1505}, {"chr1", 1750, 1755}, {"chr2", 1, 500},
+      {"chr1", 1500, 1599}, {"chr2", 2990, 5000}, {"chr3", 1, 100}};
+  for (int ifCompact = 0; ifCompact < 2; ifCompact++) {
+    GenomeVcf_bplus *gv_read =
+        loadFileVcf((char *)sortedPath, 7, 6, regions_tbi, 9, ifCompact, 1);
+    GenomeVcf_bplus *gv_index =
+        loadFileVcf((char *)gzPath, 7, 6, regions_tbi, 9, ifCompact, 1);
+    _check_testSameGenome(gv_read, gv_index);
+    assert(gv_cnt_rec(gv_index) > 0 && gv_cnt_rec(gv_index) < 600);
+    cv = genomeVcf_bplus_getChromByContig(
+        gv_index, contigDict_id(gv_index->contigs, "chr1"));
+    rv = chromVcf_bplus_getRecAfterPos(cv, 1701);
+    assert(rv != NULL && rv_pos(rv) == 1710);
+    rv = chromVcf_bplus_getRecAfterPos(cv, 1711);
+    assert(rv != NULL && rv_pos(rv) == 1740);
+    // Compact records have no offsets in the file if loaded through the index
+    CursorVcf cursor_index = chromVcf_bplus_cursor(cv, 1);
+    for (; ifCompact && cursor_index.rv != NULL;
+         cursorVcf_next(&cursor_index)) {
+      assert(((CompactRecVcf *)cursor_index.rv)->offset_file == -1);
+    }
+    destroy_GenomeVcf_bplus(gv_read);
+    destroy_GenomeVcf_bplus(gv_index);
+  }
+  remove(sortedPath);
+  remove(gzPath);
+  remove(tbiPath);
+}
+
+static void _test_IndexFile() {
+  const char *filePath = "data/example.vcf";
+  const char *indexPath = "data/example.vcf.tmp" GENOMEVCF_INDEX_SUFFIX;
+  GenomeVcf_bplus *gv =
+      genomeVcf_bplus_loadFile((char *)filePath, 7, 6, NULL, 0, 1);
+  GenomeVcf_bplus *gv_compact =
+      genomeVcf_bplus_loadFileCompact((char *)filePath, 7, 6, NULL, 0, 1);
+  genomeVcf_bplus_writeFile(gv_compact, (char *)indexPath);
+  destroy_GenomeVcf_bplus(gv_compact);
+  // The index file is recognized by its magic
+  GenomeVcf_bplus *gv_index =
+      genomeVcf_bplus_loadFile((char *)indexPath, 7, 6, NULL, 0, 1);
+  assert(gv_index->mappedIndex != NULL);
+  char *sourcePath = realpath(filePath, NULL);
+  assert(strcmp(gv_index->filePath, sourcePath) == 0);
+  free(sourcePath);
+  assert(gv_cnt_rec(gv_index) == gv_cnt_rec(gv));
+  for (ChromVcf_bplus *cv = gv->chroms; cv != NULL; cv = cv->next) {
+    ChromVcf_bplus *cv_index = genomeVcf_bplus_getChromByContig(
+        gv_index, contigDict_id(gv_index->contigs, cv->name));
+    assert(cv_index != NULL && cv_index->index != NULL);
+    CursorVcf cursor = chromVcf_bplus_cursor(cv, 1);
+    CursorVcf cursor_index = chromVcf_bplus_cursor(cv_index, 1);
+    RecVcf_bplus *rv_index = cursor_index.rv;
+    for (RecVcf_bplus *rv = cursor.rv; rv != NULL;
+         rv = cursorVcf_next(&cursor)) {
+      assert(rv_index != NULL && rv_pos(rv_index) == rv_pos(rv));
+      assert(chromVcf_bplus_getRecAfterPos(cv_index, rv_pos(rv)) != NULL);
+      assert(strcmp(rv_ID(rv_index), rv_ID(rv)) == 0);
+      assert(rv_alleleCnt(rv_index) == rv_alleleCnt(rv));
+      for (int i = 0; i < rv_alleleCnt(rv); i++) {
+        assert(strcmp(rv_allele(rv_index, i), rv_allele(rv, i)) == 0);
+        assert(rv_alleleType(rv_index, i) == rv_alleleType(rv, i));
+      }
+      _check_testAlleleInfos(rv_index, rv);
+      bcf1_t *rec = genomeVcf_bplus_fetchRec(gv_index, rv_index);
+      assert(rec->pos + 1 == rv_pos(rv));
+      bcf_destroy1(rec);
+      rv_index = cursorVcf_next(&cursor_index);
+    }
+    assert(rv_index == NULL);
+  }
+  destroy_GenomeVcf_bplus(gv_index);
+  destroy_GenomeVcf_bplus(gv);
+  remove(indexPath);
+}
+
+/**
+ * @brief  Copy a file into a new file.
+ */
+static void _copy_testFile(const char *srcPath, const char *dstPath) {
+  remove(dstPath);
+  FILE *fp_in = fopen(srcPath, "rb");
+  FILE *fp_out = fopen(dstPath, "wb");
+  assert(fp_in != NULL && fp_out != NULL);
+  char buf[4096];
+  size_t size_read = 0;
+  while ((size_read = fread(buf, 1, sizeof(buf), fp_in)) > 0) {
+    fwrite(buf, 1, size_read, fp_out);
+  }
+  fclose(fp_in);
+  fclose(fp_out);
+}
+
+static void _test_IndexFileBeside() {
+  // A copy of the vcf file, with the index beside it
+  const char *filePath = "data/test_index.vcf.tmp";
+  const char *indexPath = "data/test_index.vcf.tmp" GENOMEVCF_INDEX_SUFFIX;
+  const char *copyPath = "data/test_copy.vcf.tmp";
+  const char *copyIndexPath = "data/test_copy.vcf.tmp" GENOMEVCF_INDEX_SUFFIX;
+  _copy_testFile("data/example.vcf", filePath);
+  GenomeVcf_bplus *gv =
+      genomeVcf_bplus_loadFileCompact((char *)filePath, 7, 6, NULL, 0, 1);
+  assert(gv->mappedIndex == NULL);
+  genomeVcf_bplus_writeFile(gv, (char *)indexPath);
+  destroy_GenomeVcf_bplus(gv);
+  // Used for compact records only, from any working directory
+  gv = genomeVcf_bplus_loadFile((char *)filePath, 7, 6, NULL, 0, 1);
+  assert(gv->mappedIndex == NULL && gv_cnt_rec(gv) == 7);
+  destroy_GenomeVcf_bplus(gv);
+  assert(chdir("data") == 0);
+  gv = genomeVcf_bplus_loadFileCompact("test_index.vcf.tmp", 7, 6, NULL, 0, 1);
+  assert(chdir("..") == 0);
+  assert(gv->mappedIndex != NULL && gv_cnt_rec(gv) == 7);
+  destroy_GenomeVcf_bplus(gv);
+  // Copies of the vcf file and the index are used together
+  _copy_testFile(filePath, copyPath);
+  _copy_testFile(indexPath, copyIndexPath);
+  gv = genomeVcf_bplus_loadFileCompact((char *)copyPath, 7, 6, NULL, 0, 1);
+  assert(gv->mappedIndex != NULL && gv_cnt_rec(gv) == 7);
+  assert(strcmp(gv->filePath, copyPath) == 0);
+  destroy_GenomeVcf_bplus(gv);
+  // A vcf file extracted again (new inode and modification time) is the same
+  _copy_testFile(copyPath, filePath);
+  gv = genomeVcf_bplus_loadIndexFile(indexPath);
+  assert(gv_cnt_rec(gv) == 7);
+  destroy_GenomeVcf_bplus(gv);
+  // Not used once the content is edited, even with the same size and the
+  // modification time restored
+  struct stat stat_file;
+  assert(stat(filePath, &stat_file) == 0);
+  FILE *fp = fopen(filePath, "r+b");
+  char buf[4096];
+  size_t size_read = fread(buf, 1, sizeof(buf) - 1, fp);
+  buf[size_read] = '\0';
+  char *id = strstr(buf, "PTV003");
+  assert(id != NULL);
+  fseek(fp, id - buf + 5, SEEK_SET);
+  fputc('4', fp);
+  fclose(fp);
+  struct timespec times[2] = {stat_file.st_atim, stat_file.st_mtim};
+  assert(utimensat(AT_FDCWD, filePath, times, 0) == 0);
+  gv = genomeVcf_bplus_loadFileCompact((char *)filePath, 7, 6, NULL, 0, 1);
+  assert(gv->mappedIndex == NULL && gv_cnt_rec(gv) == 7);
+  destroy_GenomeVcf_bplus(gv);
+  remove(indexPath);
+  remove(filePath);
+  remove(copyIndexPath);
+  remove(copyPath);
+}
+
+static void _test_ParallelLoading() {
+  // Threads asked for are capped, and at least one thread is used
+  assert(cnt_threadLoaderVcf(1) == 1 && cnt_threadLoaderVcf(0) == 1);
+  assert(cnt_threadLoaderVcf(1000) <= LOADER_MAX_THREADS_VCF);
+  // Several batches of each chromosome, and a chromosome not in the header
+  const char *filePath = "data/test.vcf.tmp";
+  FILE *fp = fopen(filePath, "w");
+  assert(fp != NULL);
+  fprintf(fp, "##fileformat=VCFv4.1\n");
+  fprintf(fp, "##contig=<ID=chr1>\n##contig=<ID=chr2>\n##contig=<ID=chr3>\n");
+  fprintf(fp, "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\n");
+  const char *contigs[] = {"chr2", "chr1", "chrU", "chr3"};
+  const int cnts_rec[] = {3 * SIZE_BATCH_VCF + 7, 1500, 10, 2 * SIZE_BATCH_VCF};
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < cnts_rec[i]; j++) {
+      // Every third record has the same POS as the last one
+      fprintf(fp, "%s\t%d\trec%d_%d\tA\t%s\t30\tPASS\t.\n", contigs[i],
+              100 + j - j / 3, i, j, j % 5 == 0 ? "." : "C,G");
+    }
+  }
+  fclose(fp);
+  const RegionVcf regions[] = {{"chr3", 1, 200}, {"chr2", 500, 1000}};
+  for (int ifCompact = 0; ifCompact < 2; ifCompact++) {
+    GenomeVcf_bplus *gv =
+        loadFileVcf((char *)filePath, 7, 6, NULL, 0, ifCompact, 1);
+    GenomeVcf_bplus *gv_threads =
+        loadFileVcf((char *)filePath, 7, 6, NULL, 0, ifCompact, 4);
+    _check_testSameGenome(gv, gv_threads);
+    // Records of all chromosomes are counted, without those with empty ALT
+    int cnt_rec = 0;
+    for (int i = 0; i < 4; i++) cnt_rec += cnts_rec[i] - (cnts_rec[i] + 4) / 5;
+    assert(gv_cnt_rec(gv_threads) == cnt_rec);
+    destroy_GenomeVcf_bplus(gv);
+    destroy_GenomeVcf_bplus(gv_threads);
+    // Records filtered by regions, as the file has no index
+    gv = loadFileVcf((char *)filePath, 7, 6, regions, 2, ifCompact, 1);
+    gv_threads = loadFileVcf((char *)filePath, 7, 6, regions, 2, ifCompact, 2);
+    _check_testSameGenome(gv, gv_threads);
+    assert(gv_cnt_rec(gv_threads) > 0 && gv_cnt_rec(gv_threads) < cnt_rec);
+    destroy_GenomeVcf_bplus(gv);
+    destroy_GenomeVcf_bplus(gv_threads);
+    // Records of an unsorted file
+    gv = loadFileVcf("data/example.vcf", 7, 6, NULL, 0, ifCompact, 1);
+    gv_threads = loadFileVcf("data/example.vcf", 7, 6, NULL, 0, ifCompact, 3);
+    _check_testSameGenome(gv, gv_threads);
+    destroy_GenomeVcf_bplus(gv);
+    destroy_GenomeVcf_bplus(gv_threads);
+  }
+  remove(filePath);
+}
+
+void _testSet_genomeVcf_bplus() {
+  assert(_test_BasicFunctions());
+  _test_BulkLoading(4, 3);
+  _test_BulkLoading(RANK_INNER_NODE_DEFAULT, RANK_LEAF_NODE_DEFAULT);
+  _test_MixedRanks();
+  _test_OverlapIndex(0);
+  _test_OverlapIndex(1);
+  _test_OverlapIndex(13);
+  _test_OverlapIndex(1000);
+  _test_CompactRecords();
+  _test_RegionLoading();
+  _test_IndexFile();
+  _test_IndexFileBeside();
+  _test_ParallelLoading();
+}
\ No newline at end of file
@@ -10,8 +10,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "contigDict.h"
 #include "debug.h"
 
+/*
+ * Suffix of the index file of a vcf file (see genomeVcf_bplus_writeFile).
+ * Version of the index file must be increased when its layout changes.
+ */
+#define GENOMEVCF_INDEX_SUFFIX ".gvi"
+#define GENOMEVCF_INDEX_VERSION 3
+
 /**
  * @brief  Rank for the inner nodes. For example, a tree with inner rank being 5
  * indicates that an inner node contains no more than "5" pointers to other
@@ -28,9 +36,17 @@ static int RANK_INNER_NODE = 5;
  */
 static int RANK_LEAF_NODE = 5;
 
+/**
+ * @brief  Ranks with keys of a node filling 2 cache lines of 64 bytes. Keys of
+ * a node are searched line by line, and thus ranks filling whole cache lines
+ * waste no comparisons.
+ */
+#define RANK_INNER_NODE_DEFAULT 17
+#define RANK_LEAF_NODE_DEFAULT 16
+
 /**
  * @brief  This key type uses the POS field of a vcf record. And thus any key
- * must satisfy condition (key >= 1).
+ * must satisfy condition (1 <= key < unavailable_keyValue).
  * Note that some vcf records have the same POS and thus the same key in the
  * bplus tree structure. We allow such cases to be valid, but store them all as
  * a single-linked-list. When you search for records with specified POS, it will
@@ -38,7 +54,7 @@ static int RANK_LEAF_NODE = 5;
  * all records.
  */
 typedef int64_t VcfBPlusKey;
-static const VcfBPlusKey unavailable_keyValue = 0;
+static const VcfBPlusKey unavailable_keyValue = INT64_MAX;
 
 typedef void *Pointer;
 
@@ -61,6 +77,44 @@ typedef struct ChromVcf_bplus ChromVcf_bplus;
  */
 typedef struct GenomeVcf_bplus GenomeVcf_bplus;
 
+/**
+ * @brief  Region of a contig, such as the area covered by reads. Only records
+ * overlapping such regions are loaded (see genomeVcf_bplus_loadFile).
+ */
+typedef struct _define_RegionVcf {
+  const char *contig;  // name of the contig; not a copy
+  int64_t beg;         // 1-based, included
+  int64_t end;         // 1-based, included
+} RegionVcf;
+
+/**
+ * @brief  Cursor of records of a chromosome in order of POS (see
+ * chromVcf_bplus_range). It keeps where the current record is, so moving to
+ * the next record takes no search.
+ */
+typedef struct _define_CursorVcf {
+  RecVcf_bplus *rv;    // current record; NULL if all records are visited
+  VcfBPlusNode *leaf;  // leaf keeping the head of rv; NULL for frozen chroms
+  int idx;             // index of the head of rv in the leaf
+  int64_t end;         // records with POS >= end are not visited
+} CursorVcf;
+
+/**
+ * @brief  Metadata of an allele of a vcf record, computed once when the record
+ * is loaded, so that hot paths need no strlen or type classification.
+ */
+typedef struct _define_AlleleInfoVcf {
+  int32_t length;        // length of the allele string
+  int32_t length_cover;  // see rv_alleleCoverLength
+  /*
+   * Max length of REF and the allele. The allele is taken as a SV if it is no
+   * less than the min length of SVs.
+   */
+  int32_t length_sv;
+  int32_t type;    // see rv_alleleType
+  int32_t offset;  // offset of the allele in strings of compact records
+} AlleleInfoVcf;
+
 /**********************************
  * Accessing data within structures
  **********************************/
@@ -72,6 +126,8 @@ extern int gv_cnt_rec(GenomeVcf_bplus *gv);
 
 /**
  * @brief  Get the pointer to the original data object within rv.
+ * @note   Compact records (see genomeVcf_bplus_loadFileCompact) keep no such
+ * object. Use genomeVcf_bplus_fetchRec for them.
  */
 extern bcf1_t *rv_object(RecVcf_bplus *rv);
 
@@ -85,6 +141,11 @@ extern const char *rv_ID(RecVcf_bplus *rv);
  */
 extern int64_t rv_pos(RecVcf_bplus *rv);
 
+/**
+ * @brief  Get the 1-based position of the last base covered by REF.
+ */
+extern int64_t rv_end(RecVcf_bplus *rv);
+
 /**
  * @brief  Return a copy of chrom name got from RecVcf object.
  * @retval chrom name.
@@ -97,6 +158,12 @@ extern const char *rv_chromName(RecVcf_bplus *rv, GenomeVcf_bplus *gv);
  */
 extern int rv_alleleCnt(RecVcf_bplus *rv);
 
+/**
+ * @brief  Get the type of the idx-th allele (VCF_REF, VCF_SNP, VCF_MNP ...).
+ * @retval same as bcf_get_variant_type
+ */
+extern int rv_alleleType(RecVcf_bplus *rv, int alleleIdx);
+
 /**
  * * @brief  Return the covered length of this allele.
  * There are several cases (REF ALT):
@@ -114,20 +181,25 @@ extern int rv_alleleCoverLength(RecVcf_bplus *rv, int alleleIdx);
  * */
 extern const char *rv_allele(RecVcf_bplus *rv, int alleleIdx);
 
+/**
+ * @brief  Get metadata of all alleles of the RecVcf object, REF first.
+ * @retval array of rv_alleleCnt(rv) infos. Do not free it.
+ */
+extern const AlleleInfoVcf *rv_alleleInfos(RecVcf_bplus *rv);
+
 void genomeVcf_bplus_printRec(GenomeVcf_bplus *gv, RecVcf_bplus *rv);
 
 /************************************
  *           Basic Structures
  ************************************/
 
-// TODO synchronize and iteration are not compatible
 /**
- * @brief  Functions as an iterator for all vcf records.
- * @retval pointer to the next RecVcf_bplus object. If there exists records that
- * have the same POS, return these records. Otherwise, return records that have
- * next bigger POS.
+ * @brief  Move the cursor to the next record, in constant time.
+ * @retval the next record (cursor->rv). If there exists records that have the
+ * same POS, return these records. Otherwise, return records that have next
+ * bigger POS. NULL if there are no more records within the range.
  */
-RecVcf_bplus *next_RecVcf_bplus(RecVcf_bplus *rv);
+RecVcf_bplus *cursorVcf_next(CursorVcf *cursor);
 
 /**
  * @brief  Initialize a GenomeVcf_bplus object with specified arguments for
@@ -168,18 +240,156 @@ void genomeVcf_bplus_removeRec(GenomeVcf_bplus *gv, RecVcf_bplus *rv);
 /**
  * @brief  Get records from genomeVcf object with input POS and chrom name.
  * @retval pointer to a vcf object with POS or the next bigger POS if there
- * exists no same records as input POS. Use "next_RecVcf_bplus" to get its next
- * record with the same POS or the next bigger POS.
+ * exists no same records as input POS. Use a cursor (see
+ * genomeVcf_bplus_range) to iterate records after it.
  */
 RecVcf_bplus *genomeVcf_bplus_getRecAfterPos(GenomeVcf_bplus *gv,
                                              const char *chromName,
                                              int64_t pos);
 
+/**
+ * @brief  Similar to genomeVcf_bplus_getRecAfterPos, but the chromosome has
+ * already been located (see genomeVcf_bplus_getChromByContig).
+ * @retval NULL if cv is NULL or there is no record after pos.
+ */
+RecVcf_bplus *chromVcf_bplus_getRecAfterPos(ChromVcf_bplus *cv, int64_t pos);
+
+/**
+ * @brief  Get a cursor of records with begin <= POS < end on a chromosome.
+ * @retval cursor at the first record within the range. Its rv is NULL if there
+ * is no record within the range or cv is NULL.
+ * @note   Cursors are invalidated by inserting records into the chromosome.
+ */
+CursorVcf chromVcf_bplus_range(ChromVcf_bplus *cv, int64_t begin, int64_t end);
+
+/**
+ * @brief  Same as chromVcf_bplus_range, but the chromosome is located by its
+ * name.
+ */
+CursorVcf genomeVcf_bplus_range(GenomeVcf_bplus *gv, const char *chromName,
+                                int64_t begin, int64_t end);
+
+/**
+ * @brief  Get a cursor of all records with POS >= pos on a chromosome.
+ */
+CursorVcf chromVcf_bplus_cursor(ChromVcf_bplus *cv, int64_t pos);
+
+/**
+ * @brief  Get the names of all contigs of the genomeVcf object. Contigs in the
+ * header come first, and thus the id of a contig equals to its rid.
+ */
+const ContigDict *genomeVcf_bplus_contigs(GenomeVcf_bplus *gv);
+
+/**
+ * @brief  Get the chromosome according to the id of its name in
+ * genomeVcf_bplus_contigs.
+ * @retval NULL if the id is invalid or there is no record on the chromosome.
+ */
+ChromVcf_bplus *genomeVcf_bplus_getChromByContig(GenomeVcf_bplus *gv,
+                                                 int32_t id_contig);
+
+/**
+ * @brief  Load records of a vcf file into a GenomeVcf_bplus object.
+ * @param  *regions: if not NULL, only records overlapping these regions are
+ * loaded. Records are then queried through the index of the file (.csi for bcf
+ * files, .tbi or .csi for bgzip compressed vcf files). Files without an index
+ * are read through, with records outside the regions skipped.
+ * @param  cnt_region: number of regions
+ * @param  cnt_thread: maximal number of threads parsing the file (e.g. the
+ * --threads option), which also caps the threads decompressing it. It is
+ * further capped by the number of cores and LOADER_MAX_THREADS_VCF.
+ * @note   If filePath is an index file, it is mapped instead (see
+ * genomeVcf_bplus_loadIndexFile), and regions are ignored. Records are then
+ * compact. The index beside the vcf file is not used automatically (see
+ * genomeVcf_bplus_loadFileCompact).
+ * @note   With cnt_thread > 1, files read through are decompressed and parsed
+ * by several threads, where records of different chromosomes are parsed and
+ * inserted into their trees at the same time.
+ */
 GenomeVcf_bplus *genomeVcf_bplus_loadFile(char *filePath, int rank_inner_node,
-                                          int rank_leaf_node);
+                                          int rank_leaf_node,
+                                          const RegionVcf *regions,
+                                          int cnt_region, int cnt_thread);
+
+/**
+ * @brief  Replace the bplus trees of all chromosomes with static indexes: POS
+ * of records are kept in sorted arrays in Eytzinger order. Lookups and
+ * iterations are faster, but records can no longer be inserted.
+ * @note   Use this after loading, if the genomeVcf object is only read.
+ */
+void genomeVcf_bplus_freeze(GenomeVcf_bplus *gv);
 
+/**
+ * @brief  Index areas [POS, POS+len(REF)-1] covered by records of all
+ * chromosomes, so that records overlapping a window can be found by
+ * chromVcf_bplus_getRecsOverlap. Chromosomes already indexed are skipped.
+ * @note   Records inserted afterwards are not indexed until this method is
+ * called again.
+ */
+void genomeVcf_bplus_indexOverlaps(GenomeVcf_bplus *gv);
+
+/**
+ * @brief  Get all records whose covered areas [POS, POS+len(REF)-1] overlap
+ * window [lbound, rbound], in order of POS. Records starting before lbound,
+ * such as long deletions, are included, and records not overlapping the window
+ * are not visited.
+ * @param  ***ret_rvs: buffer of records found. It is enlarged by realloc if its
+ * capacity is not enough, and can be reused for other queries.
+ * @param  *ret_capacity: capacity of the buffer
+ * @retval number of records found
+ * @note   The chromosome must have been indexed (see
+ * genomeVcf_bplus_indexOverlaps).
+ */
+int64_t chromVcf_bplus_getRecsOverlap(ChromVcf_bplus *cv, int64_t lbound,
+                                      int64_t rbound, RecVcf_bplus ***ret_rvs,
+                                      int64_t *ret_capacity);
+
+/**
+ * @brief  Similar to genomeVcf_bplus_loadFile, but each record only keeps its
+ * POS, ID, alleles and types of the alleles, in blocks of memory shared by all
+ * records, instead of a bcf1_t object with all fields unpacked.
+ * @note   If "filePath" + GENOMEVCF_INDEX_SUFFIX is an index file built from
+ * the current vcf file, the index file is mapped instead (see
+ * genomeVcf_bplus_loadIndexFile), and regions are ignored.
+ */
+GenomeVcf_bplus *genomeVcf_bplus_loadFileCompact(char *filePath,
+                                                 int rank_inner_node,
+                                                 int rank_leaf_node,
+                                                 const RegionVcf *regions,
+                                                 int cnt_region,
+                                                 int cnt_thread);
+
+/**
+ * @brief  Get a copy of the full vcf record. Compact records are read again
+ * from the vcf file (bgzip compressed or plain text). Offsets of compact
+ * records loaded through the index of the file are unknown, and such records
+ * cannot be fetched.
+ * @retval Must be freed later using bcf_destroy1.
+ */
+bcf1_t *genomeVcf_bplus_fetchRec(GenomeVcf_bplus *gv, RecVcf_bplus *rv);
+
+/**
+ * @brief  Write POS, ID and alleles of all records, and the keys of static
+ * indexes of all chromosomes, into a binary index file, which can be mapped
+ * into memory directly. The absolute path of the vcf file and a checksum of its
+ * whole content are kept in the index file, so that the index is not used once
+ * the vcf file is modified, while copies of the vcf file can still use it. The
+ * genomeVcf object is frozen (see genomeVcf_bplus_freeze).
+ * @note  The index file uses native byte order, so it should only be used on
+ * machines of the same architecture.
+ */
 void genomeVcf_bplus_writeFile(GenomeVcf_bplus *gv, char *filePath);
 
+/**
+ * @brief  Load a genomeVcf object from an index file (see
+ * genomeVcf_bplus_writeFile). The file is mapped read-only, so keys and
+ * strings of records are shared by all processes using the same index, and
+ * only the record objects are created. Records are compact and chromosomes are
+ * frozen. The header is read from the vcf file the index is built from. The
+ * mapping is released by destroy_GenomeVcf_bplus.
+ */
+GenomeVcf_bplus *genomeVcf_bplus_loadIndexFile(const char *filePath);
+
 /**********************************
  * Debugging Methods for GenomeVcf
  **********************************/
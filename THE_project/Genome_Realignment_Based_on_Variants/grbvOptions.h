@@ -41,9 +41,18 @@ static char *default_outputFile = "defaultOutput.txt";
 #define OPT_SET_MISMATCH 110
 #define OPT_SET_GAPOPEN 111
 #define OPT_SET_GAPEXTENSION 112
+#define OPT_SET_GAPOPEN2 113
+#define OPT_SET_GAPEXTENSION2 114
+#define OPT_SET_ALIGNCACHESIZE 115
+#define OPT_SET_REFCACHESIZE 116
+#define OPT_SET_COMPACTVCF 117
+#define OPT_SET_STATICVCF 118
+#define OPT_SET_REGIONVCF 119
 
 static const int default_sv_min_len = 51;
 static const int default_sv_max_len = 300;
+static const int default_alignCacheSize = 65536;
+static const int default_refCacheSize = 0;
 
 /*
  * Some simple operations against files.
@@ -52,6 +61,8 @@ static const int default_sv_max_len = 300;
 #define OPT_FIRSTLINES 202
 #define OPT_EXTRACTCHROM 203
 #define OPT_STATISTICS_VCF 204
+#define OPT_BUILDREFINDEX 205
+#define OPT_BUILDVCFINDEX 206
 
 /*
  * GRBV operations.
@@ -90,6 +101,14 @@ typedef struct _define_Options {
   int mismatch;
   int gapOpen;
   int gapExtension;
+  int gapOpen2;       // long gap penalties used when integrating SVs
+  int gapExtension2;  // (dual-affine alignment)
+
+  int alignCacheSize;  // maximal number of cached alignment results
+  int refCacheSize;    // maximal memory of decoded reference chroms (MB)
+  int compactVcf;      // keep only POS, ID and alleles of vcf records
+  int staticVcf;       // index vcf records with static sorted arrays
+  int regionVcf;       // load only vcf records around the reads
 
   int countRec;
   int firstLines;    // also store value of [firstline_number]
@@ -136,6 +155,17 @@ static inline int getMatch(Options *opts) { return opts->match; }
 static inline int getMismatch(Options *opts) { return opts->mismatch; }
 static inline int getGapopen(Options *opts) { return opts->gapOpen; }
 static inline int getGapextension(Options *opts) { return opts->gapExtension; }
+static inline int getGapopen2(Options *opts) { return opts->gapOpen2; }
+static inline int getGapextension2(Options *opts) {
+  return opts->gapExtension2;
+}
+static inline int getAlignCacheSize(Options *opts) {
+  return opts->alignCacheSize;
+}
+static inline int getRefCacheSize(Options *opts) { return opts->refCacheSize; }
+static inline int getCompactVcf(Options *opts) { return opts->compactVcf; }
+static inline int getStaticVcf(Options *opts) { return opts->staticVcf; }
+static inline int getRegionVcf(Options *opts) { return opts->regionVcf; }
 
 static inline int MAPQ_threshold(Options *opts) { return opts->selectBadReads; }
 
@@ -10,9 +10,42 @@ static char aux_appended_tag[3] = {'X', 'V', '\0'};
 static const int extension_lpart = 10;
 static const int extension_rpart = 10;
 
-static int integration_sv_min_len = 0;  // minimal length for a SV
-static int integration_sv_max_len = 0;  // maximal length for a SV
-static int integration_strategy = 0;
+// Number of decoded reference bases kept by each thread (see WindowFa)
+static const int64_t size_window_ref = 1 << 20;
+
+IntegrationContext *init_IntegrationContext(Options *opts) {
+  IntegrationContext *ic =
+      (IntegrationContext *)malloc(sizeof(IntegrationContext));
+  ic->strategy = opt_integration_strategy(opts);
+  ic->sv_min_len = getSVminLen(opts);
+  ic->sv_max_len = getSVmaxLen(opts);
+  ic->ac = init_AlignContext();
+  // Init alignment parameters
+  alignInitialize(getMatch(opts), getMismatch(opts), getGapopen(opts),
+                  getGapextension(opts), ic->ac);
+  // Init paramters for ksw2 specially. The band width here is only a fallback.
+  // Each combination uses its own band width (see ksw2_adaptiveBandWidth).
+  alignInitialize_ksw2(KSW2_DEFAULT_BANDWIDTH, KSW2_DEFAULT_ZDROP,
+                       KSW2_FLAG_RIGHTONLY, ic->ac);
+  // Long gap penalties for combinations containing SVs
+  alignInitialize_dualAffine(getGapopen2(opts), getGapextension2(opts), ic->ac);
+  // Cache for reads sharing the same sequence (duplicates, overlapping mates)
+  alignInitialize_cache(getAlignCacheSize(opts), ic->ac);
+  return ic;
+}
+
+IntegrationContext *copy_IntegrationContext(const IntegrationContext *ic) {
+  IntegrationContext *ic_copy =
+      (IntegrationContext *)malloc(sizeof(IntegrationContext));
+  *ic_copy = *ic;
+  ic_copy->ac = copy_AlignContext(ic->ac);
+  return ic_copy;
+}
+
+void destroy_IntegrationContext(IntegrationContext *ic) {
+  destroy_AlignContext(ic->ac);
+  free(ic);
+}
 
 /**
  * @brief  A method used to limit the time of the program in case that the
@@ -46,19 +79,16 @@ static bool ifContinueIntegration(int cnt_all, int cnt_selected) {
 }
 
 static inline int ifCanIntegrateAllele(RecVcf_bplus *rv, int alleleIdx,
-                                       int startPos, int endPos) {
+                                       int64_t startPos, int64_t endPos,
+                                       const IntegrationContext *ic) {
   // Ignore REF allele
   if (alleleIdx == 0) return 0;
-  const char *var_alt = rv_allele(rv, alleleIdx);
-  const char *var_ref = rv_allele(rv, 0);
-  int length_alt = strlen(var_alt);
-  int length_ref = strlen(var_ref);
+  const AlleleInfoVcf *infos = rv_alleleInfos(rv);
   int64_t varStartPos = rv_pos(rv);
-  int64_t varEndPos = varStartPos + length_ref - 1;
-  switch (integration_strategy) {
+  int64_t varEndPos = rv_end(rv);
+  switch (ic->strategy) {
     case _OPT_INTEGRATION_SNPONLY: {
-      if (length_alt >= integration_sv_min_len ||
-          length_ref >= integration_sv_min_len) {
+      if (infos[alleleIdx].length_sv >= ic->sv_min_len) {
         return 0;
       } else {
         // This is based on the assumption that varEndPos > varStartPoos
@@ -67,8 +97,7 @@ static inline int ifCanIntegrateAllele(RecVcf_bplus *rv, int alleleIdx,
       break;
     }
     case _OPT_INTEGRATION_SVONLY: {
-      if (length_alt < integration_sv_min_len &&
-          length_ref < integration_sv_min_len) {
+      if (infos[alleleIdx].length_sv < ic->sv_min_len) {
         return 0;
       } else {
         // This is based on the assumption that varEndPos > varStartPoos
@@ -89,13 +118,16 @@ static inline int ifCanIntegrateAllele(RecVcf_bplus *rv, int alleleIdx,
 }
 
 static inline int count_integrated_allele(RecVcf_bplus *rv, int64_t startPos,
-                                          int64_t endPos) {
+                                          int64_t endPos,
+                                          const IntegrationContext *ic) {
   // This is based on the assumption that varEndPos > varStartPoos
   int64_t varStartPos = rv_pos(rv);
+  int64_t varEndPos = rv_end(rv);
+  const AlleleInfoVcf *infos = rv_alleleInfos(rv);
   int cnt_integrated_allele = 0;
   // Calculate the affected length
   for (int i = 0; i < rv_alleleCnt(rv); i++) {
-    switch (bcf_get_variant_type(rv_object(rv), i)) {
+    switch (infos[i].type) {
       case VCF_REF: {
         break;
       }
@@ -107,27 +139,20 @@ static inline int count_integrated_allele(RecVcf_bplus *rv, int64_t startPos,
       case VCF_INDEL:
       case VCF_MNP:
       case VCF_OTHER: {
-        const char *var_ref = rv_allele(rv, 0);
-        const char *var_alt = rv_allele(rv, i);
-        int length_ref = strlen(var_ref);
-        int length_alt = strlen(var_alt);
-        int64_t varEndPos = varStartPos + length_ref - 1;
-        assert((var_alt[0] != '<') ||
+        assert((rv_allele(rv, i)[0] != '<') ||
                (fprintf(stderr,
                         "Error: variants with tags should be ignored when "
                         "loading.\n") < 0));
-        switch (integration_strategy) {
+        switch (ic->strategy) {
           case _OPT_INTEGRATION_SNPONLY: {
-            if (length_alt < integration_sv_min_len &&
-                length_ref < integration_sv_min_len) {
+            if (infos[i].length_sv < ic->sv_min_len) {
               if (varEndPos >= startPos && varStartPos <= endPos)
                 cnt_integrated_allele++;
             }
             break;
           }
           case _OPT_INTEGRATION_SVONLY: {
-            if (length_alt >= integration_sv_min_len ||
-                length_ref >= integration_sv_min_len) {
+            if (infos[i].length_sv >= ic->sv_min_len) {
               if (varEndPos >= startPos && varEndPos <= endPos)
                 cnt_integrated_allele++;
             }
@@ -160,8 +185,8 @@ static inline int count_integrated_allele(RecVcf_bplus *rv, int64_t startPos,
 static inline AlignResult *integration_integrate_lpart(
     Element_RecVcf *ervArray[], int ervCombi[], int alleleCombi[],
     int length_combi, int64_t lbound_var, int64_t lbound_M, RecSam *rec_rs,
-    GenomeFa *gf, GenomeSam *gs, GenomeVcf_bplus *gv, samFile *file_output,
-    int *ret_length_lpart_ref) {
+    WindowFa *wf_read, GenomeSam *gs, GenomeVcf_bplus *gv, samFile *file_output,
+    const IntegrationContext *ic, int *ret_length_lpart_ref) {
   // printf("lpart integration selected rv: \n");
   // for (int i = 0; i < length_combi; i++) {
   //   RecVcf_bplus *rv = ervArray[ervCombi[i]]->rv;
@@ -173,14 +198,16 @@ static inline AlignResult *integration_integrate_lpart(
   int64_t rbound_ref = lbound_M - 1;  // 1-based, included
   int64_t lbound_ref = lbound_var;
   int length_seq_ref = 0;
+  int length_indel = 0;  // used for band width of alignment
+  int ifContainSV = 0;   // use dual-affine alignment for SVs
   for (int i = 0; i < length_combi; i++) {
-    RecVcf_bplus *rv = ervArray[ervCombi[i]]->rv;
-    const char *allele_ref = rv_allele(rv, 0);
-    const char *allele_alt = rv_allele(rv, alleleCombi[i]);
-    // printf("allele_ref[%d]: %s, allele_alt[%d]: %s\n", i, allele_ref, i,
-    //        allele_alt);
-    int length_allele_ref = strlen(allele_ref);
-    int length_allele_alt = strlen(allele_alt);
+    const AlleleInfoVcf *infos = rv_alleleInfos(ervArray[ervCombi[i]]->rv);
+    int length_allele_ref = infos[0].length;
+    int length_allele_alt = infos[alleleCombi[i]].length;
+    length_indel += abs(length_allele_alt - length_allele_ref);
+    if (infos[alleleCombi[i]].length_sv >= ic->sv_min_len) {
+      ifContainSV = 1;
+    }
     if (length_allele_ref == length_allele_alt) {
       if (length_allele_ref == 1) {
         continue;
@@ -211,10 +238,8 @@ static inline AlignResult *integration_integrate_lpart(
   char buf_seq[length_seq_ref + 1];  // "+1" indicates '\0' at the end
   memset(buf_seq, 0, length_seq_ref + 1);
 
-  // Get original ref sequence
-  const char *rname_read = rsDataRname(gs, rec_rs);
-  ChromFa *tmp_cf = getChromFromGenomeFabyName(rname_read, gf);
-  char *original_seq_ref = getSeqFromChromFa(lbound_ref, rbound_ref, tmp_cf);
+  // Get original ref sequence, sliced from the window of the thread
+  const char *original_seq_ref = windowFa_seq(lbound_ref, rbound_ref, wf_read);
   // printf("ref seq got [%" PRId64 ",%" PRId64 "]: %s\n", lbound_ref,
   // rbound_ref,
   //        original_seq_ref);
@@ -225,12 +250,10 @@ static inline AlignResult *integration_integrate_lpart(
   for (int i = 0; i < length_combi; i++) {
     RecVcf_bplus *rv = ervArray[ervCombi[i]]->rv;
     int64_t pos_allele_start = rv_pos(rv);
-    const char *allele_ref = rv_allele(rv, 0);
     const char *allele_alt = rv_allele(rv, alleleCombi[i]);
-    // printf("allele_ref[%d]: %s, allele_alt[%d]: %s\n", i, allele_ref, i,
-    // allele_alt);
-    int length_allele_ref = strlen(allele_ref);
-    int length_allele_alt = strlen(allele_alt);
+    const AlleleInfoVcf *infos = rv_alleleInfos(rv);
+    int length_allele_ref = infos[0].length;
+    int length_allele_alt = infos[alleleCombi[i]].length;
     int idx_allele_ref = 0;
     int idx_allele_alt = 0;
     // Synchronize the positions of alleles before integration, especially when
@@ -288,33 +311,28 @@ static inline AlignResult *integration_integrate_lpart(
       tmp_pos_start_lpart += tmp_length;
     }
   }
-  int begin_subSeq = 0;
+  // The lpart of read is the prefix seq_read[0, pos_start_lpart - 2]:
   // lbound_M - 1 (move out of the M area) - 1 (array index)
-  int end_subSeq = pos_start_lpart - 2;
-  char *seq_read_lpart = subStr(seq_read, begin_subSeq, end_subSeq);
-  // printf("lpart begin: %d, end: %d\n", begin_subSeq, end_subSeq);
-  // printf("extracted lpart seq: %s\n", seq_read_lpart);
-  // seq_read_lpart can be NULL, which indicates that there is bases in lpart.
-  if (seq_read_lpart == NULL) {
+  int length_read_lpart = pos_start_lpart - 1;
+  // printf("lpart length: %d\n", length_read_lpart);
+  // No bases in lpart of the read.
+  if (length_read_lpart <= 0) {
     free(seq_read);
     // printf(">>>>>>>>>>>>>>>>>>>>>>>>>> empty lpart seq occurred. \n");
     return init_AlignResult();
   }
 
-  // Reverse ref seq and read seq lpart before alignment
-  char *seq_read_lpart_rev = revStr(seq_read_lpart, strlen(seq_read_lpart));
-  *ret_length_lpart_ref = strlen(buf_seq);
-  char *seq_ref_lpart_rev = revStr(buf_seq, *ret_length_lpart_ref);
-
-  // Align tseq and qseq using ksw2 global alignment
+  // Align the reversed ref seq and read seq lpart using ksw2 global alignment.
+  // Both sequences are read backwards in place rather than reversed copies.
+  *ret_length_lpart_ref = idx_seq_ref_new;
+  int length_tseq = idx_seq_ref_new;
+  int length_qseq = length_read_lpart;
+  int bandWidth =
+      ksw2_adaptiveBandWidth(length_tseq, length_qseq, length_indel);
   AlignResult *ar = init_AlignResult();
-  align_ksw2(seq_ref_lpart_rev, strlen(seq_ref_lpart_rev), seq_read_lpart_rev,
-             strlen(seq_read_lpart_rev), ar);
+  align_ksw2_reversed(buf_seq, length_tseq, seq_read, length_qseq, bandWidth,
+                      ifContainSV, ar, ic->ac);
 
-  free(seq_read_lpart_rev);
-  free(seq_ref_lpart_rev);
-
-  free(seq_read_lpart);
   free(seq_read);
 
   // printf("^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\n");
@@ -324,7 +342,8 @@ static inline AlignResult *integration_integrate_lpart(
 static inline AlignResult *integration_integrate_rpart(
     Element_RecVcf *ervArray[], int ervCombi[], int alleleCombi[],
     int length_combi, int64_t rbound_M, int64_t rbound_var, RecSam *rec_rs,
-    GenomeFa *gf, GenomeSam *gs, GenomeVcf_bplus *gv, samFile *file_output) {
+    WindowFa *wf_read, GenomeSam *gs, GenomeVcf_bplus *gv, samFile *file_output,
+    const IntegrationContext *ic) {
   // printf("rpart integration selected rv: \n");
   // for (int i = 0; i < length_combi; i++) {
   //   RecVcf_bplus *rv = ervArray[ervCombi[i]]->rv;
@@ -336,14 +355,16 @@ static inline AlignResult *integration_integrate_rpart(
   int64_t lbound_ref = rbound_M + 1;  // 1-based, included
   int64_t rbound_ref = rbound_var;    // 1-based, included
   int length_seq_ref = 0;
+  int length_indel = 0;  // used for band width of alignment
+  int ifContainSV = 0;   // use dual-affine alignment for SVs
   for (int i = 0; i < length_combi; i++) {
-    const char *allele_ref = rv_allele(ervArray[ervCombi[i]]->rv, 0);
-    const char *allele_alt =
-        rv_allele(ervArray[ervCombi[i]]->rv, alleleCombi[i]);
-    // printf("allele_ref[%d]: %s, allele_alt[%d]: %s\n", i, allele_ref, i,
-    //        allele_alt);
-    int length_allele_ref = strlen(allele_ref);
-    int length_allele_alt = strlen(allele_alt);
+    const AlleleInfoVcf *infos = rv_alleleInfos(ervArray[ervCombi[i]]->rv);
+    int length_allele_ref = infos[0].length;
+    int length_allele_alt = infos[alleleCombi[i]].length;
+    length_indel += abs(length_allele_alt - length_allele_ref);
+    if (infos[alleleCombi[i]].length_sv >= ic->sv_min_len) {
+      ifContainSV = 1;
+    }
     if (length_allele_alt == length_allele_ref) {
       if (length_allele_ref == 1) {
         continue;
@@ -407,10 +428,8 @@ static inline AlignResult *integration_integrate_rpart(
   char buf_seq[length_seq_ref + 1];  // "+1" indicates '\0' at the end
   memset(buf_seq, 0, length_seq_ref + 1);
 
-  // Get original ref sequence
-  const char *rname_read = rsDataRname(gs, rec_rs);
-  ChromFa *tmp_cf = getChromFromGenomeFabyName(rname_read, gf);
-  char *original_seq_ref = getSeqFromChromFa(lbound_ref, rbound_ref, tmp_cf);
+  // Get original ref sequence, sliced from the window of the thread
+  const char *original_seq_ref = windowFa_seq(lbound_ref, rbound_ref, wf_read);
   // printf("ref seq got [%" PRId64 ",%" PRId64 "]: %s\n", lbound_ref,
   // rbound_ref,
   //        original_seq_ref);
@@ -421,12 +440,10 @@ static inline AlignResult *integration_integrate_rpart(
   for (int i = 0; i < length_combi; i++) {
     RecVcf_bplus *rv = ervArray[ervCombi[i]]->rv;
     int64_t pos_allele_start = rv_pos(rv);
-    const char *allele_ref = rv_allele(rv, 0);
     const char *allele_alt = rv_allele(rv, alleleCombi[i]);
-    // printf("allele_ref[%d]: %s, allele_alt[%d]: %s\n", i, allele_ref, i,
-    //        allele_alt);
-    int length_allele_ref = strlen(allele_ref);
-    int length_allele_alt = strlen(allele_alt);
+    const AlleleInfoVcf *infos = rv_alleleInfos(rv);
+    int length_allele_ref = infos[0].length;
+    int length_allele_alt = infos[alleleCombi[i]].length;
     int idx_allele_ref = 0;
     int idx_allele_alt = 0;
     // Synchronize the positions of alleles before integration, especially when
@@ -500,9 +517,18 @@ static inline AlignResult *integration_integrate_rpart(
   }
 
   // Align tseq and qseq using ksw2 global alignment
+  int length_tseq = strlen(buf_seq);
+  int length_qseq = strlen(seq_read_rpart);
+  int bandWidth =
+      ksw2_adaptiveBandWidth(length_tseq, length_qseq, length_indel);
   AlignResult *ar = init_AlignResult();
-  align_ksw2(buf_seq, strlen(buf_seq), seq_read_rpart, strlen(seq_read_rpart),
-             ar);
+  if (ifContainSV) {
+    align_ksw2_dualAffine(buf_seq, length_tseq, seq_read_rpart, length_qseq,
+                          bandWidth, ar, ic->ac);
+  } else {
+    align_ksw2_banded(buf_seq, length_tseq, seq_read_rpart, length_qseq,
+                      bandWidth, ar, ic->ac);
+  }
 
   free(seq_read_rpart);
   free(seq_read);
@@ -517,18 +543,18 @@ static inline void integration_integrate(
     Element_RecVcf *ervArray_rpart[], int ervCombi_rpart[],
     int alleleCombi_rpart[], int length_combi_rpart, int length_ervArray_rpart,
     int64_t lbound_var, int64_t rbound_var, int64_t lbound_M, int64_t rbound_M,
-    RecSam *rec_rs, int64_t id_rec, GenomeFa *gf, GenomeSam *gs,
-    GenomeVcf_bplus *gv, samFile *file_output) {
+    RecSam *rec_rs, int64_t id_rec, WindowFa *wf_read, GenomeSam *gs,
+    GenomeVcf_bplus *gv, samFile *file_output, const IntegrationContext *ic) {
   // Integrate the left part
   int ret_length_lpart_ref = 0;
   AlignResult *ar_lpart = integration_integrate_lpart(
       ervArray_lpart, ervCombi_lpart, alleleCombi_lpart, length_combi_lpart,
-      lbound_var, lbound_M, rec_rs, gf, gs, gv, file_output,
+      lbound_var, lbound_M, rec_rs, wf_read, gs, gv, file_output, ic,
       &ret_length_lpart_ref);
   // Integrate the right part
   AlignResult *ar_rpart = integration_integrate_rpart(
       ervArray_rpart, ervCombi_rpart, alleleCombi_rpart, length_combi_rpart,
-      rbound_M, rbound_var, rec_rs, gf, gs, gv, file_output);
+      rbound_M, rbound_var, rec_rs, wf_read, gs, gv, file_output, ic);
 
   // Fix cigars: remove leftmost 'D' and rightmost 'D'
   // And calculate new POS for the alignment result
@@ -721,36 +747,48 @@ static inline void integration_integrate(
 /**
  * @brief  Find all variants that should be integrated into reference sequence
  * * [lbound, rbound]. Pack them in the form of an ervArray.
+ * @param  ifStartWithin: whether to skip records starting before lbound. For
+ * the rpart, such records cover the end of the M area. They are integrated by
+ * the lpart if they also reach its interval, and are otherwise ignored, so
+ * that no variant is integrated into both parts.
+ * @param  ***buf_rv: buffer of records overlapping the interval, reused by
+ * calls of the same thread (see chromVcf_bplus_getRecsOverlap)
  */
 static inline void integration_generate_ervArray(
-    int64_t lbound, int64_t rbound, const char *rname, GenomeVcf_bplus *gv,
+    int64_t lbound, int64_t rbound, bool ifStartWithin,
+    ChromVcf_bplus *cv_read, const IntegrationContext *ic,
+    RecVcf_bplus ***buf_rv, int64_t *capacity_buf_rv,
     Element_RecVcf ***ret_ervArray, int *ret_cnt_integrated_variants) {
   assert(lbound <= rbound);
   // printf("generated ervArray lbound: %" PRId64 ", rbound: %" PRId64 "\n",
   //        lbound, rbound);
   // ------- get all variants' combination within the interval -----
+  // Only records overlapping the interval are visited, including deletions
+  // that start before it unless ifStartWithin.
+  int64_t cnt_rv = chromVcf_bplus_getRecsOverlap(cv_read, lbound, rbound,
+                                                 buf_rv, capacity_buf_rv);
+  RecVcf_bplus **rvs = *buf_rv;
+  // Records are in order of POS
+  while (ifStartWithin && cnt_rv > 0 && rv_pos(rvs[0]) < lbound) {
+    rvs++;
+    cnt_rv--;
+  }
   // 1st loop - calculate number of vcf records that needs integration
   int cnt_integrated_variants = 0;
-  RecVcf_bplus *rv_tmp = genomeVcf_bplus_getRecAfterPos(gv, rname, lbound);
-  RecVcf_bplus *first_rv = rv_tmp;
-  while (rv_tmp != NULL) {
-    if (count_integrated_allele(rv_tmp, lbound, rbound) > 0) {
+  for (int64_t i = 0; i < cnt_rv; i++) {
+    if (count_integrated_allele(rvs[i], lbound, rbound, ic) > 0) {
       cnt_integrated_variants++;
-    } else {
-      if (rv_pos(rv_tmp) > rbound) {
-        break;
-      }
     }
-    rv_tmp = next_RecVcf_bplus(rv_tmp);
   }
   // 2nd loop - save pointers to vcf records that needs integration and
   // calculate number of alleles of each vcf record that needs integration.
   Element_RecVcf **ervArray = (Element_RecVcf **)calloc(
       cnt_integrated_variants, sizeof(Element_RecVcf *));
-  rv_tmp = first_rv;
   int idx_integrated_variants = 0;
-  while (rv_tmp != NULL) {
-    int cnt_integrated_allele = count_integrated_allele(rv_tmp, lbound, rbound);
+  for (int64_t i_rv = 0; i_rv < cnt_rv; i_rv++) {
+    RecVcf_bplus *rv_tmp = rvs[i_rv];
+    int cnt_integrated_allele =
+        count_integrated_allele(rv_tmp, lbound, rbound, ic);
     if (cnt_integrated_allele > 0) {
       // Find all alleles that needs integration on this vcf record
       ervArray[idx_integrated_variants] =
@@ -762,19 +800,14 @@ static inline void integration_generate_ervArray(
 
       int tmp_idx_allele = 0;
       for (int i = 0; i < rv_alleleCnt(rv_tmp); i++) {
-        if (ifCanIntegrateAllele(rv_tmp, i, lbound, rbound) == 1) {
+        if (ifCanIntegrateAllele(rv_tmp, i, lbound, rbound, ic) == 1) {
           ervArray[idx_integrated_variants]->alleleIdx[tmp_idx_allele] = i;
           ervArray[idx_integrated_variants]->alleleCnt++;
           tmp_idx_allele++;
         }
       }
       idx_integrated_variants++;
-    } else {
-      if (rv_pos(rv_tmp) > rbound) {
-        break;
-      }
     }
-    rv_tmp = next_RecVcf_bplus(rv_tmp);
   }
 
   // printf("rvArray: \n");
@@ -794,8 +827,8 @@ static inline void integration_select_and_integrate(
     Element_RecVcf *ervArray_lpart[], int length_ervArray_lpart,
     Element_RecVcf *ervArray_rpart[], int length_ervArray_rpart,
     int64_t lbound_var, int64_t rbound_var, int64_t lbound_M, int64_t rbound_M,
-    RecSam *rec_rs, int64_t id_rec, GenomeFa *gf, GenomeSam *gs,
-    GenomeVcf_bplus *gv, samFile *file_output) {
+    RecSam *rec_rs, int64_t id_rec, WindowFa *wf_read, GenomeSam *gs,
+    GenomeVcf_bplus *gv, samFile *file_output, const IntegrationContext *ic) {
   if (length_ervArray_lpart == 0) {
     // ------------------------ Process right part -----------------------
     int *ervIdxes_rpart = (int *)calloc(length_ervArray_rpart, sizeof(int));
@@ -826,7 +859,7 @@ static inline void integration_select_and_integrate(
                 NULL, NULL, NULL, 0, 0, ervArray_rpart, acbs_rpart->combi_rv,
                 acbs_rpart->combis_allele[n], acbs_rpart->length,
                 length_ervArray_rpart, lbound_var, rbound_var, lbound_M,
-                rbound_M, rec_rs, id_rec, gf, gs, gv, file_output);
+                rbound_M, rec_rs, id_rec, wf_read, gs, gv, file_output, ic);
           }
           for (int n = 0; n < acbs_rpart->cnt; n++) {
             free(acbs_rpart->combis_allele[n]);
@@ -876,7 +909,7 @@ static inline void integration_select_and_integrate(
                                     acbs_lpart->length, length_ervArray_lpart,
                                     NULL, NULL, NULL, 0, 0, lbound_var,
                                     rbound_var, lbound_M, rbound_M, rec_rs,
-                                    id_rec, gf, gs, gv, file_output);
+                                    id_rec, wf_read, gs, gv, file_output, ic);
             } else {
               // ----------------------- Process right part
               // ----------------------
@@ -913,8 +946,8 @@ static inline void integration_select_and_integrate(
                           length_ervArray_lpart, ervArray_rpart,
                           acbs_rpart->combi_rv, acbs_rpart->combis_allele[n],
                           acbs_rpart->length, length_ervArray_rpart, lbound_var,
-                          rbound_var, lbound_M, rbound_M, rec_rs, id_rec, gf,
-                          gs, gv, file_output);
+                          rbound_var, lbound_M, rbound_M, rec_rs, id_rec,
+                          wf_read, gs, gv, file_output, ic);
                     }
                     for (int n = 0; n < acbs_rpart->cnt; n++) {
                       free(acbs_rpart->combis_allele[n]);
@@ -950,12 +983,46 @@ static inline void integration_select_and_integrate(
   }
 }
 
+/**
+ * @brief  Get the right bound of the area of the reference covered by a read,
+ * including its soft clips, so that variants under the clipped bases are also
+ * integrated. The cigar is walked until 'P', 'N' or 'H', as reads containing
+ * them are ignored.
+ * @retval 1-based, included
+ */
+static int64_t integration_rboundOfRead(RecSam *rs) {
+  int64_t rbound_read = rsDataPos(rs) - 1;
+  uint32_t cnt_cigar = rs_cigar_cnt(rs);
+  for (int i = 0; i < cnt_cigar; i++) {
+    char cigar_opChar = rs_cigar_opChar(rs, i);
+    if (cigar_opChar == 'I') {
+      // rbound_read will not move on the reference in such case
+    } else if (cigar_opChar == 'P' || cigar_opChar == 'N' ||
+               cigar_opChar == 'H') {
+      break;
+    } else {  // For cigarOp 'MX=SD', move rbound_read on the reference
+      rbound_read += rs_cigar_oplen(rs, i);
+    }
+  }
+  return rbound_read;
+}
+
+/*
+ * Dictionaries in the ContigTable of integration_process.
+ */
+#define CONTIG_FA 0
+#define CONTIG_VCF 1
+#define CNT_CONTIG_DICT 2
+
 typedef struct _define_ThreadArgs {
-  int64_t id;  // identifier for the thread
-  Options *opts;
+  int64_t id;              // identifier for the thread
+  IntegrationContext *ic;  // private copy for the thread
+  const char *outputFile;
   GenomeFa *gf;
   GenomeSam *gs;
   GenomeVcf_bplus *gv;
+  // Ids of chroms in gf and gv, indexed by tids of the reads in gs
+  const ContigTable *ct;
   int64_t id_sam_start;  // index for sam record when the thread starts
   int64_t id_sam_end;    // index for sam record when the thread ends
 } ThreadArgs;
@@ -968,9 +1035,9 @@ void *integration_threads(void *args) {
          args_thread->id, args_thread->id_sam_start, args_thread->id_sam_end);
   // Execute integrations process
 
-  char path_outputFile[strlen(getOutputFile(args_thread->opts)) + 64];
-  sprintf(path_outputFile, "%s.thread%" PRId64 "",
-          getOutputFile(args_thread->opts), args_thread->id);
+  char path_outputFile[strlen(args_thread->outputFile) + 64];
+  sprintf(path_outputFile, "%s.thread%" PRId64 "", args_thread->outputFile,
+          args_thread->id);
 
   printf("output file name for thread (%" PRId64 "): %s\n", args_thread->id,
          path_outputFile);
@@ -994,12 +1061,24 @@ void *integration_threads(void *args) {
   GenomeFa *gf = args_thread->gf;
   GenomeSam *gs = args_thread->gs;
   GenomeVcf_bplus *gv = args_thread->gv;
+  const IntegrationContext *ic = args_thread->ic;
+  const ContigTable *ct = args_thread->ct;
 
   // Iterate all sam records and locate their corresponding variants.
   GenomeSamIterator *gsIt = init_GenomeSamIterator(gs);
   ChromSam *cs_tmp = gsItNextChrom(gsIt);
   RecSam *rs_tmp = gsItNextRec(gsIt);
 
+  // Chrom of the last read. Reads are sorted, so the chrom is got (and decoded
+  // if the reference genome is loaded on demand) only when it changes.
+  int32_t tid_cached = -1;
+  ChromFa *cf_cached = NULL;
+  // Decoded bases around the reads, shared by all combinations of variants
+  WindowFa *wf_ref = init_WindowFa(size_window_ref, GENOMEFA_ENCODING_CHAR);
+  // Records overlapping the area of a read
+  RecVcf_bplus **buf_rv = NULL;
+  int64_t capacity_buf_rv = 0;
+
   int64_t id_rec = 0;  // Id of record processed in this thread
   int64_t id_rec_start = args_thread->id_sam_start;  // included
   int64_t id_rec_end = args_thread->id_sam_end;      // included
@@ -1020,9 +1099,19 @@ void *integration_threads(void *args) {
       break;
     }
     // ---------- get information of temporary sam record ------------
-    const char *rname_read = rsDataRname(gs, rs_tmp);
+    const int32_t tid_read = rsDataTid(rs_tmp);
+    if (tid_read != tid_cached) {
+      genomeFa_releaseChrom(cf_cached, gf);
+      cf_cached = getChromFromGenomeFabyContig(
+          contigTable_id(ct, CONTIG_FA, tid_read), gf);
+      tid_cached = tid_read;
+      windowFa_setChrom(cf_cached, wf_ref);
+    }
+    ChromFa *cf_read = cf_cached;
+    ChromVcf_bplus *cv_read = genomeVcf_bplus_getChromByContig(
+        gv, contigTable_id(ct, CONTIG_VCF, tid_read));
     int64_t lbound_read = rsDataPos(rs_tmp);  // 1-based, included
-    int64_t rbound_read = lbound_read - 1;    // 1-based, included
+    int64_t rbound_read = integration_rboundOfRead(rs_tmp);
 
     // ------------- find the longest 'M' area in cigar --------------
     int64_t tmp_lbound = 1;
@@ -1039,17 +1128,15 @@ void *integration_threads(void *args) {
         }
       }
       if (cigar_opChar == 'D') {
-        rbound_read += tmp_length;
         tmp_lbound += tmp_length;
       } else if (cigar_opChar == 'I') {
-        // rbound_read will not move on the reference in such case
+        // tmp_lbound will not move on the reference in such case
       } else if (cigar_opChar == 'P' || cigar_opChar == 'N' ||
                  cigar_opChar == 'H') {
         // Ignore records containing 'P' and 'N'
         length_M_area = 0;
         break;
       } else {  // For cigarOp 'MX=S', move lbound_M_ref on the reference
-        rbound_read += tmp_length;
         tmp_lbound += tmp_length;
       }
     }
@@ -1066,8 +1153,8 @@ void *integration_threads(void *args) {
     //        length_M_area, lbound_M_ref, rbound_M_ref);
 
     // ----------- ignore reads as following in this program ---------
-    // empty rname, empty cigar, or no M_area
-    if (rname_read == NULL || length_M_area == 0) {
+    // empty rname (or not in the reference), empty cigar, or no M_area
+    if (cf_read == NULL || length_M_area == 0) {
       rs_tmp = gsItNextRec(gsIt);
       if (rs_tmp == NULL) {
         cs_tmp = gsItNextChrom(gsIt);
@@ -1081,14 +1168,14 @@ void *integration_threads(void *args) {
     // -------- get boundaries of area for selecting variants --------
     int64_t lbound_variant = 0;            // 1-based, included
     int64_t rbound_variant = rbound_read;  // 1-based, included
-    switch (opt_integration_strategy(args_thread->opts)) {
+    switch (ic->strategy) {
       case _OPT_INTEGRATION_SNPONLY: {
-        lbound_variant = lbound_read - integration_sv_min_len;
+        lbound_variant = lbound_read - ic->sv_min_len;
         break;
       }
       case _OPT_INTEGRATION_SVONLY:
       case _OPT_INTEGRATION_ALL: {
-        lbound_variant = lbound_read - integration_sv_max_len;
+        lbound_variant = lbound_read - ic->sv_max_len;
         break;
       }
       default: {
@@ -1108,11 +1195,13 @@ void *integration_threads(void *args) {
     int cnt_integrated_variants_lpart = 0;
     int cnt_integrated_variants_rpart = 0;
     // printf("L part generated ervArray - ");
-    integration_generate_ervArray(lbound_variant, lbound_M_ref, rname_read, gv,
+    integration_generate_ervArray(lbound_variant, lbound_M_ref, false, cv_read,
+                                  ic, &buf_rv, &capacity_buf_rv,
                                   &ervArray_lpart,
                                   &cnt_integrated_variants_lpart);
     // printf("R part generated ervArray - ");
-    integration_generate_ervArray(rbound_M_ref, rbound_variant, rname_read, gv,
+    integration_generate_ervArray(rbound_M_ref, rbound_variant, true, cv_read,
+                                  ic, &buf_rv, &capacity_buf_rv,
                                   &ervArray_rpart,
                                   &cnt_integrated_variants_rpart);
     // printf("erv(L): %d, erv(R): %d\n", cnt_integrated_variants_lpart,
@@ -1122,7 +1211,8 @@ void *integration_threads(void *args) {
     integration_select_and_integrate(
         ervArray_lpart, cnt_integrated_variants_lpart, ervArray_rpart,
         cnt_integrated_variants_rpart, lbound_variant, rbound_variant,
-        lbound_M_ref, rbound_M_ref, rs_tmp, id_rec, gf, gs, gv, file_output);
+        lbound_M_ref, rbound_M_ref, rs_tmp, id_rec, wf_ref, gs, gv,
+        file_output, ic);
 
     // ----------------------- free memories -------------------------
     for (int i = 0; i < cnt_integrated_variants_lpart; i++) {
@@ -1145,6 +1235,11 @@ void *integration_threads(void *args) {
     id_rec++;
   }
 
+  printf("thread (%" PRId64 ") decoded %" PRIu64 " reference bases\n",
+         args_thread->id, windowFa_decodedBases(wf_ref));
+  destroy_WindowFa(wf_ref);
+  free(buf_rv);
+  genomeFa_releaseChrom(cf_cached, gf);
   destroy_GenomeSamIterator(gsIt);
 
   sam_close(file_output);
@@ -1180,52 +1275,34 @@ void check_files_integration(Options *opts) {
   }
 }
 
-void integration(Options *opts) {
-  check_files_integration(opts);
-
-  // Init alignment parameters
-  alignInitialize(getMatch(opts), getMismatch(opts), getGapopen(opts),
-                  getGapextension(opts));
-  // Init paramters for ksw2 specially
-  alignInitialize_ksw2(KSW2_DEFAULT_BANDWIDTH, KSW2_DEFAULT_ZDROP,
-                       KSW2_FLAG_RIGHTONLY);
-  integration_strategy = opt_integration_strategy(opts);
-  integration_sv_min_len = getSVminLen(opts);
-  integration_sv_max_len = getSVmaxLen(opts);
-
+void integration_process(const IntegrationContext *ic, const char *outputFile,
+                         int cnt_thread, GenomeFa *gf, GenomeSam *gs,
+                         GenomeVcf_bplus *gv) {
   clock_t time_start = 0;
   clock_t time_end = 0;
-  // Init structures (data storage and access)
   time_start = clock();
-  GenomeFa *gf = genomeFa_loadFile(getFaFile(opts));
-  time_end = clock();
-  printf("... %s loaded. time: %fs\n", getFaFile(opts),
-         time_convert_clock2second(time_start, time_end));
-  time_start = clock();
-  GenomeSam *gs = init_GenomeSam();
-  loadGenomeSamFromFile(gs, getSamFile(opts));
-  time_end = clock();
-  printf("... %s loaded. time: %fs\n", getSamFile(opts),
-         time_convert_clock2second(time_start, time_end));
-  time_start = clock();
-  GenomeVcf_bplus *gv = genomeVcf_bplus_loadFile(getVcfFile(opts), 7, 6);
-  time_end = clock();
-  printf("... %s loaded. time: %fs\n", getVcfFile(opts),
-         time_convert_clock2second(time_start, time_end));
-
-  time_start = clock();
-  const int cnt_thread = opt_threads(opts) > 0 ? opt_threads(opts) : 1;
   const int64_t cnt_rec_sam = gsDataRecCnt(gs);
   pthread_t threads[cnt_thread];
   ThreadArgs args_thread[cnt_thread];
 
+  // Translate tids of reads into ids of chroms in gf and gv only once
+  const ContigDict *dicts[CNT_CONTIG_DICT];
+  dicts[CONTIG_FA] = genomeFa_contigs(gf);
+  dicts[CONTIG_VCF] = genomeVcf_bplus_contigs(gv);
+  ContigTable *ct = init_ContigTable(gsDataContigs(gs), dicts, CNT_CONTIG_DICT);
+  // Variants overlapping a read are found by the overlap index, wherever they
+  // start. Build it before threads share the genome.
+  genomeVcf_bplus_indexOverlaps(gv);
+
   // Assign arguments for threads
   for (int i = 0; i < cnt_thread; i++) {
     args_thread[i].id = i;
-    args_thread[i].opts = opts;
+    args_thread[i].ic = copy_IntegrationContext(ic);
+    args_thread[i].outputFile = outputFile;
     args_thread[i].gf = gf;
     args_thread[i].gs = gs;
     args_thread[i].gv = gv;
+    args_thread[i].ct = ct;
     args_thread[i].id_sam_start = (cnt_rec_sam / cnt_thread) * i;
   }
   for (int i = 0; i < cnt_thread - 1; i++) {
@@ -1251,10 +1328,115 @@ void integration(Options *opts) {
     void *thread_ret = 0;
     pthread_join(threads[i], &thread_ret);
     printf("thread (%" PRId64 ") ended\n", (int64_t)thread_ret);
+    destroy_IntegrationContext(args_thread[i].ic);
   }
+  destroy_ContigTable(ct);
   time_end = clock();
   printf("... integration finished. Total time: %fs\n",
          time_convert_clock2second(time_start, time_end));
+}
+
+/**
+ * @brief  Get regions of the reference covered by reads, extended by sv_max_len
+ * bases on the left (see lbound_variant in integration_threads) and by soft
+ * clips on the right (see integration_rboundOfRead). Regions of adjacent reads
+ * are merged.
+ * @retval Must be freed later. Names of contigs are kept by gs.
+ */
+static RegionVcf *integration_regionsOfReads(GenomeSam *gs, int sv_max_len,
+                                             int *ret_cnt_region) {
+  int cnt_region = 0;
+  int capacity_region = 16;
+  RegionVcf *regions =
+      (RegionVcf *)malloc(capacity_region * sizeof(RegionVcf));
+  int32_t tid_last = -1;
+  GenomeSamIterator *gsIt = init_GenomeSamIterator(gs);
+  gsItNextChrom(gsIt);
+  RecSam *rs_tmp = gsItNextRec(gsIt);
+  while (rs_tmp != NULL) {
+    const int32_t tid_read = rsDataTid(rs_tmp);
+    int64_t beg = (int64_t)rsDataPos(rs_tmp) - sv_max_len;
+    // Soft clips included, same as rbound_variant in integration_threads
+    int64_t end = integration_rboundOfRead(rs_tmp);  // 1-based, included
+    if (beg < 1) beg = 1;
+    if (tid_read < 0) {
+      // Unmapped read
+    } else if (cnt_region > 0 && tid_read == tid_last &&
+               beg <= regions[cnt_region - 1].end + 1) {
+      if (end > regions[cnt_region - 1].end) {
+        regions[cnt_region - 1].end = end;
+      }
+    } else {
+      if (cnt_region == capacity_region) {
+        capacity_region *= 2;
+        regions = (RegionVcf *)realloc(regions,
+                                       capacity_region * sizeof(RegionVcf));
+      }
+      regions[cnt_region].contig =
+          contigDict_name(gsDataContigs(gs), tid_read);
+      regions[cnt_region].beg = beg;
+      regions[cnt_region].end = end;
+      cnt_region++;
+      tid_last = tid_read;
+    }
+    rs_tmp = gsItNextRec(gsIt);
+    if (rs_tmp == NULL) {
+      gsItNextChrom(gsIt);
+      rs_tmp = gsItNextRec(gsIt);
+    }
+  }
+  destroy_GenomeSamIterator(gsIt);
+  *ret_cnt_region = cnt_region;
+  return regions;
+}
+
+void integration(Options *opts) {
+  check_files_integration(opts);
+
+  IntegrationContext *ic = init_IntegrationContext(opts);
+
+  clock_t time_start = 0;
+  clock_t time_end = 0;
+  // Init structures (data storage and access)
+  time_start = clock();
+  GenomeFa *gf = genomeFa_loadFileLazy(getFaFile(opts),
+                                       (uint64_t)getRefCacheSize(opts) << 20);
+  time_end = clock();
+  printf("... %s loaded. time: %fs\n", getFaFile(opts),
+         time_convert_clock2second(time_start, time_end));
+  time_start = clock();
+  GenomeSam *gs = init_GenomeSam();
+  loadGenomeSamFromFile(gs, getSamFile(opts));
+  time_end = clock();
+  printf("... %s loaded. time: %fs\n", getSamFile(opts),
+         time_convert_clock2second(time_start, time_end));
+  time_start = clock();
+  // Only variants around the reads are needed
+  RegionVcf *regions = NULL;
+  int cnt_region = 0;
+  if (getRegionVcf(opts)) {
+    regions = integration_regionsOfReads(gs, ic->sv_max_len, &cnt_region);
+  }
+  GenomeVcf_bplus *gv =
+      getCompactVcf(opts)
+          ? genomeVcf_bplus_loadFileCompact(
+                getVcfFile(opts), RANK_INNER_NODE_DEFAULT,
+                RANK_LEAF_NODE_DEFAULT, regions, cnt_region, opt_threads(opts))
+          : genomeVcf_bplus_loadFile(getVcfFile(opts), RANK_INNER_NODE_DEFAULT,
+                                     RANK_LEAF_NODE_DEFAULT, regions,
+                                     cnt_region, opt_threads(opts));
+  free(regions);
+  if (getStaticVcf(opts)) genomeVcf_bplus_freeze(gv);
+  time_end = clock();
+  printf("... %s loaded. time: %fs\n", getVcfFile(opts),
+         time_convert_clock2second(time_start, time_end));
+
+  const int cnt_thread = opt_threads(opts) > 0 ? opt_threads(opts) : 1;
+  integration_process(ic, getOutputFile(opts), cnt_thread, gf, gs, gv);
+  printf("... %" PRIu64 " bases of the reference genome decoded.\n",
+         genomeFa_decodedBases(gf));
+  alignDestroy_cache(ic->ac);
+  destroy_IntegrationContext(ic);
 
   // Free structures
 
@@ -18,6 +18,49 @@
 #include "genomeVcf_bPlus.h"
 #include "grbvOptions.h"
 
+/*
+ * Parameters of an integration process. Each thread works on its own copy, so
+ * several integrations with different parameters can run in one process.
+ */
+typedef struct _define_IntegrationContext {
+  int strategy;    // _OPT_INTEGRATION_SNPONLY/SVONLY/ALL
+  int sv_min_len;  // minimal length for a SV
+  int sv_max_len;  // maximal length for a SV
+  AlignContext* ac;
+} IntegrationContext;
+
+/**
+ * @brief  Create the context of integration from options, including the
+ * alignment context and its cache.
+ */
+IntegrationContext* init_IntegrationContext(Options* opts);
+
+/**
+ * @brief  Copy the context for another thread. The copy shares the alignment
+ * cache with the original one.
+ */
+IntegrationContext* copy_IntegrationContext(const IntegrationContext* ic);
+
+/**
+ * @brief  Destroy the context. The alignment cache is not destroyed (see
+ * alignDestroy_cache).
+ */
+void destroy_IntegrationContext(IntegrationContext* ic);
+
+/**
+ * @brief  Integrate vcf records into sam records with loaded genomes. The
+ * genomes are only read, so this method can be called several times with
+ * different contexts. Overlaps of vcf records are indexed at the first call
+ * (see genomeVcf_bplus_indexOverlaps).
+ * @param  *ic: context of integration
+ * @param  *outputFile: prefix of output files. Each thread writes into
+ * "<outputFile>.thread<id>"
+ * @param  cnt_thread: number of threads
+ */
+void integration_process(const IntegrationContext* ic, const char* outputFile,
+                         int cnt_thread, GenomeFa* gf, GenomeSam* gs,
+                         GenomeVcf_bplus* gv);
+
 /**
  * @brief  Final version of integrating vcf records into sam records.
  */
@@ -20,14 +20,10 @@ static inline bool check_kmer_valid(char *kmer) {
 }
 
 static inline bool ifCanIntegrateAllele(RecVcf_bplus *rv, int alleleIdx,
-                                        int32_t startPos, int32_t endPos) {
+                                        int64_t startPos, int64_t endPos) {
   if (alleleIdx == 0) return false;  // ignore REF allele
-  const char *var_alt = rv_allele(rv, alleleIdx);
-  const char *var_ref = rv_allele(rv, 0);
-  int length_alt = strlen(var_alt);
-  int length_ref = strlen(var_ref);
-  int32_t varStartPos = rv_pos(rv);
-  int32_t varEndPos = varStartPos + length_ref - 1;
+  int64_t varStartPos = rv_pos(rv);
+  int64_t varEndPos = rv_end(rv);
   if (varStartPos <= endPos && varEndPos >= startPos) {
     return true;
   } else {
@@ -43,8 +39,8 @@ static inline bool ifCanIntegrateAllele(RecVcf_bplus *rv, int alleleIdx,
  * @param  pos_start: 1-based start position of interval. included
  * @param  pos_end: 1-based end position of interval. included
  */
-static inline void generateKmers_process(int32_t id_chrom, int32_t pos_start,
-                                         int32_t pos_end, GenomeFa *gf,
+static inline void generateKmers_process(int32_t id_chrom, int64_t pos_start,
+                                         int64_t pos_end, GenomeFa *gf,
                                          GenomeVcf_bplus *gv, FILE *fp_op) {
   // -------- Expand the interval towards both sides by (kmerLength - 1) -------
   // Fixed interval will ignore kmers that don't have input char or output char
@@ -52,7 +48,7 @@ static inline void generateKmers_process(int32_t id_chrom, int32_t pos_start,
   clock_t time_end = 0;
   if (id_chrom < 1) return;
   ChromFa *chrom = getChromFromGenomeFabyIndex(id_chrom, gf);
-  int32_t length_chrom = chromFa_length(chrom);
+  int64_t length_chrom = chromFa_length(chrom);
   const char *name_chrom = chromFa_name(chrom);
   assert(length_chrom >= 0);
 
@@ -61,18 +57,20 @@ static inline void generateKmers_process(int32_t id_chrom, int32_t pos_start,
   pos_end = pos_end < length_chrom ? pos_end : length_chrom - 1;
 
   // Expanded interval (also ignore the kmers at the ends of the chrom)
-  int32_t lbound = pos_start - (kmerLength - 1);
+  int64_t lbound = pos_start - (kmerLength - 1);
   lbound = lbound > 1 ? lbound : 2;
-  int32_t rbound = pos_end + (kmerLength - 1);
+  int64_t rbound = pos_end + (kmerLength - 1);
   rbound = rbound < length_chrom ? rbound : length_chrom - 1;
 
   // ------------------------ Create hash table for kmers ----------------------
   // Maybe a larger size of the table would be better, but this one can do
-  int32_t tableSize = (rbound - lbound) * 2;
-  // printf("length chrom: %" PRId32 "\n", length_chrom);
-  // printf("lbound: %" PRId32 ", rbound: %" PRId32 "\n", lbound, rbound);
-  // printf("hash table size: %" PRId32 "\n", tableSize);
-  KmerHashTable *hashTable = init_kmerHashTable(tableSize, kmerLength);
+  int64_t tableSize = (rbound - lbound) * 2;
+  if (tableSize > INT32_MAX) tableSize = INT32_MAX;
+  // printf("length chrom: %" PRId64 "\n", length_chrom);
+  // printf("lbound: %" PRId64 ", rbound: %" PRId64 "\n", lbound, rbound);
+  // printf("hash table size: %" PRId64 "\n", tableSize);
+  KmerHashTable *hashTable =
+      init_kmerHashTable((int32_t)tableSize, kmerLength);
 
   // -------------------- Save original kmers into hash table ------------------
   // time_start = clock();
@@ -83,9 +81,9 @@ static inline void generateKmers_process(int32_t id_chrom, int32_t pos_start,
   //        time_convert_clock2second(time_start, time_end));
 
   // time_start = clock();
-  int32_t tmp_offset = 0;
+  int64_t tmp_offset = 0;
   while (lbound + tmp_offset <= pos_end) {
-    int32_t local_lbound = lbound + tmp_offset;
+    int64_t local_lbound = lbound + tmp_offset;
     char inputChar = charOfBase(getBase(chrom, local_lbound - 1));
     char outputChar = charOfBase(getBase(chrom, local_lbound + kmerLength));
     char *kmer = subStr_fast(seq_ref, len_seq_ref, tmp_offset,
@@ -107,23 +105,24 @@ static inline void generateKmers_process(int32_t id_chrom, int32_t pos_start,
 
   // ------------- Find all inter-variant kmers within the interval ------------
 
-  RecVcf_bplus *rv_tmp =
-      genomeVcf_bplus_getRecAfterPos(gv, name_chrom, pos_start);
+  CursorVcf cursor =
+      genomeVcf_bplus_range(gv, name_chrom, pos_start, INT64_MAX);
+  RecVcf_bplus *rv_tmp = cursor.rv;
   while (rv_tmp != NULL) {
     int cnt_integrated_allele = 0;
     // Check the varaint and find its inter-variant kmers
     for (int i = 0; i < rv_alleleCnt(rv_tmp); i++) {
       if (ifCanIntegrateAllele(rv_tmp, i, pos_start, pos_end) == true) {
         // genomeVcf_bplus_printRec(gv, rv_tmp);
-        int32_t pos_var = rv_pos(rv_tmp);
-        const char *allele_ref = rv_allele(rv_tmp, 0);
+        int64_t pos_var = rv_pos(rv_tmp);
         const char *allele_alt = rv_allele(rv_tmp, i);
-        const int length_ref = strlen(allele_ref);
-        const int length_alt = strlen(allele_alt);
+        const AlleleInfoVcf *infos = rv_alleleInfos(rv_tmp);
+        const int length_ref = infos[0].length;
+        const int length_alt = infos[i].length;
 
         // Divide the (l, m, r) parts and find all kmers within the interval
         // Extract (k+2) mer instead of kmer
-        int32_t pos_kmer = pos_var - (kmerLength + 2 - 1);
+        int64_t pos_kmer = pos_var - (kmerLength + 2 - 1);
         pos_kmer = pos_kmer >= 1 ? pos_kmer : 1;
         int32_t local_pos_alt = 0;  // 0-based pos in ALT
         while (pos_kmer != pos_var || local_pos_alt < length_alt) {
@@ -134,13 +133,12 @@ static inline void generateKmers_process(int32_t id_chrom, int32_t pos_start,
           int idx_buf = 0;
           // Construct a single kmer that has an lpart
           // ----------------- lpart
-          char *lpart = getSeqFromChromFa(pos_kmer, pos_var - 1, chrom);
+          int64_t length_lpart =
+              getSeqIntoBuf(chrom, pos_kmer, pos_var - 1, buf_kmer,
+                            GENOMEFA_ENCODING_CHAR);
           idx_buf = idx_buf + pos_var - pos_kmer;
-          if (lpart != NULL) {  // lpart exists
-            strcat(buf_kmer, lpart);
-          }
           // ----------------- midpart
-          int32_t pos_ref = 0;  // position of base on the reference sequence
+          int64_t pos_ref = 0;  // position of base on the reference sequence
           int idx_alt = 0;
           // Extract bases within ALT
           while (idx_buf < kmerLength + 2 &&
@@ -153,8 +151,12 @@ static inline void generateKmers_process(int32_t id_chrom, int32_t pos_start,
 
           // ----------------- rpart
           // Extract bases after REF
-          while (idx_buf < kmerLength + 2 && pos_ref <= length_chrom) {
-            buf_kmer[idx_buf++] = charOfBase(getBase(chrom, pos_ref++));
+          if (idx_buf < kmerLength + 2 && pos_ref <= length_chrom) {
+            int64_t end_rpart = pos_ref + (kmerLength + 2 - idx_buf) - 1;
+            if (end_rpart > length_chrom) end_rpart = length_chrom;
+            idx_buf += getSeqIntoBuf(chrom, pos_ref, end_rpart,
+                                     buf_kmer + idx_buf,
+                                     GENOMEFA_ENCODING_CHAR);
           }
 
           // Add kmer into hash table
@@ -164,7 +166,7 @@ static inline void generateKmers_process(int32_t id_chrom, int32_t pos_start,
           char *kmer = subStr(buf_kmer, 1, (kmerLength + 2) - 1 - 1);
           inputChar = buf_kmer[0];
           outputChar = buf_kmer[kmerLength + 2 - 1];
-          int32_t pos_abs = genomeFa_absolutePos(id_chrom, pos_kmer + 1, gf);
+          int64_t pos_abs = genomeFa_absolutePos(id_chrom, pos_kmer + 1, gf);
           if (check_kmer_valid(kmer) && inputChar != '\0' &&
               outputChar != '\0') {
             // printf(
@@ -178,11 +180,9 @@ static inline void generateKmers_process(int32_t id_chrom, int32_t pos_start,
           if (pos_kmer == pos_var) {
             local_pos_alt++;
           }
-          if (lpart != NULL) {
+          if (length_lpart > 0) {
             pos_kmer++;
           }
-
-          free(lpart);
         }
         cnt_integrated_allele++;
       }
@@ -196,7 +196,7 @@ static inline void generateKmers_process(int32_t id_chrom, int32_t pos_start,
         break;
       }
     }
-    rv_tmp = next_RecVcf_bplus(rv_tmp);
+    rv_tmp = cursorVcf_next(&cursor);
   }
 
   // statistics_kmerHashTable(hashTable);
@@ -205,7 +205,7 @@ static inline void generateKmers_process(int32_t id_chrom, int32_t pos_start,
   Iterator_Kmerhash *it = init_iterator_Kmerhash(hashTable);
 
   while (iterator_Kmerhash_next(it) != false) {
-    fprintf(fp_op, "[%" PRId32 " %" PRId32 " %s %c %c ]\n", id_chrom,
+    fprintf(fp_op, "[%" PRId32 " %" PRId64 " %s %c %c ]\n", id_chrom,
             iterator_Kmerhash_pos(it), iterator_Kmerhash_string(it),
             iterator_KmerHash_inputChar(it), iterator_KmerHash_outputChar(it));
   }
@@ -214,6 +214,7 @@ static inline void generateKmers_process(int32_t id_chrom, int32_t pos_start,
 
   // ----------------------------- free structures -----------------------------
   destroy_kmerHashTable(hashTable);
+  genomeFa_releaseChrom(chrom, gf);
 
   return;
 }
@@ -258,12 +259,21 @@ void generateKmers(Options *opts) {
   clock_t time_end = 0;
   // Init structures (data storage and access)
   time_start = clock();
-  GenomeFa *gf = genomeFa_loadFile(getFaFile(opts));
+  GenomeFa *gf = genomeFa_loadFileLazy(getFaFile(opts),
+                                       (uint64_t)getRefCacheSize(opts) << 20);
   time_end = clock();
   printf("... %s loaded. time: %fs\n", getFaFile(opts),
          time_convert_clock2second(time_start, time_end));
   time_start = clock();
-  GenomeVcf_bplus *gv = genomeVcf_bplus_loadFile(getVcfFile(opts), 7, 6);
+  GenomeVcf_bplus *gv =
+      getCompactVcf(opts)
+          ? genomeVcf_bplus_loadFileCompact(
+                getVcfFile(opts), RANK_INNER_NODE_DEFAULT,
+                RANK_LEAF_NODE_DEFAULT, NULL, 0, opt_threads(opts))
+          : genomeVcf_bplus_loadFile(getVcfFile(opts), RANK_INNER_NODE_DEFAULT,
+                                     RANK_LEAF_NODE_DEFAULT, NULL, 0,
+                                     opt_threads(opts));
+  if (getStaticVcf(opts)) genomeVcf_bplus_freeze(gv);
   time_end = clock();
   printf("... %s loaded. time: %fs\n", getVcfFile(opts),
          time_convert_clock2second(time_start, time_end));
@@ -282,19 +292,21 @@ void generateKmers(Options *opts) {
   }
 
   uint32_t id_chrom = 0;
-  uint32_t pos_start = 0;
-  uint32_t pos_end = 0;
-  while (fscanf(fp_aux, "[%" PRIu32 ",%" PRIu32 ",%" PRIu32 "]\n", &id_chrom,
+  int64_t pos_start = 0;
+  int64_t pos_end = 0;
+  while (fscanf(fp_aux, "[%" SCNu32 ",%" SCNd64 ",%" SCNd64 "]\n", &id_chrom,
                 &pos_start, &pos_end) == 3) {
-    printf("processing aux record: [%" PRIu32 ",%" PRIu32 ",%" PRIu32 "]\n",
+    printf("processing aux record: [%" PRIu32 ",%" PRId64 ",%" PRId64 "]\n",
            id_chrom, pos_start, pos_end);
-    // fprintf(fp_op, "# [%" PRIu32 ",%" PRIu32 ",%" PRIu32 "]\n", id_chrom,
+    // fprintf(fp_op, "# [%" PRIu32 ",%" PRId64 ",%" PRId64 "]\n", id_chrom,
     //         pos_start, pos_end);
     generateKmers_process(id_chrom, pos_start, pos_end, gf, gv, fp_op);
   }
 
   fclose(fp_op);
   fclose(fp_aux);
+  printf("... %" PRIu64 " bases of the reference genome decoded.\n",
+         genomeFa_decodedBases(gf));
 
   // Free structures
 
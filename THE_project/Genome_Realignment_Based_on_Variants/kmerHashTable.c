@@ -6,10 +6,12 @@
 
 struct KmerHashCell {
   char *kmerString;
-  int32_t kmerPos;
+  KmerHashCell *next;  // pointer to the next cell who has the same hash value
+  // 48 bits hold absolute positions of any genome (up to 2^47 bases) while
+  // keeping the cell as small as it was with 32-bit positions.
+  int64_t kmerPos : 48;
   char inputChar;
   char outputChar;
-  KmerHashCell *next;  // pointer to the next cell who has the same hash value
 };
 
 struct KmerHashTable {
@@ -29,7 +31,7 @@ inline char *kmerHashCell_string(KmerHashCell *cell) {
   return strdup(cell->kmerString);
 }
 
-inline int32_t kmerHashCell_pos(KmerHashCell *cell) { return cell->kmerPos; }
+inline int64_t kmerHashCell_pos(KmerHashCell *cell) { return cell->kmerPos; }
 
 inline char kmerHashCell_inputChar(KmerHashCell *cell) {
   return cell->inputChar;
@@ -68,7 +70,7 @@ static char *randomKmer(int32_t length, char *ret_inputChar,
   return kmer;
 }
 
-static inline int32_t hashCode(char *kmer, int32_t pos, char inputChar,
+static inline int32_t hashCode(char *kmer, int64_t pos, char inputChar,
                                char outputChar, KmerHashTable *table) {
   // TODO try to improve its performance
   static const int32_t hashSeed = 131;
@@ -78,19 +80,19 @@ static inline int32_t hashCode(char *kmer, int32_t pos, char inputChar,
     value += inputChar;
     kmer++;
   }
-  value = value + pos;
+  value = value + (int32_t)(pos ^ (pos >> 32));
   value = value + (value >> 16 + value << 16);
   value += outputChar;
   value = value & INT32_MAX;
   return value >= 0 ? value : -value;
 }
 
-static int32_t hashIndex(char *kmer, int32_t pos, char inputChar,
+static int32_t hashIndex(char *kmer, int64_t pos, char inputChar,
                          char outputChar, KmerHashTable *table) {
   return hashCode(kmer, pos, inputChar, outputChar, table) % table->tableSize;
 }
 
-static inline KmerHashCell *init_KmerHashCell(char *kmer, int32_t pos,
+static inline KmerHashCell *init_KmerHashCell(char *kmer, int64_t pos,
                                               char inputChar, char outputChar) {
   KmerHashCell *cell = (KmerHashCell *)malloc(sizeof(KmerHashCell));
   if (cell == NULL) {
@@ -106,7 +108,7 @@ static inline KmerHashCell *init_KmerHashCell(char *kmer, int32_t pos,
 }
 
 static inline bool kmerHashCell_equal(KmerHashCell *cell, char *kmer,
-                                      int32_t pos, char inputChar,
+                                      int64_t pos, char inputChar,
                                       char outputChar) {
   bool condition1 = strcmp(kmer, cell->kmerString) == 0 ? true : false;
   bool condition2 = pos == cell->kmerPos ? true : false;
@@ -158,7 +160,7 @@ char *iterator_Kmerhash_string(Iterator_Kmerhash *it) {
   }
 }
 
-int32_t iterator_Kmerhash_pos(Iterator_Kmerhash *it) {
+int64_t iterator_Kmerhash_pos(Iterator_Kmerhash *it) {
   if (it->cellIdx < it->table->tableSize) {
     KmerHashCell *cell = it->table->cellList[it->cellIdx];
     int lineSize = it->table->lineSize[it->cellIdx];
@@ -262,7 +264,7 @@ KmerHashTable *init_kmerHashTable(int32_t tableSize, int32_t kmerLength) {
   hashTable->tableSize = tableSize;
   hashTable->lineSize = (int8_t *)calloc(tableSize, sizeof(int8_t));
   hashTable->cellList =
-      (KmerHashCell **)calloc(tableSize, sizeof(KmerHashCell));
+      (KmerHashCell **)calloc(tableSize, sizeof(KmerHashCell *));
   if (hashTable->cellList == NULL || hashTable->lineSize == NULL) {
     fprintf(stderr,
             "Error: no enough memory for a kmer-hash-table of size: %" PRId32
@@ -281,10 +283,11 @@ void destroy_kmerHashTable(KmerHashTable *table) {
     }
   }
   free(table->lineSize);
+  free(table->cellList);
   free(table);
 }
 
-bool kmerHashTable_add(char *kmer, int32_t pos, char inputChar, char outputChar,
+bool kmerHashTable_add(char *kmer, int64_t pos, char inputChar, char outputChar,
                        KmerHashTable *table) {
   if (strlen(kmer) != table->kmerLength) {
     // fprintf(stderr,
@@ -315,7 +318,7 @@ bool kmerHashTable_add(char *kmer, int32_t pos, char inputChar, char outputChar,
   return true;
 }
 
-bool kmerHashTable_exist(char *kmer, int32_t pos, char inputChar,
+bool kmerHashTable_exist(char *kmer, int64_t pos, char inputChar,
                          char outputChar, KmerHashTable *table) {
   int32_t index = hashIndex(kmer, pos, inputChar, outputChar, table);
   KmerHashCell *cell = table->cellList[index];
@@ -347,8 +350,8 @@ void print_kmerHashTable(KmerHashTable *table) {
     KmerHashCell *cell = table->cellList[i];
     printf("[%" PRId8 "]", table->lineSize[i]);
     while (cell != NULL) {
-      printf("-> (%s,%" PRId32 ",%c,%c)", cell->kmerString, cell->kmerPos,
-             cell->inputChar, cell->outputChar);
+      printf("-> (%s,%" PRId64 ",%c,%c)", cell->kmerString,
+             (int64_t)cell->kmerPos, cell->inputChar, cell->outputChar);
       cell = cell->next;
     }
     printf("\n");
@@ -392,6 +395,14 @@ int _testSet_hashTable() {
     free(kmer);
   }
 
+  // Absolute positions beyond 32 bits (genomes larger than 4 Gbp)
+  char kmer_large[] = "ACGTACGTACGTACGTACGTAC";
+  int64_t pos_large = ((int64_t)1 << 34) + 7;
+  assert(kmerHashTable_add(kmer_large, pos_large, 'A', 'C', table) == true);
+  assert(kmerHashTable_exist(kmer_large, pos_large, 'A', 'C', table) == true);
+  assert(kmerHashTable_exist(kmer_large, pos_large - ((int64_t)1 << 32), 'A',
+                             'C', table) == false);
+
   Iterator_Kmerhash *it = init_iterator_Kmerhash(table);
 
   // while (iterator_Kmerhash_next(it) != false) {
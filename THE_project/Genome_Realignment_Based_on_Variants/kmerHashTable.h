@@ -8,6 +8,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "debug.h"
+
 /*********************************************************************
  *                         Structures and Accessors
  ********************************************************************/
@@ -20,7 +22,7 @@ typedef struct Iterator_Kmerhash Iterator_Kmerhash;
 
 extern char *kmerHashCell_string(KmerHashCell *cell);
 
-extern int32_t kmerHashCell_pos(KmerHashCell *cell);
+extern int64_t kmerHashCell_pos(KmerHashCell *cell);
 
 extern char kmerHashCell_inputChar(KmerHashCell *cell);
 
@@ -42,7 +44,7 @@ char *iterator_Kmerhash_string(Iterator_Kmerhash *it);
 /**
  * @brief  Get temporary position of the kmer
  */
-int32_t iterator_Kmerhash_pos(Iterator_Kmerhash *it);
+int64_t iterator_Kmerhash_pos(Iterator_Kmerhash *it);
 
 /**
  * @brief  Get the input char of the kmer
@@ -76,7 +78,7 @@ void destroy_kmerHashTable(KmerHashTable *table);
  * @param  outputChar: output char of the kmer
  * @retval true if succeeded; false if there exists identical kmer
  */
-bool kmerHashTable_add(char *kmer, int32_t pos, char inputChar, char outputChar,
+bool kmerHashTable_add(char *kmer, int64_t pos, char inputChar, char outputChar,
                        KmerHashTable *table);
 
 /**
@@ -87,7 +89,7 @@ bool kmerHashTable_add(char *kmer, int32_t pos, char inputChar, char outputChar,
  * @param  outputChar: output char of the kmer
  * @retval true if exists the same kmer; false otherwise
  */
-bool kmerHashTable_exist(char *kmer, int32_t pos, char inputChar,
+bool kmerHashTable_exist(char *kmer, int64_t pos, char inputChar,
                          char outputChar, KmerHashTable *table);
 
 /*********************************************************************
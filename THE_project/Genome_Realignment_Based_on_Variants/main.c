@@ -11,10 +11,13 @@
 #include <stdlib.h>
 #include <time.h>
 
+#include "alignCache.h"
 #include "alignment.h"
 #include "auxiliaryMethods.h"
+#include "contigDict.h"
 #include "genomeFa.h"
 #include "genomeSam.h"
+#include "genomeVcf_bPlus.h"
 #include "grbvOperations.h"
 #include "grbvOptions.h"
 #include "integrateVcfToSam.h"
@@ -38,11 +41,20 @@ static struct option optInitArray[] = {
     {"mismatch", required_argument, NULL, OPT_SET_MISMATCH},
     {"gapOpen", required_argument, NULL, OPT_SET_GAPOPEN},
     {"gapExtension", required_argument, NULL, OPT_SET_GAPEXTENSION},
+    {"gapOpen2", required_argument, NULL, OPT_SET_GAPOPEN2},
+    {"gapExtension2", required_argument, NULL, OPT_SET_GAPEXTENSION2},
+    {"alignCacheSize", required_argument, NULL, OPT_SET_ALIGNCACHESIZE},
+    {"refCacheSize", required_argument, NULL, OPT_SET_REFCACHESIZE},
+    {"compactVcf", no_argument, NULL, OPT_SET_COMPACTVCF},
+    {"staticVcf", no_argument, NULL, OPT_SET_STATICVCF},
+    {"regionVcf", no_argument, NULL, OPT_SET_REGIONVCF},
 
     {"countRec", no_argument, NULL, OPT_COUNTREC},
     {"firstLines", required_argument, NULL, OPT_FIRSTLINES},
     {"extractChrom", required_argument, NULL, OPT_EXTRACTCHROM},
     {"statistics_vcf", no_argument, NULL, OPT_STATISTICS_VCF},
+    {"buildRefIndex", no_argument, NULL, OPT_BUILDREFINDEX},
+    {"buildVcfIndex", no_argument, NULL, OPT_BUILDVCFINDEX},
 
     {"selectBadReads", required_argument, NULL, OPT_SELECTBADREADS},
     {"integrateVcfToSam", required_argument, NULL, OPT_INTEGRATEVCFTOSAM},
@@ -61,7 +73,9 @@ static void Usage() {
   printf(" -- Set files. Do this first!\n");
   printf("\toutputFile [filepath]\tset output file. Default: %s\n",
          default_outputFile);
-  printf("\tfaFile [filepath]\tset reference genome file\n");
+  printf(
+      "\tfaFile [filepath]\tset reference genome file (plain text, or "
+      "compressed by bgzip; \"-\" for stdin)\n");
   printf("\tfastqFile [filepath]\tset fastq file\n");
   printf("\tsamFile [filepath]\tset sam file\n");
   printf("\tvcfFile [filepath]\tset vcf file\n");
@@ -82,6 +96,38 @@ static void Usage() {
   printf("\tmismatch [score]\tset score for mismatch\n");
   printf("\tgapOpen [score]\tset score for gapOpen\n");
   printf("\tgapExtension [score]\tset score for gapExtension\n");
+  printf(
+      "\tgapOpen2 [score]\tset score for gapOpen of long gaps. Designed for "
+      "integration of SVs (dual-affine alignment). Default: %d\n",
+      SCORE_DEFAULT_GAPOPEN2);
+  printf(
+      "\tgapExtension2 [score]\tset score for gapExtension of long gaps. "
+      "Default: %d\n",
+      SCORE_DEFAULT_GAPEXTENSION2);
+  printf(
+      "\talignCacheSize [number]\tset maximal number of cached alignment "
+      "results. Reads sharing the same sequence with the same variants will be "
+      "aligned only once. 0 to disable. Default: %d\n",
+      default_alignCacheSize);
+  printf(
+      "\trefCacheSize [MB]\tset maximal memory of decoded chromosomes of the "
+      "reference genome. Chromosomes are decoded when first accessed, and the "
+      "least recently used ones are freed when the memory is exceeded. 0 for "
+      "no limit. Designed for integrateVcfToSam and kmerGeneration. Default: "
+      "%d\n",
+      default_refCacheSize);
+  printf(
+      "\tcompactVcf\tkeep only POS, ID and alleles of vcf records, instead of "
+      "all fields of them. Saves much memory for large vcf files. Designed for "
+      "integrateVcfToSam and kmerGeneration\n");
+  printf(
+      "\tstaticVcf\tindex vcf records with static sorted arrays instead of "
+      "bplus trees after loading. Faster lookups of variants. Designed for "
+      "integrateVcfToSam and kmerGeneration\n");
+  printf(
+      "\tregionVcf\tload only vcf records around the reads, queried through "
+      "the index of the vcf file (.tbi/.csi) if there is one. Designed for "
+      "integrateVcfToSam\n");
   printf("\n");
 
   printf(" -- Program infos\n");
@@ -105,12 +151,26 @@ static void Usage() {
       "includes number of snp, small_ins, small_del, mnp, sv_ins, sv_del and "
       "other types of variants. Variants using tags like <INV> will be "
       "classified separately. \n");
+  printf(
+      "\tbuildRefIndex\tbuild a binary index of the reference genome and "
+      "write it into the output file (default: [faFile]%s). An index beside "
+      "the reference genome file is used automatically, which avoids parsing "
+      "the reference genome every time. \n",
+      GENOMEFA_INDEX_SUFFIX);
+  printf(
+      "\tbuildVcfIndex\tbuild a binary index of the vcf file and write it "
+      "into the output file (default: [vcfFile]%s). An index beside the vcf "
+      "file is used automatically for compactVcf if the vcf file is not "
+      "modified after building the index, which avoids parsing the vcf file "
+      "every time. \n",
+      GENOMEVCF_INDEX_SUFFIX);
   printf("\n");
 
   printf(" -- GRBV operations\n");
   printf(
       "\tthreads [NUM_threads]\tuse multi-threads methods to run the program. "
-      "This only works for integrateVcfToSam.\n");
+      "This works for integrateVcfToSam, for loading the vcf file, and for "
+      "decompressing the reference genome in countRec and extractChrom.\n");
   printf(
       "\tselectBadReads [MAPQ_threshold]\tselect mapped reads only with MAPQ "
       "lower than "
@@ -139,6 +199,8 @@ static int _testSet_full() {
   printf("... auxiliary methods test passed. \n");
   // _testSet_hashTable();
   // printf("... hash table test passed. \n");
+  _testSet_contigDict();
+  printf("... contigDict test passed. \n");
   _testSet_genomeFa();
   printf("... genomeFa test passed. \n");
   _testSet_genomeSam();
@@ -147,6 +209,8 @@ static int _testSet_full() {
   printf("... genomeVcf_bplus test passed. \n");
   _testSet_alignment();
   printf("... alignment test passed. \n");
+  _testSet_alignCache();
+  printf("... alignCache test passed. \n");
   _testSet_grbvOperations();
   printf("... grbvOperation test passed. \n");
   _testSet_generateKmers();
@@ -177,6 +241,13 @@ int main(int argc, char *argv[]) {
   options.mismatch = SCORE_DEFAULT_MISMATCH;
   options.gapOpen = SCORE_DEFAULT_GAPOPEN;
   options.gapExtension = SCORE_DEFAULT_GAPEXTENSION;
+  options.gapOpen2 = SCORE_DEFAULT_GAPOPEN2;
+  options.gapExtension2 = SCORE_DEFAULT_GAPEXTENSION2;
+  options.alignCacheSize = default_alignCacheSize;
+  options.refCacheSize = default_refCacheSize;
+  options.compactVcf = 0;
+  options.staticVcf = 0;
+  options.regionVcf = 0;
 
   options.countRec = 0;
   options.firstLines = 0;
@@ -272,6 +343,41 @@ int main(int argc, char *argv[]) {
         options.gapExtension = atoi(optarg);
         break;
       }
+      case OPT_SET_GAPOPEN2: {
+        printf("score for gapOpen2: %s\n", optarg);
+        options.gapOpen2 = atoi(optarg);
+        break;
+      }
+      case OPT_SET_GAPEXTENSION2: {
+        printf("score for gapExtension2: %s\n", optarg);
+        options.gapExtension2 = atoi(optarg);
+        break;
+      }
+      case OPT_SET_ALIGNCACHESIZE: {
+        printf("size of alignment cache: %s\n", optarg);
+        options.alignCacheSize = atoi(optarg);
+        break;
+      }
+      case OPT_SET_REFCACHESIZE: {
+        printf("size of reference cache (MB): %s\n", optarg);
+        options.refCacheSize = atoi(optarg);
+        break;
+      }
+      case OPT_SET_COMPACTVCF: {
+        printf("keep compact vcf records\n");
+        options.compactVcf = 1;
+        break;
+      }
+      case OPT_SET_STATICVCF: {
+        printf("index vcf records with static sorted arrays\n");
+        options.staticVcf = 1;
+        break;
+      }
+      case OPT_SET_REGIONVCF: {
+        printf("load only vcf records around the reads\n");
+        options.regionVcf = 1;
+        break;
+      }
       case OPT_COUNTREC: {
         optCheck_conflict(&options);
         printf("Count records of files.\n");
@@ -300,6 +406,18 @@ int main(int argc, char *argv[]) {
         printf("... statistics collected.\n");
         break;
       }
+      case OPT_BUILDREFINDEX: {
+        optCheck_conflict(&options);
+        printf("Build index of reference genome.\n");
+        buildRefIndex(&options);
+        break;
+      }
+      case OPT_BUILDVCFINDEX: {
+        optCheck_conflict(&options);
+        printf("Build index of vcf file.\n");
+        buildVcfIndex(&options);
+        break;
+      }
       case OPT_SELECTBADREADS: {
         optCheck_conflict(&options);
         printf("Select bad reads with MAPQ lower than %s\n", optarg);
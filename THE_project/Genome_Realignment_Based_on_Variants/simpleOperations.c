@@ -1,35 +1,48 @@
 #include "simpleOperations.h"
 
+#include <htslib/bgzf.h>
+#include <htslib/hts.h>
+#include <inttypes.h>
+
+#include "genomeFa.h"
+#include "genomeVcf_bPlus.h"
+
 #define MAX_LINE_BUFFER 4096
 
-static void countRecFa(const char *filePath) {
-  printf("counting ref length ...\n");
-  FILE *fp = fopen(filePath, "r");
+/**
+ * @brief  Open a reference genome file, which can be plain text or compressed
+ * by bgzip (or gzip). Blocks compressed by bgzip are decompressed by cnt_thread
+ * threads.
+ */
+static BGZF *openFaFile(const char *filePath, int cnt_thread) {
+  BGZF *fp = bgzf_open(filePath, "r");
   if (fp == NULL) {
     fprintf(stderr, "Error: failed to open file %s\n", filePath);
-    exit(EXIT_SUCCESS);
+    exit(EXIT_FAILURE);
   }
-  int bpCnt = 0;
-  char buf[MAX_LINE_BUFFER];
-  int bufIndex = 0;
-  char tmpCh;
-  while ((tmpCh = fgetc(fp)) != EOF) {
-    if (tmpCh != '\n') {
-      buf[bufIndex++] = tmpCh;
-      bpCnt++;
-      continue;
+  if (cnt_thread > 1 && bgzf_compression(fp) == bgzf) {
+    bgzf_mt(fp, cnt_thread, 256);
+  }
+  return fp;
+}
+
+static void countRecFa(const char *filePath, int cnt_thread) {
+  printf("counting ref length ...\n");
+  BGZF *fp = openFaFile(filePath, cnt_thread);
+  int64_t bpCnt = 0;
+  kstring_t line = {0, 0, NULL};
+  while (bgzf_getline(fp, '\n', &line) >= 0) {
+    if (line.l != 0 && line.s[0] == '>') {
+      fprintf(stdout, "bps count: %" PRId64 "\n", bpCnt);
+      fprintf(stdout, "%s\n", line.s);
+      bpCnt = 0;
     } else {
-      buf[bufIndex] = '\0';
-      bufIndex = 0;
-      if (buf[0] == '>') {
-        fprintf(stdout, "bps count: %d\n", bpCnt);
-        fprintf(stdout, "%s\n", buf);
-        bpCnt = 0;
-      }
+      bpCnt += line.l;
     }
   }
-  fclose(fp);
-  fprintf(stdout, "Ref records count: %d\n", bpCnt);
+  free(line.s);
+  bgzf_close(fp);
+  fprintf(stdout, "Ref records count: %" PRId64 "\n", bpCnt);
 }
 
 static void countRecFastq(const char *filePath) {
@@ -101,7 +114,7 @@ static void countRecVcf(const char *filePath) {
 }
 
 void countRec(Options *opts) {
-  if (getFaFile(opts) != NULL) countRecFa(getFaFile(opts));
+  if (getFaFile(opts) != NULL) countRecFa(getFaFile(opts), opt_threads(opts));
   if (getFastqFile(opts) != NULL) countRecFastq(getFastqFile(opts));
   if (getSamFile(opts) != NULL) countRecSam(getSamFile(opts));
   if (getVcfFile(opts) != NULL) countRecVcf(getVcfFile(opts));
@@ -147,49 +160,30 @@ void extractChrom(Options *opts) {
   }
 
   // Extract the chromosome's bases
-  FILE *fp_fa = fopen(getFaFile(opts), "r");
+  BGZF *fp_fa = openFaFile(getFaFile(opts), opt_threads(opts));
   FILE *fp_op = fopen(getOutputFile(opts), "w");
 
   int foundChrom = 0;
   int chromIdx = 0;
 
-  char buf[MAX_LINE_BUFFER];  // line buffer
-  int bufIdx = 0;
-  char tmpCh;
+  kstring_t line = {0, 0, NULL};
   // Locate the chromosome and fprint its info line
-  while ((tmpCh = fgetc(fp_fa)) != EOF) {
-    if (tmpCh != '\n') {
-      buf[bufIdx++] = tmpCh;
-      continue;
-    } else {
-      buf[bufIdx] = '\0';
-      bufIdx = 0;
-      if (buf[0] == '>') {
-        chromIdx++;
-        if (chromIdx == opts->extractChrom) {
-          fprintf(fp_op, "%s\n", buf);
-          foundChrom = 1;
-          break;
-        }
+  while (bgzf_getline(fp_fa, '\n', &line) >= 0) {
+    if (line.l != 0 && line.s[0] == '>') {
+      chromIdx++;
+      if (chromIdx == opts->extractChrom) {
+        fprintf(fp_op, "%s\n", line.s);
+        foundChrom = 1;
+        break;
       }
     }
   }
   // Fprintf the chromosome's bases
-  while ((tmpCh = fgetc(fp_fa)) != EOF) {
-    if (tmpCh != '\n') {
-      buf[bufIdx++] = tmpCh;
-      continue;
-    } else {
-      buf[bufIdx] = '\0';
-      bufIdx = 0;
-      if (buf[0] != '>') {
-        fprintf(fp_op, "%s\n", buf);
-        continue;
-      } else {
-        break;
-      }
-    }
+  while (foundChrom == 1 && bgzf_getline(fp_fa, '\n', &line) >= 0) {
+    if (line.l != 0 && line.s[0] == '>') break;
+    fprintf(fp_op, "%s\n", line.s);
   }
+  free(line.s);
 
   if (foundChrom == 0) {
     fprintf(stderr,
@@ -197,6 +191,51 @@ void extractChrom(Options *opts) {
             opts->extractChrom);
   }
 
-  fclose(fp_fa);
+  bgzf_close(fp_fa);
   fclose(fp_op);
-}
\ No newline at end of file
+}
+
+void buildRefIndex(Options *opts) {
+  if (getFaFile(opts) == NULL) {
+    fprintf(stderr, "Error: reference genome file (*.fa) not designated. \n");
+    exit(EXIT_FAILURE);
+  }
+  // By default, put the index beside the *.fa file so that it will be found
+  // automatically when loading the *.fa file.
+  char indexPath[strlen(getFaFile(opts)) + strlen(GENOMEFA_INDEX_SUFFIX) + 1];
+  sprintf(indexPath, "%s%s", getFaFile(opts), GENOMEFA_INDEX_SUFFIX);
+  const char *outputPath =
+      getOutputFile(opts) != NULL ? getOutputFile(opts) : indexPath;
+
+  clock_t time_start = clock();
+  GenomeFa *gf = genomeFa_loadFile(getFaFile(opts));
+  genomeFa_writeIndexFile(gf, outputPath);
+  destroy_GenomeFa(gf);
+  clock_t time_end = clock();
+  printf("... index of %s written into %s. time: %fs\n", getFaFile(opts),
+         outputPath, time_convert_clock2second(time_start, time_end));
+}
+
+void buildVcfIndex(Options *opts) {
+  if (getVcfFile(opts) == NULL) {
+    fprintf(stderr, "Error: vcf file not designated. \n");
+    exit(EXIT_FAILURE);
+  }
+  // By default, put the index beside the vcf file so that it will be found
+  // automatically when loading the vcf file.
+  char indexPath[strlen(getVcfFile(opts)) + strlen(GENOMEVCF_INDEX_SUFFIX) +
+                 1];
+  sprintf(indexPath, "%s%s", getVcfFile(opts), GENOMEVCF_INDEX_SUFFIX);
+  char *outputPath =
+      getOutputFile(opts) != NULL ? getOutputFile(opts) : indexPath;
+
+  clock_t time_start = clock();
+  GenomeVcf_bplus *gv = genomeVcf_bplus_loadFileCompact(
+      getVcfFile(opts), RANK_INNER_NODE_DEFAULT, RANK_LEAF_NODE_DEFAULT, NULL,
+      0, opt_threads(opts));
+  genomeVcf_bplus_writeFile(gv, outputPath);
+  destroy_GenomeVcf_bplus(gv);
+  clock_t time_end = clock();
+  printf("... index of %s written into %s. time: %fs\n", getVcfFile(opts),
+         outputPath, time_convert_clock2second(time_start, time_end));
+}
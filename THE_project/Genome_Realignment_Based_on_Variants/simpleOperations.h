@@ -22,4 +22,20 @@ void firstLines(Options *opts);
  */
 void extractChrom(Options *opts);
 
+/**
+ * @brief  Build the binary index of the reference genome, which is mapped into
+ * memory instead of parsing the *.fa file when loading the genome. The index is
+ * written into the output file if designated, or "*.fa" +
+ * GENOMEFA_INDEX_SUFFIX otherwise.
+ */
+void buildRefIndex(Options *opts);
+
+/**
+ * @brief  Build the binary index of the vcf file, which is mapped into memory
+ * instead of parsing the vcf file when loading variants. The index is written
+ * into the output file if designated, or "*.vcf" + GENOMEVCF_INDEX_SUFFIX
+ * otherwise.
+ */
+void buildVcfIndex(Options *opts);
+
 #endif
\ No newline at end of file